@@ -1,24 +1,63 @@
 #ifndef HPP_CLMEMORY
 #define HPP_CLMEMORY
 
+#include <stdexcept>
+#include <utility>
+
 #include "lexical_cast.hpp"
 
+/* A buffer and its host side. By default the host side is a separate array
+ * copied with read() and write(). With bZeroCopy the buffer is allocated with
+ * CL_MEM_ALLOC_HOST_PTR and the host side is the buffer itself, mapped by read()
+ * and unmapped by write(), which saves the copies where host and device share
+ * memory (see isHostUnified()) but leaves the host side invalid while the device
+ * has the buffer. Either way the host may only touch the data between read() or
+ * invalidate() and write().
+ *
+ * Owns the buffer and a reference to the queue, moving is fine but copying
+ * isn't.
+ */
 template<typename T> class CLMemory {
 	public:
 		CLMemory(cl_context & clContext, cl_command_queue & clQueue, const cl_mem_flags flags, const size_t size, T * const pData)
-		 : m_clQueue(clQueue), m_bFree(false), m_size(size), m_pData(pData) {
-			 m_clMem = clCreateBuffer(clContext, flags, m_size, NULL, NULL);
+		 : m_clQueue(clQueue), m_bFree(false), m_bZeroCopy(false), m_bMapped(false), m_flags(flags), m_size(size), m_pData(pData) {
+			m_clMem = create(clContext, flags);
 		}
 
-		CLMemory(cl_context & clContext, cl_command_queue & clQueue, const cl_mem_flags flags, const size_t count, const bool noAllocation = false)
-		 : m_clQueue(clQueue), m_bFree(true), m_size(sizeof(T) * count), m_pData(noAllocation ? NULL : new T[count]) {
-			m_clMem = clCreateBuffer(clContext, flags, m_size, NULL, NULL);
+		CLMemory(cl_context & clContext, cl_command_queue & clQueue, const cl_mem_flags flags, const size_t count, const bool bZeroCopy = false)
+		 : m_clQueue(clQueue), m_bFree(!bZeroCopy), m_bZeroCopy(bZeroCopy), m_bMapped(false), m_flags(flags), m_size(sizeof(T) * count), m_pData(bZeroCopy ? NULL : new T[count]) {
+			m_clMem = create(clContext, bZeroCopy ? flags | CL_MEM_ALLOC_HOST_PTR : flags);
 		}
 
-		~CLMemory() {
-			if(m_bFree) {
-				delete [] m_pData;
+		CLMemory(const CLMemory &) = delete;
+		CLMemory & operator=(const CLMemory &) = delete;
+
+		CLMemory(CLMemory && o)
+		 : m_clQueue(o.m_clQueue), m_bFree(o.m_bFree), m_bZeroCopy(o.m_bZeroCopy), m_bMapped(o.m_bMapped), m_flags(o.m_flags), m_size(o.m_size), m_pData(o.m_pData), m_clMem(o.m_clMem) {
+			o.m_clQueue = NULL;
+			o.m_bFree = false;
+			o.m_bMapped = false;
+			o.m_pData = NULL;
+			o.m_clMem = NULL;
+		}
+
+		CLMemory & operator=(CLMemory && o) {
+			if (this != &o) {
+				release();
+				std::swap(m_clQueue, o.m_clQueue);
+				std::swap(m_bFree, o.m_bFree);
+				std::swap(m_bZeroCopy, o.m_bZeroCopy);
+				std::swap(m_bMapped, o.m_bMapped);
+				std::swap(m_flags, o.m_flags);
+				std::swap(m_size, o.m_size);
+				std::swap(m_pData, o.m_pData);
+				std::swap(m_clMem, o.m_clMem);
 			}
+			return *this;
+		}
+
+		~CLMemory() {
+			release();
 		}
 
 		static void setKernelArg(cl_kernel & clKernel, const cl_uint arg_index, const T & t) {
@@ -35,22 +74,49 @@ template<typename T> class CLMemory {
 			}
 		}
 
-		void read(const bool bBlock, cl_event * pEvent = NULL) const {
+		// Gives the host the device's contents, once pEvent completes unless bBlock
+		void read(const bool bBlock, cl_event * pEvent = NULL) {
 			const cl_bool block = bBlock ? CL_TRUE : CL_FALSE;
+			if (m_bZeroCopy) {
+				unmap();
+				map(block, (m_flags & CL_MEM_HOST_READ_ONLY) ? CL_MAP_READ : CL_MAP_READ | CL_MAP_WRITE, pEvent);
+				return;
+			}
+
 			auto res = clEnqueueReadBuffer(m_clQueue, m_clMem, block, 0, m_size, m_pData, 0, NULL, pEvent);
 			if(res != CL_SUCCESS) {
 				throw std::runtime_error("clEnqueueReadBuffer failed - " + lexical_cast::write(res));
 			}
 		}
 
-		void write(const bool bBlock) const {
+		// Hands the host's contents to the device
+		void write(const bool bBlock) {
 			const cl_bool block = bBlock ? CL_TRUE : CL_FALSE;
+			if (m_bZeroCopy) {
+				unmap();
+				if (bBlock) {
+					clFinish(m_clQueue);
+				}
+				return;
+			}
+
 			auto res = clEnqueueWriteBuffer(m_clQueue, m_clMem, block, 0, m_size, m_pData, 0, NULL, NULL);
 			if( res != CL_SUCCESS ) {
 				throw std::runtime_error("clEnqueueWriteBuffer failed - " + lexical_cast::write(res));
 			}
 		}
 
+		// Gives the host the buffer to overwrite without reading it first, whatever the device wrote is lost
+		void invalidate() {
+			if (m_bZeroCopy && !m_bMapped) {
+				map(CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, NULL);
+			}
+		}
+
+		bool zeroCopy() const {
+			return m_bZeroCopy;
+		}
+
 		T * const & data() const {
 			return m_pData;
 		}
@@ -72,12 +138,69 @@ template<typename T> class CLMemory {
 		}
 
 	private:
-		const cl_command_queue m_clQueue;
-		const bool m_bFree;
-		const size_t m_size;
+		cl_mem create(cl_context & clContext, const cl_mem_flags flags) {
+			cl_int res;
+			const cl_mem clMem = clCreateBuffer(clContext, flags, m_size, NULL, &res);
+			if (clMem == NULL) {
+				if (m_bFree) {
+					delete [] m_pData;
+				}
+				throw std::runtime_error("clCreateBuffer failed - " + lexical_cast::write(res));
+			}
+
+			clRetainCommandQueue(m_clQueue);
+			return clMem;
+		}
+
+		void map(const cl_bool block, const cl_map_flags flags, cl_event * pEvent) {
+			cl_int res;
+			m_pData = static_cast<T *>(clEnqueueMapBuffer(m_clQueue, m_clMem, block, flags, 0, m_size, 0, NULL, pEvent, &res));
+			if (res != CL_SUCCESS) {
+				throw std::runtime_error("clEnqueueMapBuffer failed - " + lexical_cast::write(res));
+			}
+			m_bMapped = true;
+		}
+
+		void unmap() {
+			if (m_bMapped) {
+				m_bMapped = false;
+				auto res = clEnqueueUnmapMemObject(m_clQueue, m_clMem, m_pData, 0, NULL, NULL);
+				m_pData = NULL;
+				if (res != CL_SUCCESS) {
+					throw std::runtime_error("clEnqueueUnmapMemObject failed - " + lexical_cast::write(res));
+				}
+			}
+		}
+
+		// The buffer itself goes once the commands using it are done
+		void release() {
+			if (m_clMem != NULL) {
+				if (m_bMapped) {
+					clEnqueueUnmapMemObject(m_clQueue, m_clMem, m_pData, 0, NULL, NULL);
+				}
+				clReleaseMemObject(m_clMem);
+				clReleaseCommandQueue(m_clQueue);
+			}
+
+			if (m_bFree) {
+				delete [] m_pData;
+			}
+
+			m_bFree = false;
+			m_bMapped = false;
+			m_pData = NULL;
+			m_clMem = NULL;
+		}
+
+		cl_command_queue m_clQueue;
+		bool m_bFree;
+		bool m_bZeroCopy;
+		bool m_bMapped;
+		cl_mem_flags m_flags;
+		size_t m_size;
 
-		T * const m_pData;
+		T * m_pData;
 		cl_mem m_clMem;
 };
 
-#endif /* HPP_CLMEMORY */
\ No newline at end of file
+#endif /* HPP_CLMEMORY */
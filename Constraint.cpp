@@ -0,0 +1,112 @@
+#include "Constraint.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "hexadecimal.hpp"
+
+namespace {
+// Hex number aligned to the end of 20 bytes
+void parseAligned(string s, cl_uchar bytes[20]) {
+  if (s.size() >= 2 && s.substr(0, 2) == "0x") {
+    s.erase(0, 2);
+  }
+
+  if (s.empty() || s.size() > 40) {
+    throw runtime_error("constraint mask and value must be 1 to 40 hex characters");
+  }
+
+  fill(bytes, bytes + 20, cl_uchar(0));
+  for (size_t i = 0; i < s.size(); ++i) {
+    const size_t nibble = 40 - s.size() + i;
+    bytes[nibble / 2] |= static_cast<cl_uchar>(hexValue(s[i]) << (nibble % 2 ? 0 : 4));
+  }
+}
+
+// Lane and shift of address byte i in the lanes built by eradicate2_lane
+void position(const int i, int& lane, int& shift) {
+  lane = i < 4 ? 0 : (i + 4) / 8;
+  shift = 56 - 8 * (i < 4 ? i : (i + 4) % 8);
+}
+}  // namespace
+
+Constraint::Constraint() {
+  fill(m_mask, m_mask + 20, cl_uchar(0));
+  fill(m_value, m_value + 20, cl_uchar(0));
+}
+
+Constraint Constraint::parse(const string& strConstraint) {
+  const size_t colon = strConstraint.find(':');
+  if (colon == string::npos) {
+    throw runtime_error("constraint must be given as mask:value");
+  }
+
+  Constraint c;
+  parseAligned(strConstraint.substr(0, colon), c.m_mask);
+  parseAligned(strConstraint.substr(colon + 1), c.m_value);
+  for (int i = 0; i < 20; ++i) {
+    if (c.m_value[i] & ~c.m_mask[i]) {
+      throw runtime_error("constraint value has bits outside the mask");
+    }
+  }
+
+  if (!c.enabled()) {
+    throw runtime_error("constraint mask is empty");
+  }
+
+  return c;
+}
+
+bool Constraint::enabled() const {
+  return any_of(m_mask, m_mask + 20, [](const cl_uchar m) { return m != 0; });
+}
+
+string Constraint::str() const {
+  return "0x" + toHex(m_mask, 20) + ":0x" + toHex(m_value, 20);
+}
+
+int Constraint::bits() const {
+  int r = 0;
+  for (auto m : m_mask) {
+    r += __builtin_popcount(m);
+  }
+  return r;
+}
+
+bool Constraint::check(const cl_uchar hash[20]) const {
+  for (int i = 0; i < 20; ++i) {
+    if ((hash[i] & m_mask[i]) != m_value[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+string Constraint::source() const {
+  if (!enabled()) {
+    return "";
+  }
+
+  cl_ulong mask[3] = {0, 0, 0};
+  cl_ulong value[3] = {0, 0, 0};
+  for (int i = 0; i < 20; ++i) {
+    int lane, shift;
+    position(i, lane, shift);
+    mask[lane] |= static_cast<cl_ulong>(m_mask[i]) << shift;
+    value[lane] |= static_cast<cl_ulong>(m_value[i]) << shift;
+  }
+
+  ostringstream oss;
+  oss << "#define ERADICATE2_CONSTRAINT" << endl;
+  oss << "int eradicate2_constraint(const ulong a0, const ulong a1, const ulong a2) {" << endl;
+  oss << "\treturn 1";
+  for (int lane = 0; lane < 3; ++lane) {
+    if (mask[lane] != 0) {
+      oss << " & ((a" << lane << " & " << hex64(mask[lane]) << ") == " << hex64(value[lane]) << ")";
+    }
+  }
+  oss << ";" << endl;
+  oss << "}" << endl;
+  return oss.str();
+}
@@ -0,0 +1,44 @@
+#ifndef HPP_CONSTRAINT
+#define HPP_CONSTRAINT
+
+#include <string>
+
+#include "types.hpp"
+
+using namespace std;
+
+/* Bits of the address that must have a given value whatever the mode, such as
+ * the permission flags Uniswap v4 reads from the low bits of a hook's address.
+ * Written as mask:value in hex, both aligned to the end of the address:
+ *
+ *   0x3fff:0x0880   the low 14 bits are 00100010000000
+ *   ff:00           the last byte is zero
+ *
+ * Addresses outside the constraint score 0 in every mode, those inside get the
+ * mode's score, so e.g. -l 0 finds the most leading zeros among valid hooks.
+ * source() generates one AND and compare per lane that eradicate2_score checks
+ * before running the mode's scorer.
+ */
+class Constraint {
+ public:
+  Constraint();
+
+  static Constraint parse(const string& strConstraint);
+
+  bool enabled() const;
+  string str() const;
+
+  // Number of fixed bits, one address in 2^bits() passes
+  int bits() const;
+
+  bool check(const cl_uchar hash[20]) const;
+
+  // OpenCL source defining eradicate2_constraint, empty when disabled
+  string source() const;
+
+ private:
+  cl_uchar m_mask[20];
+  cl_uchar m_value[20];
+};
+
+#endif /* HPP_CONSTRAINT */
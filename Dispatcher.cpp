@@ -3,6 +3,7 @@
 #include <magic_enum.hpp>
 // Includes
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -11,24 +12,9 @@
 #include <stdexcept>
 #include <thread>
 
+#include "clutil.hpp"
 #include "hexadecimal.hpp"
 
-set<string> saved;
-ofstream outfile;
-
-static void printResult(const result r, const cl_uchar score, const chrono::time_point<chrono::steady_clock>& timeStart) {
-  // Time delta
-  const auto seconds = chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - timeStart).count();
-
-  // Format address
-  const string strSalt = toHex(r.salt, 32);
-  const string strPublic = toHex(r.hash, 20);
-
-  // Print
-  const string strVT100ClearLine = "\33[2K\r";
-  cout << strVT100ClearLine << "  Time: " << setw(5) << seconds << "s Score: " << setw(2) << (int)score << " Magic: 0x" << strSalt << " Address: 0x" << strPublic << endl;
-}
-
 Dispatcher::OpenCLException::OpenCLException(const string s, const cl_int res) : runtime_error(s + " (res = " + lexical_cast::write(res) + ")"),
                                                                                  m_res(res) {
 }
@@ -39,12 +25,12 @@ void Dispatcher::OpenCLException::OpenCLException::throwIfError(const string s,
   }
 }
 
-cl_command_queue Dispatcher::Device::createQueue(cl_context& clContext, cl_device_id& clDeviceId) {
+cl_command_queue Dispatcher::Device::createQueue(cl_context& clContext, cl_device_id& clDeviceId, const bool bProfiling) {
 // nVidia CUDA Toolkit 10.1 only supports OpenCL 1.2 so we revert back to older functions for compatability
 #ifdef ERADICATE2_DEBUG
   cl_command_queue_properties p = CL_QUEUE_PROFILING_ENABLE;
 #else
-  cl_command_queue_properties p = 0;
+  cl_command_queue_properties p = bProfiling ? CL_QUEUE_PROFILING_ENABLE : 0;
 #endif
 
 #ifdef CL_VERSION_2_0
@@ -60,100 +46,291 @@ cl_kernel Dispatcher::Device::createKernel(cl_program& clProgram, const string s
   return ret == NULL ? throw runtime_error("failed to create kernel \"" + s + "\"") : ret;
 }
 
-Dispatcher::Device::Device(Dispatcher& parent, cl_context& clContext, cl_program& clProgram, cl_device_id clDeviceId, const size_t worksizeLocal, const size_t size, const size_t index) : m_parent(parent),
+Dispatcher::Device::Device(Dispatcher& parent, cl_context& clContext, cl_program& clProgram, cl_device_id clDeviceId, const size_t worksizeLocal, const size_t size, const size_t index, const size_t maxJobs) : m_parent(parent),
                                                                                                                                                                                            m_index(index),
                                                                                                                                                                                            m_clDeviceId(clDeviceId),
                                                                                                                                                                                            m_worksizeLocal(worksizeLocal),
-                                                                                                                                                                                           m_clScoreMax(0),
-                                                                                                                                                                                           m_clQueue(createQueue(clContext, clDeviceId)),
+                                                                                                                                                                                           m_clQueue(createQueue(clContext, clDeviceId, parent.m_cfg.profiling)),
+                                                                                                                                                                                           m_bZeroCopy(isHostUnified(clDeviceId)),
                                                                                                                                                                                            m_kernelIterate(createKernel(clProgram, "eradicate2_iterate")),
-                                                                                                                                                                                           m_memResult(clContext, m_clQueue, CL_MEM_READ_WRITE, ERADICATE2_MAX_SCORE + 1),
-                                                                                                                                                                                           m_memMode(clContext, m_clQueue, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, 1),
-                                                                                                                                                                                           m_round(0) {
+                                                                                                                                                                                           m_kernelJobs(createKernel(clProgram, "eradicate2_iterate_jobs")),
+                                                                                                                                                                                           m_memResult(clContext, m_clQueue, CL_MEM_READ_WRITE, (ERADICATE2_MAX_SCORE + 1) * maxJobs, m_bZeroCopy),
+                                                                                                                                                                                           m_memMode(clContext, m_clQueue, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, 1, m_bZeroCopy),
+                                                                                                                                                                                           m_memJobs(clContext, m_clQueue, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, maxJobs, m_bZeroCopy),
+                                                                                                                                                                                           m_round(0),
+                                                                                                                                                                                           m_launches(0),
+                                                                                                                                                                                           m_bDrain(false),
+                                                                                                                                                                                           m_failures(0),
+                                                                                                                                                                                           m_bFailed(false),
+                                                                                                                                                                                           m_eventRead(NULL),
+                                                                                                                                                                                           m_roundRead(0),
+                                                                                                                                                                                           m_nsReadEnqueued(0),
+                                                                                                                                                                                           m_nsClockOffset(0),
+                                                                                                                                                                                           m_bClockOffset(false),
+                                                                                                                                                                                           m_statRounds(0),
+                                                                                                                                                                                           m_statKernelNs(0),
+                                                                                                                                                                                           m_statCallbackNs(0),
+                                                                                                                                                                                           m_statFailures(0),
+                                                                                                                                                                                           m_statRetries(0),
+                                                                                                                                                                                           m_statReassigned(0) {
+  for (auto& i : m_statHits) {
+    i = 0;
+  }
 }
 
 Dispatcher::Device::~Device() {
+  clFinish(m_clQueue);
+  clReleaseKernel(m_kernelIterate);
+  clReleaseKernel(m_kernelJobs);
+  clReleaseCommandQueue(m_clQueue);  // The buffers hold on to it until they're released
 }
 
-Dispatcher::Dispatcher(cl_context& clContext, cl_program& clProgram, const size_t worksizeMax, const size_t size, const config cfg)
-    : m_clContext(clContext), m_clProgram(clProgram), m_worksizeMax(worksizeMax), m_size(size), m_clScoreMax(0), m_eventFinished(NULL), m_cfg(cfg), m_countPrint(0) {
+Dispatcher::Dispatcher(cl_context& clContext, const size_t worksizeMax, const size_t size, const config cfg, const Callbacks& callbacks, const size_t maxJobs)
+    : m_clContext(clContext), m_worksizeMax(worksizeMax), m_size(size), m_maxJobs(maxJobs), m_eventFinished(NULL), m_cfg(cfg), m_callbacks(callbacks), m_bJobs(false), m_pStore(NULL), m_pVerifier(NULL), m_pScheduler(NULL), m_pTrace(NULL), m_countRunning(0), m_countFailed(0), m_quit(false) {
 }
 
 Dispatcher::~Dispatcher() {
+  for (auto& d : m_vDevices) {
+    delete d;
+  }
+  delete m_pVerifier;
+  delete m_pScheduler;
+  for (auto& w : m_mWriters) {
+    delete w.second;
+  }
+  delete m_pStore;
+  delete m_pTrace;
 }
 
-void Dispatcher::addDevice(cl_device_id clDeviceId, const size_t worksizeLocal, const size_t index) {
-  Device* pDevice = new Device(*this, m_clContext, m_clProgram, clDeviceId, worksizeLocal, m_size, index);
+void Dispatcher::addDevice(cl_device_id clDeviceId, cl_program& clProgram, const size_t worksizeLocal, const size_t index) {
+  Device* pDevice = new Device(*this, m_clContext, clProgram, clDeviceId, worksizeLocal, m_size, index, m_maxJobs);
   m_vDevices.push_back(pDevice);
+
+  // Spills show up as private memory, logged so a kernel change that adds them doesn't go unnoticed
+  log("  GPU" + lexical_cast::write(index) + ": eradicate2_iterate " + kernelInfo(pDevice->m_kernelIterate, clDeviceId));
+  log("  GPU" + lexical_cast::write(index) + ": eradicate2_iterate_jobs " + kernelInfo(pDevice->m_kernelJobs, clDeviceId));
+  m_speed.addDevice(index);
+}
+
+void Dispatcher::run(const mode& mode, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard) {
+  start({Job{m_cfg.initHash, mode, m_cfg.scoreMin, m_size, m_cfg.fileName, m_cfg.jobId, 1, 0, 0}}, pattern, weights, constraint, guard, false);
 }
 
-void Dispatcher::run(const mode& mode) {
+void Dispatcher::run(const vector<Job>& vJobs, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard) {
+  if (vJobs.empty() || vJobs.size() > m_maxJobs) {
+    throw runtime_error("a run takes 1 to " + lexical_cast::write(m_maxJobs) + " jobs");
+  }
+
+  size_t size = 0;
+  for (auto& j : vJobs) {
+    size += j.size;
+  }
+
+  // Global ids are 32 bits in the kernel
+  if (size == 0 || size > 0xffffffffULL) {
+    throw runtime_error("jobs must have between 1 and 2^32 - 1 salts per round together");
+  }
+
+  m_size = size;
+  start(vJobs, pattern, weights, constraint, guard, true);
+}
+
+void Dispatcher::start(const vector<Job>& vJobs, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard, const bool bJobs) {
   m_eventFinished = clCreateUserEvent(m_clContext, NULL);
+  m_vJobs = vJobs;
+  m_bJobs = bJobs;
 
-  outfile = ofstream(m_cfg.fileName, ios::app);
+  delete m_pVerifier;
+  for (auto& w : m_mWriters) {
+    delete w.second;
+  }
+  m_mWriters.clear();
+  m_vJobWriters.clear();
+  delete m_pStore;
+
+  for (auto& j : m_vJobs) {
+    if (!j.fileName.empty() && m_mWriters.count(j.fileName) == 0) {
+      m_mWriters[j.fileName] = new ResultWriter(j.fileName);
+    }
+
+    m_vJobWriters.push_back(j.fileName.empty() ? NULL : m_mWriters[j.fileName]);
+  }
+
+  m_pStore = m_cfg.storeFileName.empty() ? NULL : new ResultStore(m_cfg.storeFileName);
+
+  delete m_pScheduler;
+  m_pScheduler = NULL;
+  if (m_bJobs && m_cfg.schedule) {
+    vector<Scheduler::Job> vShares;
+    for (auto& j : m_vJobs) {
+      vShares.push_back(Scheduler::Job{j.size, j.weight, j.priority, j.rounds});
+    }
+    m_pScheduler = new Scheduler(vShares);
+  }
+
+  // Descriptors for eradicate2_iterate_jobs, the verifier only needs their initial states and modes
+  vector<job> vDescriptors(m_vJobs.size());
+  cl_uint begin = 0;
+  for (size_t i = 0; i < m_vJobs.size(); ++i) {
+    memset(&vDescriptors[i], 0, sizeof(job));
+    vDescriptors[i].init = m_vJobs[i].initHash;
+    vDescriptors[i].m = m_vJobs[i].m;
+    vDescriptors[i].begin = begin;
+    vDescriptors[i].scoreMax = static_cast<cl_uchar>(m_vJobs[i].scoreMin);
+    begin += static_cast<cl_uint>(m_vJobs[i].size);
+  }
+
+  // Verification is two Keccak permutations per distinct result, a few threads keep up with any number of devices
+  const auto onVerified = [this](const Hit& h) {
+    if (m_vJobWriters[h.jobIndex]) {
+      m_vJobWriters[h.jobIndex]->push(h.score, h.r);
+    }
+
+    if (m_pStore) {
+      m_pStore->append(h.score, h.r, m_vJobs[h.jobIndex].m.function, h.jobId);
+    }
+
+    if (m_callbacks.onHit) {
+      m_callbacks.onHit(h);
+    }
+  };
+
+  const auto onMismatch = [this](const Hit& h) {
+    log("warning: GPU" + lexical_cast::write(h.deviceIndex) + " reported salt 0x" + toHex(h.r.salt, 32) + " for address 0x" + toHex(h.r.hash, 20) + " with score " + lexical_cast::write((int)h.score) + ", which doesn't verify, discarded");
+  };
+
+  m_pVerifier = new Verifier(vDescriptors, pattern, weights, constraint, guard, min(thread::hardware_concurrency(), 4u), onVerified, onMismatch);
+
+  if (!m_cfg.traceFileName.empty()) {
+    delete m_pTrace;
+    m_pTrace = new Trace(m_cfg.traceFileName);
+  }
 
   for (auto it = m_vDevices.begin(); it != m_vDevices.end(); ++it) {
     Device& d = **it;
     d.m_round = 0;
-
-    for (size_t i = 0; i < ERADICATE2_MAX_SCORE + 1; ++i) {
-      d.m_memResult[i].found = 0;
+    d.m_vRounds.assign(m_vJobs.size(), 0);
+    d.m_failures = 0;
+    d.m_bFailed = false;
+    deviceReset(d);
+
+    if (m_bJobs) {
+      // Kernel arguments - eradicate2_iterate_jobs
+      d.m_memJobs.invalidate();
+      copy(vDescriptors.begin(), vDescriptors.end(), &d.m_memJobs[0]);
+      d.m_memJobs.write(true);
+      d.m_memResult.setKernelArg(d.m_kernelJobs, 0);
+      d.m_memJobs.setKernelArg(d.m_kernelJobs, 1);
+      CLMemory<cl_uint>::setKernelArg(d.m_kernelJobs, 2, static_cast<cl_uint>(m_vJobs.size()));
+    } else {
+      d.m_memMode.invalidate();
+      *d.m_memMode = m_vJobs.front().m;
+      d.m_memMode.write(true);
+
+      // Kernel arguments - eradicate2_iterate
+      d.m_memResult.setKernelArg(d.m_kernelIterate, 0);
+      d.m_memMode.setKernelArg(d.m_kernelIterate, 1);
+      CLMemory<cl_uchar>::setKernelArg(d.m_kernelIterate, 2, static_cast<cl_uchar>(m_vJobs.front().scoreMin));
     }
+    // Device index and round updated in deviceDispatch()
 
-    // Copy data
-    *d.m_memMode = mode;
-    d.m_memMode.write(true);
-    d.m_memResult.write(true);
-
-    // Kernel arguments - eradicate2_iterate
-    d.m_memResult.setKernelArg(d.m_kernelIterate, 0);
-    d.m_memMode.setKernelArg(d.m_kernelIterate, 1);
-    CLMemory<cl_uchar>::setKernelArg(d.m_kernelIterate, 2, d.m_clScoreMax);  // Updated in handleResult()
-    CLMemory<cl_uint>::setKernelArg(d.m_kernelIterate, 3, d.m_index);
-    // Round information updated in deviceDispatch()
+    if (m_pTrace) {
+      m_pTrace->process(d.m_index, "GPU" + lexical_cast::write(d.m_index));
+      m_pTrace->thread(d.m_index, 0, "device");
+      m_pTrace->thread(d.m_index, 1, "queue");
+      m_pTrace->thread(d.m_index, 2, "host");
+    }
   }
 
   m_quit = false;
   m_countRunning = m_vDevices.size();
+  m_countFailed = 0;
+  m_dOrphans.clear();
 
-  cout << "Running..." << endl;
-  cout << endl;
+  log("Running...");
 
   // Start asynchronous dispatch loop on all devices
   for (auto it = m_vDevices.begin(); it != m_vDevices.end(); ++it) {
-    deviceDispatch(*(*it));
+    dispatch(*(*it));
   }
 
   // Wait for finish event
   clWaitForEvents(1, &m_eventFinished);
   clReleaseEvent(m_eventFinished);
   m_eventFinished = NULL;
+
+  // Retries may have started further retries before they returned
+  for (;;) {
+    vector<thread> vThreads;
+    {
+      lock_guard<mutex> lock(m_mutex);
+      vThreads.swap(m_vRetryThreads);
+    }
+
+    if (vThreads.empty()) {
+      break;
+    }
+
+    for (auto& t : vThreads) {
+      t.join();
+    }
+  }
+
+  // A device given up on after the others had stopped leaves its unfinished rounds to nobody
+  if (!m_quit && !m_dOrphans.empty()) {
+    string strRounds;
+    for (auto& l : m_dOrphans) {
+      strRounds += (strRounds.empty() ? "" : ", ") + string("GPU") + lexical_cast::write(l.deviceIndex) + " round " + lexical_cast::write(l.round);
+      strRounds += m_pScheduler ? " of job " + lexical_cast::write(m_vJobs[l.job].jobId) : "";
+    }
+    log("warning: no device was left to run " + lexical_cast::write(m_dOrphans.size()) + " unfinished rounds, their salts weren't searched: " + strRounds);
+  }
+
+  // What every job got, to hold against what it was meant to get
+  if (m_pScheduler) {
+    const auto vStats = m_pScheduler->stats();
+    unsigned long long salts = 0;
+    for (auto& s : vStats) {
+      salts += s.salts;
+    }
+
+    for (size_t i = 0; i < vStats.size(); ++i) {
+      const double percent = salts == 0 ? 0 : 100.0 * vStats[i].salts / salts;
+      log("Job " + lexical_cast::write(m_vJobs[i].jobId) + ": " + lexical_cast::write(vStats[i].rounds) + " rounds, " + lexical_cast::write(percent) + "% of the salts at weight " + lexical_cast::write(vStats[i].weight) + " and priority " + lexical_cast::write(vStats[i].priority));
+    }
+  }
+
+  if (m_countFailed == m_vDevices.size()) {
+    throw runtime_error("all devices failed");
+  }
 }
 
-void Dispatcher::enqueueKernel(cl_command_queue& clQueue, cl_kernel& clKernel, size_t worksizeGlobal, const size_t worksizeLocal, cl_event* pEvent = NULL) {
+void Dispatcher::enqueueKernel(cl_command_queue& clQueue, cl_kernel& clKernel, size_t worksizeOffset, size_t worksizeGlobal, const size_t worksizeLocal, vector<cl_event>* pEvents = NULL) {
   const size_t worksizeMax = m_worksizeMax;
-  size_t worksizeOffset = 0;
   while (worksizeGlobal) {
     const size_t worksizeRun = min(worksizeGlobal, worksizeMax);
     const size_t* const pWorksizeLocal = (worksizeLocal == 0 ? NULL : &worksizeLocal);
-    const auto res = clEnqueueNDRangeKernel(clQueue, clKernel, 1, &worksizeOffset, &worksizeRun, pWorksizeLocal, 0, NULL, pEvent);
+    cl_event event;
+    const auto res = clEnqueueNDRangeKernel(clQueue, clKernel, 1, &worksizeOffset, &worksizeRun, pWorksizeLocal, 0, NULL, pEvents ? &event : NULL);
     OpenCLException::throwIfError("kernel queueing failed", res);
+    if (pEvents) {
+      pEvents->push_back(event);
+    }
 
     worksizeGlobal -= worksizeRun;
     worksizeOffset += worksizeRun;
   }
 }
 
-void Dispatcher::enqueueKernelDevice(Device& d, cl_kernel& clKernel, size_t worksizeGlobal, cl_event* pEvent = NULL) {
+void Dispatcher::enqueueKernelDevice(Device& d, cl_kernel& clKernel, const size_t worksizeOffset, size_t worksizeGlobal, vector<cl_event>* pEvents = NULL) {
   try {
-    enqueueKernel(d.m_clQueue, clKernel, worksizeGlobal, d.m_worksizeLocal, pEvent);
+    enqueueKernel(d.m_clQueue, clKernel, worksizeOffset, worksizeGlobal, d.m_worksizeLocal, pEvents);
   } catch (OpenCLException& e) {
     // If local work size is invalid, abandon it and let implementation decide
     if ((e.m_res == CL_INVALID_WORK_GROUP_SIZE || e.m_res == CL_INVALID_WORK_ITEM_SIZE) && d.m_worksizeLocal != 0) {
-      cout << endl
-           << "warning: local work size abandoned on GPU" << d.m_index << endl;
+      log("warning: local work size abandoned on GPU" + lexical_cast::write(d.m_index));
       d.m_worksizeLocal = 0;
-      enqueueKernel(d.m_clQueue, clKernel, worksizeGlobal, d.m_worksizeLocal, pEvent);
+      enqueueKernel(d.m_clQueue, clKernel, worksizeOffset, worksizeGlobal, d.m_worksizeLocal, pEvents);
     } else {
       throw;
     }
@@ -161,48 +338,151 @@ void Dispatcher::enqueueKernelDevice(Device& d, cl_kernel& clKernel, size_t work
 }
 
 void Dispatcher::deviceDispatch(Device& d) {
-  for (auto i = ERADICATE2_MAX_SCORE; i > m_cfg.scoreMin; --i) {
-    result& r = d.m_memResult[i];
-    if (r.found == 0) continue;
-
-    if (i > m_clScoreMax) {
-      if (i >= d.m_clScoreMax) {
-        d.m_clScoreMax = i;
-        CLMemory<cl_uchar>::setKernelArg(d.m_kernelIterate, 2, m_cfg.scoreMin);
-
-        lock_guard<mutex> lock(m_mutex);
-        if (i >= m_clScoreMax) {
-          m_clScoreMax = i;
-          printResult(r, i, m_cfg.timeStart);
-        }
-
-        break;
-      }
+  const auto nsCallback = Trace::now();
+
+  if (m_cfg.profiling) {
+    collectEvents(d);
+  }
+
+  // The kernel keeps the first result of every score and job, the verifier passes each one on once. There
+  // are none before the first launch, when zero-copy results aren't mapped yet. The kernel's counts only
+  // grow until the device is reset and start from 0 again with its baseline, hits count what they grew by.
+  unsigned long long hits[ERADICATE2_MAX_SCORE + 1] = {0};
+  for (size_t j = 0; d.m_launches != 0 && j < m_vJobs.size(); ++j) {
+    const result* const pResults = &d.m_memResult[j * (ERADICATE2_MAX_SCORE + 1)];
+    for (int i = ERADICATE2_MAX_SCORE; i > static_cast<int>(m_vJobs[j].scoreMin); --i) {
+      const result& r = pResults[i];
+      if (r.found == 0) continue;
+      cl_uint& found = d.m_vFound[j * (ERADICATE2_MAX_SCORE + 1) + i];
+      hits[i] += r.found - found;
+      found = r.found;
+      m_pVerifier->push(Hit{d.m_index, j, m_vJobs[j].jobId, static_cast<cl_uchar>(i), r});
+    }
+  }
+
+  for (size_t i = 0; i < ERADICATE2_MAX_SCORE + 1; ++i) {
+    if (hits[i] != 0) {
+      d.m_statHits[i] += hits[i];
+    }
+  }
+
+  // Copied results lag a launch behind, the newest one is still in flight unless it's the last one
+  size_t salts = 0;
+  while (d.m_dInFlight.size() > (d.m_bZeroCopy || d.m_bDrain ? 0 : 1)) {
+    if (m_pScheduler) {
+      m_pScheduler->completed(d.m_dInFlight.front().job);
+      salts += m_vJobs[d.m_dInFlight.front().job].size;
+    }
+    d.m_dInFlight.pop_front();
+  }
+
+  // Scheduled rounds differ in size, they count with the salts that completed
+  if (d.m_parent.m_speed.update(m_pScheduler ? salts : d.m_parent.m_size, d.m_index) && m_callbacks.onSpeed) {
+    m_callbacks.onSpeed(m_speed.snapshot());
+  }
+  ++d.m_statRounds;
+
+  // Rounds a failed device left unfinished come first, with its index so they cover the same salts. A device
+  // whose own rounds would wrap the salt layout's round counter stops instead of hashing its salts again,
+  // when scheduled that's per job, and it also stops once every job has run its rounds.
+  bool bLaunch = !m_quit;
+  Launch launch{static_cast<cl_uint>(d.m_index), d.m_round + 1, 0};
+  if (bLaunch) {
+    lock_guard<mutex> lock(m_mutex);
+    if (!m_dOrphans.empty()) {
+      launch = m_dOrphans.front();
+      m_dOrphans.pop_front();
+      ++d.m_statReassigned;
+    } else if (m_pScheduler) {
+      bLaunch = m_pScheduler->next([&](const size_t j) { return d.m_vRounds[j] < m_cfg.roundMax; }, launch.job);
+      launch.round = bLaunch ? ++d.m_vRounds[launch.job] : 0;
+    } else if (d.m_round < m_cfg.roundMax) {
+      ++d.m_round;
     } else {
-      string addr = toHex(r.hash, 20);
-      // lock_guard<mutex> lock(m_mutex);
-      if (saved.find(addr) == saved.end()) {
-        saved.insert(addr);
-        outfile << i << ",0x" << toHex(r.salt, 32) << ",0x" << addr << endl;
-      }
+      bLaunch = false;
     }
   }
 
-  d.m_parent.m_speed.update(d.m_parent.m_size, d.m_index);
+  // Copied results of the last launch are read once more before the device stops
+  if (!bLaunch && !m_quit && !d.m_bZeroCopy && !d.m_dInFlight.empty()) {
+    d.m_bDrain = true;
+    cl_event event;
+    d.m_nsReadEnqueued = Trace::now();
+    d.m_memResult.read(false, &event);
+    if (m_cfg.profiling) {
+      d.m_eventRead = event;
+      d.m_roundRead = d.m_dInFlight.back().round;
+    }
+    clFlush(d.m_clQueue);
+
+    const auto res = clSetEventCallback(event, CL_COMPLETE, staticCallback, &d);
+    OpenCLException::throwIfError("failed to set custom callback", res);
+    return;
+  }
+
+  if (!bLaunch) {
+    if (!m_quit && m_pScheduler && m_pScheduler->done()) {
+      log("GPU" + lexical_cast::write(d.m_index) + " has no rounds of any job left, stopping it");
+    } else if (!m_quit) {
+      log("warning: GPU" + lexical_cast::write(d.m_index) + " has run all " + lexical_cast::write(m_cfg.roundMax) + " rounds of the salt layout, stopping it");
+    }
 
-  if (m_quit) {
     lock_guard<mutex> lock(m_mutex);
     if (--m_countRunning == 0) {
       clSetUserEventStatus(m_eventFinished, CL_COMPLETE);
     }
   } else {
+    // Copied results are read before the next round so it runs while they're processed. Mapped results
+    // can't be mapped while a kernel writes them, they're handed back and mapped again after the round.
     cl_event event;
-    d.m_memResult.read(false, &event);
+    if (d.m_bZeroCopy) {
+      d.m_memResult.write(false);
+    } else {
+      d.m_nsReadEnqueued = Trace::now();
+      d.m_memResult.read(false, &event);
+    }
+
+    // Copied results are those of the launch before, mapped ones those of this launch
+    const cl_ulong roundRead = d.m_bZeroCopy ? launch.round : d.m_dInFlight.empty() ? 0 : d.m_dInFlight.back().round;
+    d.m_dInFlight.push_back(launch);
+    ++d.m_launches;
+
+    // A scheduled round runs its job alone, on the job's part of the global range
+    size_t offset = 0;
+    size_t size = m_size;
+    if (m_pScheduler) {
+      for (size_t j = 0; j < launch.job; ++j) {
+        offset += m_vJobs[j].size;
+      }
+      size = m_vJobs[launch.job].size;
+    }
+
+    cl_kernel& clKernel = m_bJobs ? d.m_kernelJobs : d.m_kernelIterate;
+    CLMemory<cl_uint>::setKernelArg(clKernel, 3, SaltTemplate::deviceId(m_cfg.workerId, launch.deviceIndex));
+    CLMemory<cl_ulong>::setKernelArg(clKernel, 4, launch.round);
+    vector<cl_event> vEvents;
+    enqueueKernelDevice(d, clKernel, offset, size, m_cfg.profiling ? &vEvents : NULL);
+    for (auto& e : vEvents) {
+      d.m_vKernelEvents.push_back(make_pair(e, launch.round));
+    }
 
-    CLMemory<cl_uint>::setKernelArg(d.m_kernelIterate, 4, ++d.m_round);  // Round information updated in deviceDispatch()
-    enqueueKernelDevice(d, d.m_kernelIterate, m_size);
+    if (d.m_bZeroCopy) {
+      d.m_nsReadEnqueued = Trace::now();
+      d.m_memResult.read(false, &event);
+    }
+
+    if (m_cfg.profiling) {
+      d.m_eventRead = event;
+      d.m_roundRead = roundRead;
+    }
     clFlush(d.m_clQueue);
 
+    const auto nsCallbackEnd = Trace::now();
+    d.m_statCallbackNs += nsCallbackEnd - nsCallback;
+    if (m_pTrace) {
+      m_pTrace->complete("callback", d.m_index, 2, nsCallback, nsCallbackEnd, "\"launched\":" + lexical_cast::write(launch.round));
+    }
+
     const auto res = clSetEventCallback(event, CL_COMPLETE, staticCallback, &d);
     OpenCLException::throwIfError("failed to set custom callback", res);
   }
@@ -248,12 +528,306 @@ void Dispatcher::deviceDispatch(Device& d) {
 // 	}
 // }
 
-void CL_CALLBACK Dispatcher::staticCallback(cl_event event, cl_int event_command_exec_status, void* user_data) {
-  if (event_command_exec_status != CL_COMPLETE) {
-    throw runtime_error("Dispatcher::onEvent - Got bad status" + lexical_cast::write(event_command_exec_status));
+// deviceDispatch() for the first launch and every callback, a device that throws fails alone
+void Dispatcher::dispatch(Device& d) {
+  try {
+    deviceDispatch(d);
+  } catch (runtime_error& e) {
+    deviceFailed(d, e.what());
+  }
+}
+
+// A failed device stops dispatching while the others go on. Its launches in flight are run by whichever
+// device dispatches next, and it's retried after a backoff that doubles with every failure in a row until
+// it has failed more than the config's retries times, then it's given up on. run() only throws once every
+// device has been given up on, and logs the rounds nobody ran when the others had already stopped.
+void Dispatcher::deviceFailed(Device& d, const string& reason) {
+  ++d.m_statFailures;
+  ++d.m_failures;
+  m_speed.reset(d.m_index);
+
+  lock_guard<mutex> lock(m_mutex);
+  m_dOrphans.insert(m_dOrphans.end(), d.m_dInFlight.begin(), d.m_dInFlight.end());
+  d.m_dInFlight.clear();
+
+  const string strDevice = "GPU" + lexical_cast::write(d.m_index);
+  if (!m_quit && d.m_failures <= m_cfg.retries) {
+    const unsigned int backoffMs = m_cfg.retryBackoffMs << min(d.m_failures - 1, 16u);
+    log("warning: " + strDevice + " failed (" + reason + "), retrying in " + lexical_cast::write(backoffMs) + " ms");
+    m_vRetryThreads.emplace_back(&Dispatcher::deviceRetry, this, ref(d), backoffMs);
+    return;
+  }
+
+  log("warning: " + strDevice + " failed (" + reason + ")" + (m_quit ? "" : ", giving up on it"));
+  if (!m_quit) {
+    d.m_bFailed = true;
+    ++m_countFailed;
+  }
+
+  if (--m_countRunning == 0) {
+    clSetUserEventStatus(m_eventFinished, CL_COMPLETE);
+  }
+}
+
+void Dispatcher::deviceRetry(Device& d, const unsigned int backoffMs) {
+  const auto timeRetry = chrono::steady_clock::now() + chrono::milliseconds(backoffMs);
+  while (!m_quit && chrono::steady_clock::now() < timeRetry) {
+    this_thread::sleep_for(chrono::milliseconds(10));
   }
 
+  if (m_quit) {
+    lock_guard<mutex> lock(m_mutex);
+    if (--m_countRunning == 0) {
+      clSetUserEventStatus(m_eventFinished, CL_COMPLETE);
+    }
+    return;
+  }
+
+  ++d.m_statRetries;
+  log("GPU" + lexical_cast::write(d.m_index) + " retrying");
+  try {
+    deviceReset(d);
+  } catch (runtime_error& e) {
+    deviceFailed(d, e.what());
+    return;
+  }
+
+  dispatch(d);
+}
+
+// Waits for whatever the device still has queued and clears its results, the next dispatch is a first launch
+void Dispatcher::deviceReset(Device& d) {
+  clFinish(d.m_clQueue);
+  d.m_launches = 0;
+  d.m_bDrain = false;
+  d.m_dInFlight.clear();
+
+  d.m_memResult.invalidate();
+  for (size_t i = 0; i < (ERADICATE2_MAX_SCORE + 1) * m_maxJobs; ++i) {
+    d.m_memResult[i].found = 0;
+  }
+  d.m_vFound.assign((ERADICATE2_MAX_SCORE + 1) * m_maxJobs, 0);
+
+  d.m_memResult.write(true);
+}
+
+// Called from the callback of the result read, which is still alive and complete. Kernels enqueued after
+// that read may still be running and are kept for the next callback.
+void Dispatcher::collectEvents(Device& d) {
+  if (d.m_eventRead) {
+    if (!d.m_bClockOffset) {
+      // Profiling timestamps are on the device clock, align them with the host using the first read
+      d.m_nsClockOffset = d.m_nsReadEnqueued - static_cast<long long>(getProfilingTime(d.m_eventRead, CL_PROFILING_COMMAND_QUEUED));
+      d.m_bClockOffset = true;
+    }
+
+    traceEvent(d, d.m_bZeroCopy ? "map" : "read", d.m_eventRead, d.m_roundRead);
+    d.m_eventRead = NULL;
+  }
+
+  auto it = d.m_vKernelEvents.begin();
+  while (it != d.m_vKernelEvents.end()) {
+    cl_int status = CL_QUEUED;
+    clGetEventInfo(it->first, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+    if (status != CL_COMPLETE) {
+      ++it;
+      continue;
+    }
+
+    d.m_statKernelNs += getProfilingTime(it->first, CL_PROFILING_COMMAND_END) - getProfilingTime(it->first, CL_PROFILING_COMMAND_START);
+    traceEvent(d, "kernel", it->first, it->second);
+    clReleaseEvent(it->first);
+    it = d.m_vKernelEvents.erase(it);
+  }
+}
+
+void Dispatcher::traceEvent(Device& d, const string& name, cl_event event, const cl_ulong round) {
+  if (!m_pTrace) {
+    return;
+  }
+
+  const long long queued = getProfilingTime(event, CL_PROFILING_COMMAND_QUEUED) + d.m_nsClockOffset;
+  const long long submit = getProfilingTime(event, CL_PROFILING_COMMAND_SUBMIT) + d.m_nsClockOffset;
+  const long long start = getProfilingTime(event, CL_PROFILING_COMMAND_START) + d.m_nsClockOffset;
+  const long long end = getProfilingTime(event, CL_PROFILING_COMMAND_END) + d.m_nsClockOffset;
+
+  const string args = "\"round\":" + lexical_cast::write(round) + ",\"submit_us\":" + lexical_cast::write((submit - queued) / 1000.0);
+  m_pTrace->complete(name + " pending", d.m_index, 1, queued, start, args);
+  m_pTrace->complete(name, d.m_index, 0, start, end, args);
+}
+
+void Dispatcher::stop() {
+  m_quit = true;
+}
+
+void Dispatcher::setShare(const size_t jobIndex, const unsigned int weight, const int priority) {
+  if (!m_pScheduler) {
+    throw runtime_error("jobs are only given shares when they're scheduled");
+  }
+
+  m_pScheduler->setShare(jobIndex, weight, priority);
+}
+
+Speed::Snapshot Dispatcher::speed() const {
+  return m_speed.snapshot();
+}
+
+void Dispatcher::log(const string& s) const {
+  if (m_callbacks.onLog) {
+    m_callbacks.onLog(s);
+  }
+}
+
+string Dispatcher::metrics() const {
+  ostringstream oss;
+
+  oss << "# HELP eradicate2_hashrate Hashes per second over the sample window." << endl;
+  oss << "# TYPE eradicate2_hashrate gauge" << endl;
+  for (auto& d : m_vDevices) {
+    oss << "eradicate2_hashrate{device=\"" << d->m_index << "\"} " << m_speed.getSpeed(d->m_index) << endl;
+  }
+
+  oss << "# HELP eradicate2_rounds_total Rounds completed." << endl;
+  oss << "# TYPE eradicate2_rounds_total counter" << endl;
+  for (auto& d : m_vDevices) {
+    oss << "eradicate2_rounds_total{device=\"" << d->m_index << "\"} " << d->m_statRounds << endl;
+  }
+
+  oss << "# HELP eradicate2_kernel_seconds_total Time spent executing kernels, from OpenCL profiling events." << endl;
+  oss << "# TYPE eradicate2_kernel_seconds_total counter" << endl;
+  for (auto& d : m_vDevices) {
+    oss << "eradicate2_kernel_seconds_total{device=\"" << d->m_index << "\"} " << d->m_statKernelNs / 1e9 << endl;
+  }
+
+  oss << "# HELP eradicate2_callback_seconds_total Time spent in the host callback between rounds." << endl;
+  oss << "# TYPE eradicate2_callback_seconds_total counter" << endl;
+  for (auto& d : m_vDevices) {
+    oss << "eradicate2_callback_seconds_total{device=\"" << d->m_index << "\"} " << d->m_statCallbackNs / 1e9 << endl;
+  }
+
+  oss << "# HELP eradicate2_device_up Whether the device is still searching, 0 once it has been given up on." << endl;
+  oss << "# TYPE eradicate2_device_up gauge" << endl;
+  for (auto& d : m_vDevices) {
+    oss << "eradicate2_device_up{device=\"" << d->m_index << "\"} " << (d->m_bFailed ? 0 : 1) << endl;
+  }
+
+  oss << "# HELP eradicate2_device_failures_total Failed launches, callbacks and retries." << endl;
+  oss << "# TYPE eradicate2_device_failures_total counter" << endl;
+  for (auto& d : m_vDevices) {
+    oss << "eradicate2_device_failures_total{device=\"" << d->m_index << "\"} " << d->m_statFailures << endl;
+  }
+
+  oss << "# HELP eradicate2_device_retries_total Times the device was retried after failing." << endl;
+  oss << "# TYPE eradicate2_device_retries_total counter" << endl;
+  for (auto& d : m_vDevices) {
+    oss << "eradicate2_device_retries_total{device=\"" << d->m_index << "\"} " << d->m_statRetries << endl;
+  }
+
+  oss << "# HELP eradicate2_rounds_reassigned_total Rounds left unfinished by failed devices that this device ran." << endl;
+  oss << "# TYPE eradicate2_rounds_reassigned_total counter" << endl;
+  for (auto& d : m_vDevices) {
+    oss << "eradicate2_rounds_reassigned_total{device=\"" << d->m_index << "\"} " << d->m_statReassigned << endl;
+  }
+
+  oss << "# HELP eradicate2_hits_total Hashes found per score, as counted by the kernel." << endl;
+  oss << "# TYPE eradicate2_hits_total counter" << endl;
+  for (auto& d : m_vDevices) {
+    for (size_t i = 0; i < ERADICATE2_MAX_SCORE + 1; ++i) {
+      if (d->m_statHits[i] != 0) {
+        oss << "eradicate2_hits_total{device=\"" << d->m_index << "\",score=\"" << i << "\"} " << d->m_statHits[i] << endl;
+      }
+    }
+  }
+
+  if (m_pVerifier) {
+    const auto mismatches = m_pVerifier->mismatches();
+    oss << "# HELP eradicate2_verify_mismatches_total Results whose salt doesn't derive the reported address and score on the host." << endl;
+    oss << "# TYPE eradicate2_verify_mismatches_total counter" << endl;
+    for (auto& d : m_vDevices) {
+      const auto it = mismatches.find(d->m_index);
+      oss << "eradicate2_verify_mismatches_total{device=\"" << d->m_index << "\"} " << (it == mismatches.end() ? 0 : it->second) << endl;
+    }
+
+    oss << "# HELP eradicate2_verified_total Distinct results verified on the host." << endl;
+    oss << "# TYPE eradicate2_verified_total counter" << endl;
+    oss << "eradicate2_verified_total " << m_pVerifier->verified() << endl;
+
+    oss << "# HELP eradicate2_verify_queue_depth Results waiting to be verified." << endl;
+    oss << "# TYPE eradicate2_verify_queue_depth gauge" << endl;
+    oss << "eradicate2_verify_queue_depth " << m_pVerifier->depth() << endl;
+
+    unsigned long long dedupHits = m_pVerifier->repeats();
+    for (auto& w : m_mWriters) {
+      dedupHits += w.second->dedupHits();
+    }
+
+    oss << "# HELP eradicate2_dedup_hits_total Results skipped because they were already reported or written." << endl;
+    oss << "# TYPE eradicate2_dedup_hits_total counter" << endl;
+    oss << "eradicate2_dedup_hits_total " << dedupHits << endl;
+  }
+
+  if (m_pScheduler) {
+    const auto vStats = m_pScheduler->stats();
+    oss << "# HELP eradicate2_job_rounds_total Rounds of the job that completed, when jobs are scheduled." << endl;
+    oss << "# TYPE eradicate2_job_rounds_total counter" << endl;
+    for (size_t i = 0; i < vStats.size(); ++i) {
+      oss << "eradicate2_job_rounds_total{job=\"" << m_vJobs[i].jobId << "\"} " << vStats[i].rounds << endl;
+    }
+
+    oss << "# HELP eradicate2_job_salts_total Salts of the job's completed rounds, when jobs are scheduled." << endl;
+    oss << "# TYPE eradicate2_job_salts_total counter" << endl;
+    for (size_t i = 0; i < vStats.size(); ++i) {
+      oss << "eradicate2_job_salts_total{job=\"" << m_vJobs[i].jobId << "\"} " << vStats[i].salts << endl;
+    }
+
+    oss << "# HELP eradicate2_job_share Share of the salts the job is meant to get, 0 while it waits for higher priorities and once it's done." << endl;
+    oss << "# TYPE eradicate2_job_share gauge" << endl;
+    for (size_t i = 0; i < vStats.size(); ++i) {
+      oss << "eradicate2_job_share{job=\"" << m_vJobs[i].jobId << "\"} " << vStats[i].share << endl;
+    }
+  }
+
+  if (!m_mWriters.empty()) {
+    unsigned long long written = 0;
+    size_t depth = 0;
+    for (auto& w : m_mWriters) {
+      written += w.second->written();
+      depth += w.second->depth();
+    }
+
+    oss << "# HELP eradicate2_results_written_total Results written to the output files." << endl;
+    oss << "# TYPE eradicate2_results_written_total counter" << endl;
+    oss << "eradicate2_results_written_total " << written << endl;
+
+    oss << "# HELP eradicate2_writer_queue_depth Results waiting to be written." << endl;
+    oss << "# TYPE eradicate2_writer_queue_depth gauge" << endl;
+    oss << "eradicate2_writer_queue_depth " << depth << endl;
+  }
+
+  if (m_pStore) {
+    oss << "# HELP eradicate2_store_records Records in the result store, including earlier runs." << endl;
+    oss << "# TYPE eradicate2_store_records gauge" << endl;
+    oss << "eradicate2_store_records " << m_pStore->size() << endl;
+  }
+
+  return oss.str();
+}
+
+cl_ulong Dispatcher::getProfilingTime(cl_event event, cl_profiling_info param) {
+  cl_ulong t = 0;
+  clGetEventProfilingInfo(event, param, sizeof(t), &t, NULL);
+  return t;
+}
+
+void CL_CALLBACK Dispatcher::staticCallback(cl_event event, cl_int event_command_exec_status, void* user_data) {
   Device* const pDevice = static_cast<Device*>(user_data);
-  pDevice->m_parent.deviceDispatch(*pDevice);
+  if (event_command_exec_status == CL_COMPLETE) {
+    pDevice->m_failures = 0;
+    pDevice->m_parent.dispatch(*pDevice);
+  } else {
+    // Throwing here would unwind through the driver's thread, the device is dealt with on its own instead
+    pDevice->m_parent.deviceFailed(*pDevice, "event status " + lexical_cast::write(event_command_exec_status));
+  }
+
   clReleaseEvent(event);
 }
@@ -1,12 +1,17 @@
 #ifndef HPP_DISPATCHER
 #define HPP_DISPATCHER
 
+#include <atomic>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <magic_enum.hpp>
+#include <map>
 #include <mutex>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #if defined(__APPLE__) || defined(__MACOSX)
@@ -17,16 +22,43 @@
 #endif
 
 #include "CLMemory.hpp"
+#include "ResultStore.hpp"
+#include "ResultWriter.hpp"
+#include "Scheduler.hpp"
 #include "Speed.hpp"
+#include "Trace.hpp"
+#include "Verifier.hpp"
 #include "types.hpp"
 
-#define ERADICATE2_MAX_SCORE 40
 #define ERADICATE2_SPEEDSAMPLES 20
 #define ERADICATE2_MIN_SCORE 1
 
 using namespace std;
 
 class Dispatcher {
+ public:
+  // Called from OpenCL callback and verifier threads, they must not block for long
+  struct Callbacks {
+    function<void(const Hit &)> onHit;                  // Verified result above the minimum score, once per result
+    function<void(const Speed::Snapshot &)> onSpeed;  // Twice a second at most
+    function<void(const string &)> onLog;             // Warnings and progress
+  };
+
+  // One of several searches sharing every round of the devices, or taking turns when scheduled, see run()
+  struct Job {
+    ethhash initHash;
+    mode m;
+    unsigned int scoreMin;
+    size_t size;      // Salts of every round that go to this job, or of each of its rounds when scheduled
+    string fileName;  // Verified results are appended here unless it's empty
+    cl_ulong jobId;   // Passed on in Hit and stored with the results
+
+    // Only when scheduled, see Scheduler
+    unsigned int weight;
+    int priority;
+    cl_ulong rounds;  // Rounds of all devices together before the job is done, 0 for no end
+  };
+
  private:
   class OpenCLException : public runtime_error {
    public:
@@ -37,11 +69,18 @@ class Dispatcher {
     const cl_int m_res;
   };
 
+  // The salts of a launch, as the device index and round they belong to, and its job when scheduled
+  struct Launch {
+    cl_uint deviceIndex;
+    cl_ulong round;
+    size_t job;
+  };
+
   struct Device {
-    static cl_command_queue createQueue(cl_context &clContext, cl_device_id &clDeviceId);
+    static cl_command_queue createQueue(cl_context &clContext, cl_device_id &clDeviceId, const bool bProfiling);
     static cl_kernel createKernel(cl_program &clProgram, const string s);
 
-    Device(Dispatcher &parent, cl_context &clContext, cl_program &clProgram, cl_device_id clDeviceId, const size_t worksizeLocal, const size_t size, const size_t index);
+    Device(Dispatcher &parent, cl_context &clContext, cl_program &clProgram, cl_device_id clDeviceId, const size_t worksizeLocal, const size_t size, const size_t index, const size_t maxJobs);
     ~Device();
 
     Dispatcher &m_parent;
@@ -49,55 +88,124 @@ class Dispatcher {
 
     cl_device_id m_clDeviceId;
     size_t m_worksizeLocal;
-    cl_uchar m_clScoreMax;
     cl_command_queue m_clQueue;
+    const bool m_bZeroCopy;  // Buffers are mapped instead of copied, see isHostUnified()
 
     cl_kernel m_kernelIterate;
+    cl_kernel m_kernelJobs;
 
-    CLMemory<result> m_memResult;
+    CLMemory<result> m_memResult;  // ERADICATE2_MAX_SCORE + 1 slots for every job
     CLMemory<mode> m_memMode;
-
-    cl_uint m_round;
+    CLMemory<job> m_memJobs;
+
+    cl_ulong m_round;            // Last round of the device's own salts launched
+    vector<cl_ulong> m_vRounds;  // The same for every job when scheduled
+    cl_uint m_launches;          // Launches since start or the last retry, results are only read after the first
+    bool m_bDrain;               // Reading the copied results of the last launch before stopping
+
+    // Launches whose results haven't been processed yet, a failed device's are run by the others
+    deque<Launch> m_dInFlight;
+
+    // Failure handling, see deviceFailed()
+    unsigned int m_failures;  // Since the last round that completed
+    bool m_bFailed;           // Given up on
+
+    // Profiling, kernel events are kept until they complete
+    vector<pair<cl_event, cl_ulong>> m_vKernelEvents;
+    cl_event m_eventRead;
+    cl_ulong m_roundRead;  // Round whose results m_eventRead reads
+    long long m_nsReadEnqueued;
+    long long m_nsClockOffset;
+    bool m_bClockOffset;
+
+    // Kernel counts of every job and score as last seen, hits count what they grew by
+    vector<cl_uint> m_vFound;
+
+    // Statistics, written from the device callback and read by metrics()
+    atomic<unsigned long long> m_statRounds;
+    atomic<unsigned long long> m_statKernelNs;
+    atomic<unsigned long long> m_statCallbackNs;
+    atomic<unsigned long long> m_statHits[ERADICATE2_MAX_SCORE + 1];
+    atomic<unsigned long long> m_statFailures;
+    atomic<unsigned long long> m_statRetries;
+    atomic<unsigned long long> m_statReassigned;  // Rounds of failed devices this one ran
   };
 
  public:
-  Dispatcher(cl_context &clContext, cl_program &clProgram, const size_t worksizeMax, const size_t size, const config cfg);
+  // Up to maxJobs jobs can be run at once with run(vJobs)
+  Dispatcher(cl_context &clContext, const size_t worksizeMax, const size_t size, const config cfg, const Callbacks &callbacks, const size_t maxJobs = 1);
   ~Dispatcher();
 
-  void addDevice(cl_device_id clDeviceId, const size_t worksizeLocal, const size_t index);
-  void run(const mode &mode);
+  // Every device can run its own build of the program, e.g. with a different Keccak variant
+  void addDevice(cl_device_id clDeviceId, cl_program &clProgram, const size_t worksizeLocal, const size_t index);
+
+  // The job described by the config, on eradicate2_iterate with the initial state built into the program.
+  // Hits are verified with the pattern, weights, constraint and guard the program was built with.
+  void run(const mode &mode, const Pattern &pattern = Pattern(), const Weights &weights = Weights(), const Constraint &constraint = Constraint(), const Guard &guard = Guard());
+
+  // Every round runs all jobs in one eradicate2_iterate_jobs launch, each on its share of the global range.
+  // The config's initial state, output file and job id are ignored, all jobs share the program's salt
+  // template, pattern, weights, constraint and guard. If the config schedules them, every round runs one
+  // job on its part of the range instead, as the Scheduler picks it by weight and priority, and devices stop
+  // once every job has run its rounds.
+  void run(const vector<Job> &vJobs, const Pattern &pattern = Pattern(), const Weights &weights = Weights(), const Constraint &constraint = Constraint(), const Guard &guard = Guard());
+
+  // Devices finish the round they're on and run() returns, safe to call from any thread
+  void stop();
+
+  // Changes the share of a job of the scheduled run, from the next round of every device on
+  void setShare(const size_t jobIndex, const unsigned int weight, const int priority);
+
+  string metrics() const;
+  Speed::Snapshot speed() const;
 
  private:
+  void start(const vector<Job> &vJobs, const Pattern &pattern, const Weights &weights, const Constraint &constraint, const Guard &guard, const bool bJobs);
   void deviceDispatch(Device &d);
+  void dispatch(Device &d);
+  void deviceFailed(Device &d, const string &reason);
+  void deviceRetry(Device &d, const unsigned int backoffMs);
+  void deviceReset(Device &d);
+  void collectEvents(Device &d);
+  void traceEvent(Device &d, const string &name, cl_event event, const cl_ulong round);
 
-  void enqueueKernel(cl_command_queue &clQueue, cl_kernel &clKernel, size_t worksizeGlobal, const size_t worksizeLocal, cl_event *pEvent);
-  void enqueueKernelDevice(Device &d, cl_kernel &clKernel, size_t worksizeGlobal, cl_event *pEvent);
+  void enqueueKernel(cl_command_queue &clQueue, cl_kernel &clKernel, size_t worksizeOffset, size_t worksizeGlobal, const size_t worksizeLocal, vector<cl_event> *pEvents);
+  void enqueueKernelDevice(Device &d, cl_kernel &clKernel, const size_t worksizeOffset, size_t worksizeGlobal, vector<cl_event> *pEvents);
 
-  void printSpeed();
+  void log(const string &s) const;
 
  private:
   static void CL_CALLBACK staticCallback(cl_event event, cl_int event_command_exec_status, void *user_data);
 
-  static string formatSpeed(double s);
+  static cl_ulong getProfilingTime(cl_event event, cl_profiling_info param);
 
  private: /* Instance variables */
   cl_context &m_clContext;
-  cl_program &m_clProgram;
   const size_t m_worksizeMax;
-  const size_t m_size;
-  cl_uchar m_clScoreMax;
+  size_t m_size;  // Salts per round on every device, all jobs together
+  const size_t m_maxJobs;
   vector<Device *> m_vDevices;
 
   cl_event m_eventFinished;
 
   // Run information
   const config m_cfg;
+  const Callbacks m_callbacks;
   mutex m_mutex;
-  chrono::time_point<chrono::steady_clock> timeStart;
   Speed m_speed;
-  unsigned int m_countPrint;
-  unsigned int m_countRunning;
-  bool m_quit;
+  vector<Job> m_vJobs;
+  bool m_bJobs;
+  map<string, ResultWriter *> m_mWriters;  // By file name, jobs may share one
+  vector<ResultWriter *> m_vJobWriters;    // By job, NULL if it has no file
+  ResultStore *m_pStore;
+  Verifier *m_pVerifier;
+  Scheduler *m_pScheduler;  // NULL unless the run is scheduled
+  Trace *m_pTrace;
+  unsigned int m_countRunning;  // Devices dispatching or waiting to retry
+  unsigned int m_countFailed;
+  deque<Launch> m_dOrphans;  // In flight on devices that failed
+  vector<thread> m_vRetryThreads;
+  atomic<bool> m_quit;
 };
 
 #endif /* HPP_DISPATCHER */
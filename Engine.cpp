@@ -0,0 +1,280 @@
+#include "Engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include "CLMemory.hpp"
+#include "ModeFactory.hpp"
+#include "clutil.hpp"
+#include "hexadecimal.hpp"
+
+namespace {
+// Best of a few launches in the Benchmark mode, which spends all its time hashing. Programs built from SPIR-V
+// only have a usable eradicate2_iterate_jobs, it's given a single job with the initial state.
+double hashesPerSecond(cl_context& clContext, cl_program& clProgram, cl_device_id clDeviceId, size_t worksizeLocal, const bool bJobs, const ethhash& initHash) {
+  const size_t size = 1048576;
+  const string strKernel = bJobs ? "eradicate2_iterate_jobs" : "eradicate2_iterate";
+  cl_command_queue clQueue = createQueue(clContext, clDeviceId);
+  cl_kernel clKernel = clCreateKernel(clProgram, strKernel.c_str(), NULL);
+  if (clKernel == NULL) {
+    clReleaseCommandQueue(clQueue);
+    throw runtime_error("failed to create kernel " + strKernel);
+  }
+
+  double best = 0;
+  {
+    CLMemory<result> memResult(clContext, clQueue, CL_MEM_READ_WRITE, ERADICATE2_MAX_SCORE + 1);
+    CLMemory<mode> memMode(clContext, clQueue, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, 1);
+    CLMemory<job> memJobs(clContext, clQueue, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, 1);
+
+    // Nothing scores above the maximum, so the results are never written
+    const cl_uchar scoreMax = ERADICATE2_MAX_SCORE;
+    const cl_uint deviceId = 0;
+    memResult.setKernelArg(clKernel, 0);
+    if (bJobs) {
+      memset(&memJobs[0], 0, sizeof(job));
+      memJobs[0].init = initHash;
+      memJobs[0].m = ModeFactory::benchmark();
+      memJobs[0].scoreMax = scoreMax;
+      memJobs.write(true);
+      memJobs.setKernelArg(clKernel, 1);
+      CLMemory<cl_uint>::setKernelArg(clKernel, 2, 1);
+    } else {
+      *memMode = ModeFactory::benchmark();
+      memMode.write(true);
+      memMode.setKernelArg(clKernel, 1);
+      CLMemory<cl_uchar>::setKernelArg(clKernel, 2, scoreMax);
+    }
+    CLMemory<cl_uint>::setKernelArg(clKernel, 3, deviceId);
+
+    // The first launch is a warm-up, it may include lazy compilation
+    for (cl_ulong round = 0; round < 4; ++round) {
+      CLMemory<cl_ulong>::setKernelArg(clKernel, 4, round);
+      const auto timeStart = chrono::steady_clock::now();
+      runKernel(clQueue, clKernel, size, worksizeLocal);
+      const auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timeStart).count();
+      if (round > 0 && ns > 0) {
+        best = max(best, size * 1e9 / ns);
+      }
+    }
+  }
+
+  clReleaseKernel(clKernel);
+  clReleaseCommandQueue(clQueue);
+  return best;
+}
+}  // namespace
+
+Engine::Job::Job() : m(ModeFactory::benchmark()), initHash({{0}}), scoreMin(6), worksizeLocal(128), worksizeMax(0), size(16777216), jobId(0), profiling(false), keccak(KeccakVariant::Auto), retries(3), retryBackoffMs(1000), workerId(0), spirv(true), exportRounds(0), schedule(false), weight(1), priority(0), rounds(0) {
+}
+
+Engine::Engine(const Job& job, const Dispatcher::Callbacks& callbacks) : Engine(vector<Job>{job}, callbacks) {
+}
+
+Engine::Engine(const vector<Job>& vJobs, const Dispatcher::Callbacks& callbacks) : m_vJobs(vJobs), m_job(m_vJobs.at(0)), m_callbacks(callbacks), m_clContext(NULL), m_bSpirv(false), m_pDispatcher(NULL), m_pExporter(NULL) {
+  if (!m_job.exportFileName.empty() && m_vJobs.size() > 1) {
+    throw runtime_error("an export runs a single job");
+  }
+
+  for (auto& j : m_vJobs) {
+    if (j.saltTemplate.str() != m_job.saltTemplate.str() || j.pattern.str() != m_job.pattern.str() || j.weights.str() != m_job.weights.str() || j.constraint.str() != m_job.constraint.str() || j.guard.str() != m_job.guard.str()) {
+      throw runtime_error("jobs run together must have the same salt template, pattern, weights, constraint and guard");
+    }
+  }
+
+  const auto log = [&](const string& s) {
+    if (m_callbacks.onLog) {
+      m_callbacks.onLog(s);
+    }
+  };
+
+  const vector<cl_device_id> vFoundDevices = getAllDevices();
+  vector<cl_device_id> vDevices;
+  vector<size_t> vDeviceIndex;
+
+  log("Devices:");
+  for (size_t i = 0; i < vFoundDevices.size(); ++i) {
+    if (find(m_job.vDeviceSkipIndex.begin(), m_job.vDeviceSkipIndex.end(), i) != m_job.vDeviceSkipIndex.end()) {
+      continue;
+    }
+
+    const cl_device_id deviceId = vFoundDevices[i];
+    const auto strName = clGetWrapperString(clGetDeviceInfo, deviceId, CL_DEVICE_NAME);
+    const auto computeUnits = clGetWrapper<cl_uint>(clGetDeviceInfo, deviceId, CL_DEVICE_MAX_COMPUTE_UNITS);
+    const auto globalMemSize = clGetWrapper<cl_ulong>(clGetDeviceInfo, deviceId, CL_DEVICE_GLOBAL_MEM_SIZE);
+
+    log("  GPU" + lexical_cast::write(i) + ": " + strName + ", " + lexical_cast::write(globalMemSize) + " bytes available, " + lexical_cast::write(computeUnits) + " compute units" + (isHostUnified(deviceId) ? ", zero-copy" : ""));
+    vDevices.push_back(deviceId);
+    vDeviceIndex.push_back(i);
+    m_vDevices.push_back(make_pair(i, strName));
+  }
+
+  if (vDevices.empty()) {
+    throw runtime_error("no OpenCL devices to run on");
+  }
+
+  // Devices of a fleet only hash distinct salts if every one of them gets its own device id
+  for (auto i : vDeviceIndex) {
+    if (SaltTemplate::deviceId(m_job.workerId, i) > m_job.saltTemplate.deviceIdMax()) {
+      throw runtime_error("worker id " + lexical_cast::write(m_job.workerId) + " and GPU" + lexical_cast::write(i) + " don't fit the salt template's " + lexical_cast::write(m_job.saltTemplate.deviceIdMax()) + " device ids, leave more bytes free");
+    }
+  }
+
+  cl_int errorCode;
+  log("Creating context and building program...");
+  m_clContext = clCreateContext(NULL, vDevices.size(), vDevices.data(), NULL, NULL, &errorCode);
+  if (m_clContext == NULL) {
+    throw runtime_error("failed to create context - " + lexical_cast::write(errorCode));
+  }
+
+  // Auto builds both Keccak variants and measures them on every device below
+  vector<KeccakVariant> vVariants = {m_job.keccak};
+  if (m_job.keccak == KeccakVariant::Auto) {
+    vVariants = {KeccakVariant::Lanes64, KeccakVariant::Interleaved32};
+  }
+
+  // Searches without generated source start from the embedded SPIR-V if every device takes it, which skips
+  // compiling OpenCL C. They run the jobs kernel, which reads the initial state from the job buffer. The
+  // export kernel needs the state built in.
+  const string strSource = m_job.saltTemplate.source() + m_job.pattern.source() + m_job.weights.source() + m_job.constraint.source() + m_job.guard.source();
+  if (m_job.spirv && strSource.empty() && m_job.exportFileName.empty()) {
+    for (auto v : vVariants) {
+      m_vPrograms.push_back(make_pair(v, buildProgramSpirv(m_clContext, vDevices, v)));
+    }
+
+    m_bSpirv = none_of(m_vPrograms.begin(), m_vPrograms.end(), [](const pair<KeccakVariant, cl_program>& p) { return p.second == NULL; });
+    if (m_bSpirv) {
+      log("Loaded the embedded SPIR-V");
+    } else {
+      for (auto& p : m_vPrograms) {
+        if (p.second != NULL) {
+          clReleaseProgram(p.second);
+        }
+      }
+      m_vPrograms.clear();
+    }
+  }
+
+  if (!m_bSpirv) {
+    const string strBuildOptions = "-D ERADICATE2_MAX_SCORE=" + lexical_cast::write(ERADICATE2_MAX_SCORE) + " -D ERADICATE2_INITHASH=" + makePreprocessorInitHashExpression(m_job.initHash);
+    for (auto v : vVariants) {
+      m_vPrograms.push_back(make_pair(v, buildProgram(m_clContext, vDevices, strBuildOptions + keccakBuildOption(v), strSource)));
+    }
+  }
+
+  // One variant failing to build is fine as long as the other does
+  m_vPrograms.erase(remove_if(m_vPrograms.begin(), m_vPrograms.end(), [](const pair<KeccakVariant, cl_program>& p) { return p.second == NULL; }), m_vPrograms.end());
+  if (m_vPrograms.empty()) {
+    clReleaseContext(m_clContext);
+    throw runtime_error("failed to build program");
+  }
+
+  vector<size_t> vDeviceProgram(vDevices.size(), 0);
+  if (m_vPrograms.size() > 1) {
+    log("Measuring Keccak variants...");
+    for (size_t i = 0; i < vDevices.size(); ++i) {
+      string strLine = "  GPU" + lexical_cast::write(vDeviceIndex[i]) + ":";
+      double best = 0;
+      for (size_t j = 0; j < m_vPrograms.size(); ++j) {
+        const double speed = hashesPerSecond(m_clContext, m_vPrograms[j].second, vDevices[i], m_job.worksizeLocal, m_bSpirv, m_job.initHash);
+        strLine += " " + keccakVariantName(m_vPrograms[j].first) + "-bit " + Speed::format(speed);
+        if (speed > best) {
+          best = speed;
+          vDeviceProgram[i] = j;
+        }
+      }
+      log(strLine + ", using " + keccakVariantName(m_vPrograms[vDeviceProgram[i]].first) + "-bit");
+    }
+  }
+
+  size_t size = 0;
+  for (auto& j : m_vJobs) {
+    size += j.size;
+  }
+
+  const config cfg{m_job.fileName, m_job.scoreMin, chrono::steady_clock::now(), m_job.profiling || !m_job.traceFileName.empty(), m_job.traceFileName, m_job.initHash, m_job.storeFileName, m_job.jobId, m_job.retries, m_job.retryBackoffMs, m_job.workerId, m_job.saltTemplate.roundMax(), m_job.schedule};
+  if (!m_job.exportFileName.empty()) {
+    m_pExporter = new Exporter(m_clContext, size, cfg, m_callbacks, m_job.exportFileName, m_job.saltTemplate.enabled() ? m_job.saltTemplate.str() : "", m_job.guard.str());
+    for (size_t i = 0; i < vDevices.size(); ++i) {
+      m_pExporter->addDevice(vDevices[i], m_vPrograms[vDeviceProgram[i]].second, m_job.worksizeLocal, vDeviceIndex[i]);
+    }
+    return;
+  }
+
+  m_pDispatcher = new Dispatcher(m_clContext, m_job.worksizeMax == 0 ? size : m_job.worksizeMax, size, cfg, m_callbacks, m_vJobs.size());
+  log("Kernels:");
+  for (size_t i = 0; i < vDevices.size(); ++i) {
+    m_pDispatcher->addDevice(vDevices[i], m_vPrograms[vDeviceProgram[i]].second, m_job.worksizeLocal, vDeviceIndex[i]);
+  }
+}
+
+Engine::~Engine() {
+  delete m_pDispatcher;
+  delete m_pExporter;
+  for (auto& p : m_vPrograms) {
+    clReleaseProgram(p.second);
+  }
+  clReleaseContext(m_clContext);
+}
+
+void Engine::run() {
+  if (m_pExporter) {
+    m_pExporter->run(m_job.exportRounds);
+    return;
+  }
+
+  if (m_vJobs.size() == 1 && !m_bSpirv && !m_job.schedule) {
+    m_pDispatcher->run(m_job.m, m_job.pattern, m_job.weights, m_job.constraint, m_job.guard);
+    return;
+  }
+
+  vector<Dispatcher::Job> vJobs;
+  for (auto& j : m_vJobs) {
+    vJobs.push_back(Dispatcher::Job{j.initHash, j.m, j.scoreMin, j.size, j.fileName, j.jobId, j.weight, j.priority, j.rounds});
+  }
+
+  m_pDispatcher->run(vJobs, m_job.pattern, m_job.weights, m_job.constraint, m_job.guard);
+}
+
+void Engine::stop() {
+  if (m_pExporter) {
+    m_pExporter->stop();
+  } else {
+    m_pDispatcher->stop();
+  }
+}
+
+void Engine::setShare(const size_t jobIndex, const unsigned int weight, const int priority) {
+  if (m_pExporter) {
+    throw runtime_error("an export has no jobs to share the devices");
+  }
+
+  m_pDispatcher->setShare(jobIndex, weight, priority);
+}
+
+Speed::Snapshot Engine::speed() const {
+  return m_pExporter ? m_pExporter->speed() : m_pDispatcher->speed();
+}
+
+string Engine::metrics() const {
+  return m_pExporter ? m_pExporter->metrics() : m_pDispatcher->metrics();
+}
+
+vector<pair<size_t, string>> Engine::devices() const {
+  return m_vDevices;
+}
+
+ethhash Engine::makeInitHash(const string& c3Deployer, const string& c3ProxyHash, const string& c2Deployer, const SaltTemplate& saltTemplate, const unsigned long long seed) {
+  const string deployer = parseHexadecimalBytes(c3Deployer);
+  const string proxyHash = parseHexadecimalBytes(c3ProxyHash);
+  if (deployer.size() != 20 || proxyHash.size() != 32) {
+    throw runtime_error("deployer must be 20 bytes and proxy hash 32 bytes");
+  }
+
+  const string c2AddrBinary = keccakDigest(parseHexadecimalBytes(c2Deployer)).substr(12);
+  ethhash h = ::makeInitHash(deployer.data(), c2AddrBinary, proxyHash.data(), seed);
+  saltTemplate.apply(h, seed);
+  return h;
+}
@@ -0,0 +1,116 @@
+#ifndef HPP_ENGINE
+#define HPP_ENGINE
+
+#include <string>
+#include <vector>
+
+#include "Constraint.hpp"
+#include "Dispatcher.hpp"
+#include "Exporter.hpp"
+#include "Guard.hpp"
+#include "Pattern.hpp"
+#include "SaltTemplate.hpp"
+#include "Weights.hpp"
+#include "clutil.hpp"
+#include "types.hpp"
+
+using namespace std;
+
+/* Embeddable search engine, everything main() used to do between parsing the
+ * command line and printing. A job is described by a Job, results and progress
+ * arrive through Dispatcher::Callbacks and nothing is written to stdout. Every
+ * engine owns its own OpenCL context, programs and devices, so several can run
+ * in one process.
+ *
+ *   Engine::Job job;
+ *   job.m = ModeFactory::leading('0');
+ *   job.initHash = Engine::makeInitHash("0x...", "21c3...", "", job.saltTemplate);
+ *   Engine e(job, {[](const Hit& h) { ... }});
+ *   thread t([&] { e.run(); });
+ *   ...
+ *   e.stop();
+ *   t.join();
+ *
+ * Given several jobs, e.g. small searches for different deployers, an engine
+ * runs them all in every launch of eradicate2_iterate_jobs instead, each on
+ * size salts of the round, and hits carry the index and id of their job. Device
+ * selection, work sizes, the store, tracing, the worker id, the salt template,
+ * the pattern, the constraint and the guard are taken from the first job.
+ * When the first job says so, the jobs are scheduled instead: every round runs
+ * one of them, picked by its weight and priority, see Scheduler.
+ *
+ * A job with an export file streams every address to it instead of searching,
+ * see Exporter. Nothing is scored and there are no hits.
+ */
+class Engine {
+ public:
+  struct Job {
+    Job();
+
+    mode m;
+    ethhash initHash;
+    SaltTemplate saltTemplate;
+    Pattern pattern;        // Compiled into the program, scores hits when m is ModeFactory::pattern()
+    Weights weights;        // Compiled into the program, scores hits when m is ModeFactory::weights()
+    Constraint constraint;  // Compiled into the program, addresses outside it score 0 in every mode
+    Guard guard;            // Compiled into the program, the factory hashes the salt this way before CREATE3
+    unsigned int scoreMin;
+
+    // OpenCL device indices as enumerated by getAllDevices() to leave out
+    vector<size_t> vDeviceSkipIndex;
+    size_t worksizeLocal;
+    size_t worksizeMax;  // 0 means size
+    size_t size;
+
+    string fileName;       // Verified results are also appended here unless it's empty
+    string storeFileName;  // and to this ResultStore, tagged with jobId
+    cl_ulong jobId;
+    string traceFileName;
+    bool profiling;
+    KeccakVariant keccak;  // Auto builds both variants and gives every device the faster one
+    unsigned int retries;         // A failed device is retried this many times before the others go on without it
+    unsigned int retryBackoffMs;  // Wait before the first retry, doubled for every further one
+    cl_uint workerId;             // Unique per machine of a fleet sharing a deployer, goes into every salt
+    bool spirv;                   // Start from the embedded SPIR-V when nothing is generated, see buildProgramSpirv()
+    string exportFileName;        // Every address goes here instead of being scored, "-" is stdout
+    cl_ulong exportRounds;        // Rounds every device exports, 0 until stopped
+    bool schedule;                // Jobs take turns by round instead of sharing every launch, see Scheduler
+    unsigned int weight;          // When scheduled, share of the salts against the weights of the other jobs
+    int priority;                 // When scheduled, higher priorities run first
+    cl_ulong rounds;              // When scheduled, rounds of all devices together before the job is done, 0 for no end
+  };
+
+ public:
+  Engine(const Job& job, const Dispatcher::Callbacks& callbacks);
+  Engine(const vector<Job>& vJobs, const Dispatcher::Callbacks& callbacks);
+  ~Engine();
+
+  // Blocks until stop() is called from another thread or a callback
+  void run();
+  void stop();
+
+  // Changes a job's share from the next round of every device, only when scheduled
+  void setShare(const size_t jobIndex, const unsigned int weight, const int priority);
+
+  Speed::Snapshot speed() const;
+  string metrics() const;
+
+  // Device names by index for the devices this engine runs on
+  vector<pair<size_t, string>> devices() const;
+
+  // Initial state for a CREATE3 deployer, proxy init code hash and optional CREATE2 deployer, all hexadecimal
+  static ethhash makeInitHash(const string& c3Deployer, const string& c3ProxyHash, const string& c2Deployer, const SaltTemplate& saltTemplate, const unsigned long long seed = 0);
+
+ private:
+  const vector<Job> m_vJobs;
+  const Job& m_job;  // Settings shared by all jobs
+  const Dispatcher::Callbacks m_callbacks;
+  vector<pair<size_t, string>> m_vDevices;
+  cl_context m_clContext;
+  vector<pair<KeccakVariant, cl_program>> m_vPrograms;
+  bool m_bSpirv;  // Programs are from SPIR-V, every search goes through eradicate2_iterate_jobs
+  Dispatcher* m_pDispatcher;
+  Exporter* m_pExporter;  // Instead of the dispatcher when exporting
+};
+
+#endif /* HPP_ENGINE */
@@ -0,0 +1,279 @@
+#include "Estimator.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "Reference.hpp"
+#include "sha3.hpp"
+
+namespace {
+// Sampled levels need this many hits before they're trusted over extrapolation
+const size_t MinHits = 100;
+
+// 95% Wilson score interval of a proportion of hits out of n
+void wilson(const double hits, const double n, double& low, double& high) {
+  const double z = 1.959964;
+  const double d = n + z * z;
+  const double center = (hits + z * z / 2) / d;
+  const double half = z / d * sqrt(hits * (n - hits) / n + z * z / 4);
+  low = max(0.0, center - half);
+  high = min(1.0, center + half);
+}
+
+// Chance of at least s for every s, q^s up to the highest score
+vector<double> geometric(const double q, const int scoreMax) {
+  vector<double> v(ERADICATE2_MAX_SCORE + 1, 0.0);
+  for (int s = 0; s <= scoreMax; ++s) {
+    v[s] = pow(q, s);
+  }
+  return v;
+}
+
+// Number of independent events of the given chances that happen, tail of the Poisson binomial distribution
+vector<double> count(const vector<double>& vChances) {
+  vector<double> pmf(1, 1.0);
+  for (auto q : vChances) {
+    vector<double> next(pmf.size() + 1, 0.0);
+    for (size_t k = 0; k < pmf.size(); ++k) {
+      next[k] += pmf[k] * (1 - q);
+      next[k + 1] += pmf[k] * q;
+    }
+    pmf.swap(next);
+  }
+
+  vector<double> v(ERADICATE2_MAX_SCORE + 1, 0.0);
+  for (int s = ERADICATE2_MAX_SCORE; s >= 0; --s) {
+    v[s] = (s + 1 <= ERADICATE2_MAX_SCORE ? v[s + 1] : 0.0) + (s < static_cast<int>(pmf.size()) ? pmf[s] : 0.0);
+  }
+  return v;
+}
+
+// Longest run of equal characters in 40 random ones, the chance that all runs stay shorter than k for every k
+vector<double> longestRun() {
+  vector<double> v(ERADICATE2_MAX_SCORE + 1, 1.0);
+  for (int k = 2; k <= ERADICATE2_MAX_SCORE; ++k) {
+    // Chance of the current run having length r without any run reaching k so far
+    vector<double> run(k, 0.0);
+    run[1] = 1.0;
+    for (int i = 1; i < 40; ++i) {
+      vector<double> next(k, 0.0);
+      for (int r = 1; r < k; ++r) {
+        next[1] += run[r] * 15 / 16;
+        if (r + 1 < k) {
+          next[r + 1] += run[r] / 16;
+        }
+      }
+      run.swap(next);
+    }
+
+    double shorter = 0;
+    for (auto p : run) {
+      shorter += p;
+    }
+    v[k] = 1 - shorter;
+  }
+  return v;
+}
+}  // namespace
+
+Estimator::Estimator(const mode& m, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const size_t samples, const unsigned int threads) : m_samples(0) {
+  if (!analytic(m)) {
+    sample(m, pattern, weights, samples, max(threads, 1u));
+  }
+
+  // Addresses outside the constraint score 0, sampling it would only waste hashes
+  const double pass = ldexp(1.0, -constraint.bits());
+  for (size_t s = 1; s < m_vLevels.size(); ++s) {
+    m_vLevels[s].p *= pass;
+    m_vLevels[s].pLow *= pass;
+    m_vLevels[s].pHigh *= pass;
+  }
+}
+
+size_t Estimator::samples() const {
+  return m_samples;
+}
+
+const Estimator::Level& Estimator::level(const int score) const {
+  return m_vLevels.at(score);
+}
+
+double Estimator::hashes(const double p, const double confidence) {
+  // Hashes until the first hit are geometrically distributed
+  return p <= 0 ? INFINITY : p >= 1 ? 1 : log1p(-confidence) / log1p(-p);
+}
+
+string Estimator::formatTime(const double seconds) {
+  const pair<double, const char*> units[] = {{31557600, "years"}, {86400, "days"}, {3600, "h"}, {60, "min"}, {1, "s"}};
+  if (!isfinite(seconds)) {
+    return "never";
+  }
+
+  ostringstream oss;
+  for (auto& u : units) {
+    if (seconds >= u.first || u.first == 1) {
+      const double value = seconds / u.first;
+      if (value >= 1e6) {
+        oss << scientific << setprecision(1) << value << " " << u.second;
+      } else {
+        oss << fixed << setprecision(value < 10 ? 1 : 0) << value << " " << u.second;
+      }
+      break;
+    }
+  }
+  return oss.str();
+}
+
+bool Estimator::analytic(const mode& m) {
+  vector<double> v;
+  const int width = m.data2[0] >= m.data1[0] ? m.data2[0] - m.data1[0] + 1 : 0;
+
+  switch (m.function) {
+    case ModeFunction::Benchmark:
+      v = geometric(0.0, 0);
+      break;
+
+    case ModeFunction::ZeroBytes:
+      v = count(vector<double>(20, 1.0 / 256));
+      break;
+
+    case ModeFunction::Matching: {
+      vector<double> vChances;
+      for (int i = 0; i < 20; ++i) {
+        if (m.data1[i] > 0) {
+          vChances.push_back(pow(0.5, __builtin_popcount(m.data1[i])));
+        }
+      }
+      v = count(vChances);
+      break;
+    }
+
+    case ModeFunction::MatchLeading:
+      v = geometric(1.0 / 16, min<int>(m.data2[0], 40));
+      break;
+
+    case ModeFunction::Leading:
+      v = geometric(1.0 / 16, 40);
+      break;
+
+    case ModeFunction::Trailing:
+    case ModeFunction::AllLeading:
+      v = geometric(1.0 / 16, 39);
+      break;
+
+    case ModeFunction::Range:
+      v = count(vector<double>(40, width / 16.0));
+      break;
+
+    case ModeFunction::LeadingRange:
+      v = geometric(width / 16.0, 40);
+      break;
+
+    case ModeFunction::Mirror:
+    case ModeFunction::Doubles:
+      v = geometric(1.0 / 16, 20);
+      break;
+
+    case ModeFunction::All:
+      v = longestRun();
+      break;
+
+    case ModeFunction::AllLeadingTrailing: {
+      // Pairs of characters from both ends until they meet in the middle, past it every character is
+      // already known and the run goes on to 40 if the leading and trailing character are the same
+      const bool bFree = m.data2[0] == 0;
+      const bool bSame = m.data2[0] == 1 || (m.data2[0] == 2 && m.data1[0] == m.data1[1]);
+      v = bFree ? geometric(1.0 / 256, 19) : geometric(1.0 / 256, 20);
+      if (bFree) {
+        v.insert(v.begin(), 1.0);
+        v.pop_back();
+      }
+
+      const double middle = bFree ? v[20] / 16 : bSame ? v[20] : 0.0;
+      for (int s = 21; s <= ERADICATE2_MAX_SCORE; ++s) {
+        v[s] = middle;
+      }
+      break;
+    }
+
+    case ModeFunction::Pattern:
+    case ModeFunction::Weights:
+      return false;
+  }
+
+  for (auto p : v) {
+    m_vLevels.push_back(Level{p, p, p, false});
+  }
+  return true;
+}
+
+void Estimator::sample(const mode& m, const Pattern& pattern, const Weights& weights, const size_t samples, const unsigned int threads) {
+  if (samples == 0) {
+    throw runtime_error("sampling needs at least one hash");
+  }
+
+  // Scores of random addresses, each thread hashes a counter of its own through keccak
+  const unsigned long long seed = (static_cast<unsigned long long>(random_device()()) << 32) | random_device()();
+  vector<vector<size_t>> vCounts(threads, vector<size_t>(ERADICATE2_MAX_SCORE + 1, 0));
+  vector<thread> vThreads;
+  for (unsigned int t = 0; t < threads; ++t) {
+    vThreads.emplace_back([&, t] {
+      cl_uchar in[32] = {0};
+      cl_uchar digest[32];
+      memcpy(in, &seed, 8);
+      memcpy(in + 8, &t, sizeof(t));
+      for (unsigned long long i = t; i < samples; i += threads) {
+        memcpy(in + 16, &i, 8);
+        sha3(in, sizeof(in), digest, 32);
+        ++vCounts[t][Reference::score(m, digest + 12, pattern, weights)];
+      }
+    });
+  }
+
+  for (auto& t : vThreads) {
+    t.join();
+  }
+
+  // Hashes scoring at least s
+  vector<double> vTail(ERADICATE2_MAX_SCORE + 2, 0.0);
+  for (int s = ERADICATE2_MAX_SCORE; s >= 0; --s) {
+    vTail[s] = vTail[s + 1];
+    for (auto& c : vCounts) {
+      vTail[s] += c[s];
+    }
+  }
+
+  // The last level with enough hits, and the chance of going one level further from the one before it
+  int last = 0;
+  while (last < ERADICATE2_MAX_SCORE && vTail[last + 1] >= MinHits) {
+    ++last;
+  }
+
+  const int from = max(last - 1, 0);
+  const double ratio = vTail[from + 1] / vTail[from];
+  double ratioLow, ratioHigh;
+  wilson(vTail[from + 1], vTail[from], ratioLow, ratioHigh);
+
+  const int scoreMax = m.function == ModeFunction::Pattern && !pattern.open() ? pattern.maxScore() : ERADICATE2_MAX_SCORE;
+  const double n = static_cast<double>(samples);
+  for (int s = 0; s <= ERADICATE2_MAX_SCORE; ++s) {
+    Level l = {0.0, 0.0, 0.0, false};
+    if (s <= last) {
+      l.p = vTail[s] / n;
+      wilson(vTail[s], n, l.pLow, l.pHigh);
+    } else if (s <= scoreMax) {
+      const Level& base = m_vLevels[last];
+      l.p = base.p * pow(ratio, s - last);
+      l.pLow = base.pLow * pow(ratioLow, s - last);
+      l.pHigh = base.pHigh * pow(ratioHigh, s - last);
+      l.bExtrapolated = true;
+    }
+    m_vLevels.push_back(l);
+  }
+
+  m_samples = samples;
+}
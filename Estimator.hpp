@@ -0,0 +1,57 @@
+#ifndef HPP_ESTIMATOR
+#define HPP_ESTIMATOR
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Constraint.hpp"
+#include "Pattern.hpp"
+#include "Weights.hpp"
+#include "types.hpp"
+
+using namespace std;
+
+/* How many hashes a mode needs for every score, to plan a search before
+ * running it. Addresses are modelled as uniformly random nibbles, which is what
+ * keccak gives, and most modes have an exact closed form under that model.
+ * Pattern and weights modes don't, their distribution is sampled by hashing
+ * on all cores with sha3.cpp and scoring with Reference. Sampled levels carry
+ * a 95% confidence interval and levels too rare to be sampled are extrapolated
+ * from the last one that was, with the interval widened accordingly. A
+ * constraint scales every score above 0 by its own chance, which is exact as
+ * long as its bits and the scored characters don't overlap.
+ */
+class Estimator {
+ public:
+  struct Level {
+    double p;      // Chance of a hash scoring at least this
+    double pLow;   // 95% confidence interval of p, equal to it when exact
+    double pHigh;
+    bool bExtrapolated;
+  };
+
+ public:
+  Estimator(const mode& m, const Pattern& pattern = Pattern(), const Weights& weights = Weights(), const Constraint& constraint = Constraint(), const size_t samples = 16777216, const unsigned int threads = thread::hardware_concurrency());
+
+  // Hashes sampled, 0 if the estimate is exact
+  size_t samples() const;
+
+  // Scores from 0 to ERADICATE2_MAX_SCORE
+  const Level& level(const int score) const;
+
+  // Hashes after which a score of chance p has been found with the given confidence, e.g. 0.9
+  static double hashes(const double p, const double confidence);
+
+  static string formatTime(const double seconds);
+
+ private:
+  bool analytic(const mode& m);
+  void sample(const mode& m, const Pattern& pattern, const Weights& weights, const size_t samples, const unsigned int threads);
+
+ private:
+  vector<Level> m_vLevels;
+  size_t m_samples;
+};
+
+#endif /* HPP_ESTIMATOR */
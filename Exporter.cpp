@@ -0,0 +1,224 @@
+#include "Exporter.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "SaltTemplate.hpp"
+#include "clutil.hpp"
+
+namespace {
+// Little endian whatever the host
+template <typename T>
+void appendLittleEndian(vector<cl_uchar>& v, const T x) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    v.push_back(static_cast<cl_uchar>(static_cast<unsigned long long>(x) >> (8 * i)));
+  }
+}
+
+void appendString(vector<cl_uchar>& v, const string& s) {
+  appendLittleEndian(v, static_cast<cl_ushort>(s.size()));
+  v.insert(v.end(), s.begin(), s.end());
+}
+}  // namespace
+
+Exporter::Device::Device(cl_context& clContext, cl_program& clProgram, cl_device_id clDeviceId, const size_t worksizeLocal, const size_t size, const size_t index) : m_index(index), m_worksizeLocal(worksizeLocal), m_clQueue(createQueue(clContext, clDeviceId)), m_kernel(clCreateKernel(clProgram, "eradicate2_export", NULL)), m_statRounds(0) {
+  if (m_kernel == NULL) {
+    clReleaseCommandQueue(m_clQueue);
+    throw runtime_error("failed to create kernel \"eradicate2_export\"");
+  }
+
+  // Mapped, so the addresses go straight from the device to pinned host memory
+  m_vBuffers.reserve(2);
+  for (int i = 0; i < 2; ++i) {
+    m_vBuffers.emplace_back(clContext, m_clQueue, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, size * 5, true);
+  }
+}
+
+Exporter::Device::~Device() {
+  clFinish(m_clQueue);
+  clReleaseKernel(m_kernel);
+  clReleaseCommandQueue(m_clQueue);  // The buffers hold on to it until they're released
+}
+
+Exporter::Exporter(cl_context& clContext, const size_t size, const config cfg, const Dispatcher::Callbacks& callbacks, const string& fileName, const string& strSaltTemplate, const string& strGuard)
+    : m_size(size), m_cfg(cfg), m_callbacks(callbacks), m_clContext(clContext), m_fileName(fileName), m_strSaltTemplate(strSaltTemplate), m_strGuard(strGuard), m_pFile(NULL), m_statBytes(0), m_quit(false) {
+  if (m_fileName == "-") {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    m_pFile = stdout;
+  } else {
+    m_pFile = fopen(m_fileName.c_str(), "wb");
+  }
+
+  if (m_pFile == NULL) {
+    throw runtime_error("failed to open " + m_fileName + " for the export");
+  }
+}
+
+Exporter::~Exporter() {
+  for (auto& d : m_vDevices) {
+    delete d;
+  }
+
+  if (m_pFile != stdout) {
+    fclose(m_pFile);
+  }
+}
+
+void Exporter::addDevice(cl_device_id clDeviceId, cl_program& clProgram, const size_t worksizeLocal, const size_t index) {
+  m_vDevices.push_back(new Device(m_clContext, clProgram, clDeviceId, worksizeLocal, m_size, index));
+  m_speed.addDevice(index);
+}
+
+void Exporter::run(const cl_ulong rounds) {
+  vector<cl_uchar> vHeader = {'E', '2', 'A', 'D'};
+  appendLittleEndian(vHeader, cl_uint(1));
+  appendLittleEndian(vHeader, static_cast<cl_uint>(m_size));
+  vHeader.insert(vHeader.end(), m_cfg.initHash.b + 21, m_cfg.initHash.b + 53);
+  appendString(vHeader, m_strSaltTemplate);
+  appendString(vHeader, m_strGuard);
+  write(vHeader.data(), vHeader.size());
+
+  m_quit = false;
+  vector<thread> vThreads;
+  for (auto& d : m_vDevices) {
+    vThreads.emplace_back([this, d, rounds] {
+      try {
+        deviceRun(*d, rounds);
+      } catch (runtime_error& e) {
+        fail("GPU" + lexical_cast::write(d->m_index) + ": " + e.what());
+      }
+    });
+  }
+
+  for (auto& t : vThreads) {
+    t.join();
+  }
+
+  if (fflush(m_pFile) != 0 && m_strError.empty()) {
+    m_strError = "failed to write to " + m_fileName + " - " + strerror(errno);
+  }
+
+  if (!m_strError.empty()) {
+    throw runtime_error(m_strError);
+  }
+}
+
+void Exporter::stop() {
+  m_quit = true;
+}
+
+Speed::Snapshot Exporter::speed() const {
+  return m_speed.snapshot();
+}
+
+string Exporter::metrics() const {
+  ostringstream oss;
+  oss << "# HELP eradicate2_rounds_total Rounds completed." << endl;
+  oss << "# TYPE eradicate2_rounds_total counter" << endl;
+  for (auto& d : m_vDevices) {
+    oss << "eradicate2_rounds_total{device=\"" << d->m_index << "\"} " << d->m_statRounds << endl;
+  }
+
+  oss << "# HELP eradicate2_export_bytes_total Bytes of the address feed written." << endl;
+  oss << "# TYPE eradicate2_export_bytes_total counter" << endl;
+  oss << "eradicate2_export_bytes_total " << m_statBytes << endl;
+  return oss.str();
+}
+
+// The next round is queued before the previous one is written, so the device works while the host waits for
+// the output. Stopping still writes the round in flight.
+void Exporter::deviceRun(Device& d, const cl_ulong rounds) {
+  const cl_uint deviceId = SaltTemplate::deviceId(m_cfg.workerId, d.m_index);
+  const cl_ulong roundLast = rounds == 0 ? m_cfg.roundMax : min(rounds, m_cfg.roundMax);
+  cl_event eventPending = NULL;
+  cl_ulong round = 0;
+
+  while (!m_quit && round < roundLast) {
+    ++round;
+    CLMemory<cl_uint>& mem = d.m_vBuffers[round % 2];
+    mem.write(false);
+    mem.setKernelArg(d.m_kernel, 0);
+    CLMemory<cl_uint>::setKernelArg(d.m_kernel, 1, deviceId);
+    CLMemory<cl_ulong>::setKernelArg(d.m_kernel, 2, round);
+
+    const size_t offset = 0;
+    cl_int res = clEnqueueNDRangeKernel(d.m_clQueue, d.m_kernel, 1, &offset, &m_size, d.m_worksizeLocal == 0 ? NULL : &d.m_worksizeLocal, 0, NULL, NULL);
+    if ((res == CL_INVALID_WORK_GROUP_SIZE || res == CL_INVALID_WORK_ITEM_SIZE) && d.m_worksizeLocal != 0) {
+      d.m_worksizeLocal = 0;
+      res = clEnqueueNDRangeKernel(d.m_clQueue, d.m_kernel, 1, &offset, &m_size, NULL, 0, NULL, NULL);
+    }
+
+    if (res != CL_SUCCESS) {
+      throw runtime_error("kernel queueing failed - " + lexical_cast::write(res));
+    }
+
+    cl_event event;
+    mem.read(false, &event);
+    clFlush(d.m_clQueue);
+
+    if (eventPending != NULL) {
+      writeBlock(d, eventPending, round - 1);
+    }
+    eventPending = event;
+  }
+
+  if (eventPending != NULL) {
+    writeBlock(d, eventPending, round);
+  }
+}
+
+void Exporter::writeBlock(Device& d, cl_event event, const cl_ulong round) {
+  const cl_int res = clWaitForEvents(1, &event);
+  cl_int status = CL_COMPLETE;
+  clGetEventInfo(event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+  clReleaseEvent(event);
+  if (res != CL_SUCCESS || status < 0) {
+    throw runtime_error("round " + lexical_cast::write(round) + " failed - " + lexical_cast::write(res != CL_SUCCESS ? res : status));
+  }
+
+  vector<cl_uchar> vBlock;
+  appendLittleEndian(vBlock, SaltTemplate::deviceId(m_cfg.workerId, d.m_index));
+  appendLittleEndian(vBlock, round);
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+    write(vBlock.data(), vBlock.size());
+    write(d.m_vBuffers[round % 2].data(), m_size * 20);
+  }
+
+  ++d.m_statRounds;
+  if (m_speed.update(m_size, d.m_index) && m_callbacks.onSpeed) {
+    m_callbacks.onSpeed(m_speed.snapshot());
+  }
+}
+
+void Exporter::write(const void* p, const size_t size) {
+  if (fwrite(p, 1, size, m_pFile) != size) {
+    throw runtime_error("failed to write to " + m_fileName + " - " + strerror(errno));
+  }
+
+  m_statBytes += size;
+}
+
+void Exporter::fail(const string& s) {
+  if (m_callbacks.onLog) {
+    m_callbacks.onLog("error: " + s);
+  }
+
+  lock_guard<mutex> lock(m_mutex);
+  if (m_strError.empty()) {
+    m_strError = s;
+  }
+  m_quit = true;
+}
@@ -0,0 +1,94 @@
+#ifndef HPP_EXPORTER
+#define HPP_EXPORTER
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__APPLE__) || defined(__MACOSX)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "CLMemory.hpp"
+#include "Dispatcher.hpp"
+#include "Speed.hpp"
+#include "types.hpp"
+
+using namespace std;
+
+/* Streams every address of every round to a file or pipe instead of scoring
+ * them, for scoring done elsewhere or for datasets. Every device runs
+ * eradicate2_export on a thread of its own into two mapped buffers in turn,
+ * while the kernel fills one the addresses in the other are written out. No
+ * address is dropped: a device whose previous round hasn't been written yet
+ * waits for the output, so the feed runs as fast as the devices, the transfers
+ * and the file or pipe allow and no faster.
+ *
+ * The feed, integers little endian:
+ *
+ *   header  "E2AD", u32 version 1, u32 addresses per block, the 32 byte
+ *           initial salt, u16 length and the salt template (empty for the
+ *           default layout), u16 length and the guard (empty for none)
+ *   blocks  u32 device id, u64 round, then the 20 byte addresses of thread
+ *           ids 0, 1, ... in order
+ *
+ * The salt of an address follows from the initial salt, device id, round and
+ * thread id through the salt layout, see SaltTemplate::salt(). Blocks of
+ * different devices interleave.
+ */
+class Exporter {
+ public:
+  // fileName "-" is stdout. Only the config's initial state, worker id and last round are used.
+  Exporter(cl_context &clContext, const size_t size, const config cfg, const Dispatcher::Callbacks &callbacks, const string &fileName, const string &strSaltTemplate, const string &strGuard);
+  ~Exporter();
+
+  void addDevice(cl_device_id clDeviceId, cl_program &clProgram, const size_t worksizeLocal, const size_t index);
+
+  // Blocks until every device exported rounds rounds (0 is no limit) or stop() is called, throws if the output fails
+  void run(const cl_ulong rounds);
+  void stop();
+
+  Speed::Snapshot speed() const;
+  string metrics() const;
+
+ private:
+  struct Device {
+    Device(cl_context &clContext, cl_program &clProgram, cl_device_id clDeviceId, const size_t worksizeLocal, const size_t size, const size_t index);
+    ~Device();
+
+    const size_t m_index;
+    size_t m_worksizeLocal;
+    cl_command_queue m_clQueue;
+    cl_kernel m_kernel;
+    vector<CLMemory<cl_uint>> m_vBuffers;  // Round r goes to m_vBuffers[r % 2]
+    atomic<unsigned long long> m_statRounds;
+  };
+
+  void deviceRun(Device &d, const cl_ulong rounds);
+  void writeBlock(Device &d, cl_event event, const cl_ulong round);
+  void write(const void *p, const size_t size);
+  void fail(const string &s);
+
+ private:
+  const size_t m_size;  // Addresses per round on every device
+  const config m_cfg;
+  const Dispatcher::Callbacks m_callbacks;
+  cl_context &m_clContext;
+  const string m_fileName;
+  const string m_strSaltTemplate;
+  const string m_strGuard;
+  FILE *m_pFile;
+  vector<Device *> m_vDevices;
+  Speed m_speed;
+
+  mutex m_mutex;  // Output and error, blocks are written whole
+  string m_strError;
+  atomic<unsigned long long> m_statBytes;
+  atomic<bool> m_quit;
+};
+
+#endif /* HPP_EXPORTER */
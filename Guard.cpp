@@ -0,0 +1,146 @@
+#include "Guard.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+
+#include "hexadecimal.hpp"
+#include "sha3.hpp"
+
+Guard::Guard() {
+}
+
+Guard Guard::parse(const string& strGuard) {
+  vector<string> vParts;
+  istringstream iss(strGuard);
+  for (string part; getline(iss, part, ':');) {
+    vParts.push_back(part);
+  }
+
+  if (strGuard.empty() || strGuard.back() == ':' || vParts.size() > 3 || vParts[0] != "createx") {
+    throw runtime_error("guard must be createx, createx:<sender>, createx:<sender>:<chain id> or createx::<chain id>");
+  }
+
+  const string strSender = vParts.size() > 1 ? parseHexadecimalBytes(vParts[1]) : "";
+  const string strChainId = vParts.size() > 2 ? vParts[2] : "";
+  if (vParts.size() > 1 && !vParts[1].empty() && strSender.size() != 20) {
+    throw runtime_error("guard sender must be a 20 byte address");
+  }
+
+  if (vParts.size() > 2 && (strChainId.size() > 19 || !all_of(strChainId.begin(), strChainId.end(), ::isdigit))) {
+    throw runtime_error("guard chain id must be a decimal number below 10^19");
+  }
+
+  const bool bSender = any_of(strSender.begin(), strSender.end(), [](const char c) { return c != 0; });
+  if (vParts.size() == 2 && !bSender) {
+    throw runtime_error("guard sender must not be the zero address, CreateX doesn't guard such salts without a chain id");
+  }
+
+  Guard g;
+  g.m_str = "createx";
+  if (vParts.size() == 1) {
+    return g;
+  }
+
+  g.m_saltPrefix.assign(21, 0);
+  if (bSender) {
+    g.m_prefix.assign(12, 0);
+    g.m_prefix.insert(g.m_prefix.end(), strSender.begin(), strSender.end());
+    copy(strSender.begin(), strSender.end(), g.m_saltPrefix.begin());
+    g.m_str += ":0x" + toHex(g.m_saltPrefix.data(), 20);
+  } else {
+    g.m_str += ":";
+  }
+
+  if (!strChainId.empty()) {
+    const unsigned long long chainId = stoull(strChainId);
+    g.m_prefix.resize(g.m_prefix.size() + 32, 0);
+    for (int i = 0; i < 8; ++i) {
+      g.m_prefix[g.m_prefix.size() - 1 - i] = static_cast<cl_uchar>(chainId >> (8 * i));
+    }
+
+    g.m_saltPrefix[20] = 0x01;
+    g.m_str += ":" + to_string(chainId);
+  }
+
+  return g;
+}
+
+bool Guard::enabled() const {
+  return !m_str.empty();
+}
+
+string Guard::str() const {
+  return m_str;
+}
+
+SaltTemplate Guard::saltTemplate(const SaltTemplate& saltTemplate) const {
+  if (m_saltPrefix.empty()) {
+    // 20 zero bytes and 0x01 would make CreateX hash the chain id too
+    if (saltTemplate.str().compare(0, 44, "0x" + string(40, '0') + "01") == 0) {
+      throw runtime_error("salt template selects CreateX's chain id guard, use createx::<chain id>");
+    }
+
+    return saltTemplate;
+  }
+
+  // Free bytes of the template are fixed to the profile's, fixed ones have to agree with it
+  string s = saltTemplate.str();
+  for (size_t i = 0; i < m_saltPrefix.size(); ++i) {
+    const string required = toHex(&m_saltPrefix[i], 1);
+    const string given = s.substr(2 + 2 * i, 2);
+    if (given != "??" && given != required) {
+      throw runtime_error("salt template conflicts with guard " + m_str + ", its salts start with 0x" + toHex(m_saltPrefix.data(), m_saltPrefix.size()));
+    }
+
+    s.replace(2 + 2 * i, 2, required);
+  }
+
+  return SaltTemplate::parse(s);
+}
+
+void Guard::apply(const cl_uchar salt[32], cl_uchar guarded[32]) const {
+  vector<cl_uchar> vPreimage(m_prefix);
+  vPreimage.insert(vPreimage.end(), salt, salt + 32);
+  sha3(vPreimage.data(), vPreimage.size(), guarded, 32);
+}
+
+string Guard::source() const {
+  if (!enabled()) {
+    return "";
+  }
+
+  // Preimage of the prefix, the salt and the first padding byte, one block since it's 96 bytes at most.
+  // sha3_keccakf adds the last padding byte itself.
+  cl_ulong init[17] = {0};
+  for (size_t i = 0; i < m_prefix.size(); ++i) {
+    init[i / 8] |= static_cast<cl_ulong>(m_prefix[i]) << (8 * (i % 8));
+  }
+  init[(m_prefix.size() + 32) / 8] |= 0x01;
+
+  ostringstream oss;
+  oss << "#define ERADICATE2_GUARD" << endl;
+  oss << "void eradicate2_guard(ethhash * const h) {" << endl;
+  oss << "\t// " << m_str << ", the salt h->b[21:52] is replaced by keccak256 of " << m_prefix.size() << " prefix bytes and the salt" << endl;
+  oss << "\tethhash g = { .q = { ";
+  for (int i = 0; i < 17; ++i) {
+    oss << (i == 0 ? "" : ", ") << hex64(init[i]);
+  }
+  oss << " } };" << endl;
+
+  const size_t lane = m_prefix.size() / 8;
+  for (int i = 0; i < 4; ++i) {
+    oss << "\tg.q[" << lane + i << "] = (h->q[" << 2 + i << "] >> 40) | (h->q[" << 3 + i << "] << 24);" << endl;
+  }
+  oss << "\tsha3_keccakf(&g);" << endl;
+
+  oss << "\th->q[2] = (h->q[2] & 0x000000ffffffffffUL) | (g.q[0] << 40);" << endl;
+  for (int i = 0; i < 3; ++i) {
+    oss << "\th->q[" << 3 + i << "] = (g.q[" << i << "] >> 24) | (g.q[" << i + 1 << "] << 40);" << endl;
+  }
+  oss << "\th->q[6] = (h->q[6] & 0xffffff0000000000UL) | (g.q[3] >> 24);" << endl;
+  oss << "}" << endl;
+
+  return oss.str();
+}
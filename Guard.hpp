@@ -0,0 +1,50 @@
+#ifndef HPP_GUARD
+#define HPP_GUARD
+
+#include <string>
+#include <vector>
+
+#include "SaltTemplate.hpp"
+#include "types.hpp"
+
+using namespace std;
+
+/* Factories like CreateX don't deploy with the salt they're called with but
+ * with a guarded salt hashed from it, so that nobody else can take an address
+ * meant for a given caller or chain. Profiles, sender and chain id padded to
+ * 32 bytes each the way abi.encode does:
+ *
+ *   createx                       keccak256(salt)
+ *   createx:<sender>              keccak256(sender ++ salt), the salt starts with sender and 0x00
+ *   createx:<sender>:<chain id>   keccak256(sender ++ chain id ++ salt), the salt starts with sender and 0x01
+ *   createx::<chain id>           keccak256(chain id ++ salt), the salt starts with 20 zero bytes and 0x01
+ *
+ * Results carry the salt to call the factory with, the guarded one only exists
+ * on the device. source() generates eradicate2_guard, which eradicate2_create3
+ * runs ahead of its two hashes, so all three Keccak-f are fused in one kernel.
+ */
+class Guard {
+ public:
+  Guard();
+
+  static Guard parse(const string& strGuard);
+
+  bool enabled() const;
+  string str() const;
+
+  // Template with the bytes the factory checks to pick this profile fixed on top of the given one
+  SaltTemplate saltTemplate(const SaltTemplate& saltTemplate) const;
+
+  // Salt the factory deploys with when called with salt
+  void apply(const cl_uchar salt[32], cl_uchar guarded[32]) const;
+
+  // OpenCL source defining eradicate2_guard, empty when disabled
+  string source() const;
+
+ private:
+  string m_str;
+  vector<cl_uchar> m_prefix;      // Hashed ahead of the salt, 0, 32 or 64 bytes
+  vector<cl_uchar> m_saltPrefix;  // Required first bytes of the salt, none or 21
+};
+
+#endif /* HPP_GUARD */
@@ -0,0 +1,89 @@
+#include "MetricsServer.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include "lexical_cast.hpp"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+MetricsServer::MetricsServer(const unsigned short port, std::function<std::string()> render) : m_render(render), m_fd(-1), m_quit(false) {
+  m_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (m_fd < 0) {
+    throw std::runtime_error("failed to create metrics socket");
+  }
+
+  const int yes = 1;
+  setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  if (bind(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_fd, 8) != 0) {
+    close(m_fd);
+    throw std::runtime_error("failed to listen for metrics on port " + lexical_cast::write(port));
+  }
+
+  m_thread = std::thread(&MetricsServer::loop, this);
+}
+
+MetricsServer::~MetricsServer() {
+  m_quit = true;
+  shutdown(m_fd, SHUT_RDWR);
+  close(m_fd);
+  m_thread.join();
+}
+
+void MetricsServer::loop() {
+  while (!m_quit) {
+    const int fd = accept(m_fd, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+
+    serve(fd);
+    close(fd);
+  }
+}
+
+void MetricsServer::serve(const int fd) {
+  // Only the request line matters, headers and body are ignored
+  char request[1024];
+  const ssize_t len = recv(fd, request, sizeof(request) - 1, 0);
+  if (len <= 0) {
+    return;
+  }
+  request[len] = '\0';
+
+  std::string status = "200 OK";
+  std::string body;
+  if (std::strncmp(request, "GET /metrics", 12) == 0) {
+    body = m_render();
+  } else {
+    status = "404 Not Found";
+  }
+
+  const std::string response = "HTTP/1.0 " + status + "\r\n" +
+                               "Content-Type: text/plain; version=0.0.4\r\n" +
+                               "Content-Length: " + lexical_cast::write(body.size()) + "\r\n" +
+                               "Connection: close\r\n\r\n" + body;
+
+  size_t sent = 0;
+  while (sent < response.size()) {
+    const ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      break;
+    }
+    sent += n;
+  }
+}
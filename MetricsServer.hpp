@@ -0,0 +1,29 @@
+#ifndef HPP_METRICSSERVER
+#define HPP_METRICSSERVER
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+/* Minimal HTTP server answering "GET /metrics" on the loopback interface with
+ * whatever the render function returns, in Prometheus text exposition format.
+ * Requests are served one at a time from a single background thread.
+ */
+class MetricsServer {
+ public:
+  MetricsServer(const unsigned short port, std::function<std::string()> render);
+  ~MetricsServer();
+
+ private:
+  void loop();
+  void serve(const int fd);
+
+ private:
+  std::function<std::string()> m_render;
+  int m_fd;
+  std::atomic<bool> m_quit;
+  std::thread m_thread;
+};
+
+#endif /* HPP_METRICSSERVER */
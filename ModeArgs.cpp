@@ -0,0 +1,100 @@
+#include "ModeArgs.hpp"
+
+#include <algorithm>
+
+#include "ModeFactory.hpp"
+
+ModeArgs::ModeArgs()
+    : bModeBenchmark(false), bModeZeroBytes(false), bModeZeros(false), bModeLetters(false), bModeNumbers(false), bModeLeadingRange(false), bModeRange(false), bModeMirror(false), bModeDoubles(false), allLeading(false), allLeadingTrailing(false), scoreAll(0), rangeMin(0), rangeMax(0) {
+}
+
+void ModeArgs::add(ArgParser& argp) {
+  argp.addSwitch("b", "benchmark", bModeBenchmark);
+  argp.addSwitch("z", "zero-bytes", bModeZeroBytes);
+  argp.addSwitch("Z", "zeros", bModeZeros);
+  argp.addSwitch("L", "letters", bModeLetters);
+  argp.addSwitch("n", "numbers", bModeNumbers);
+  argp.addSwitch("l", "leading", strModeLeading);
+  argp.addSwitch("x", "matching", strModeMatching);
+  argp.addSwitch("lr", "leading-range", bModeLeadingRange);
+  argp.addSwitch("r", "range", bModeRange);
+  argp.addSwitch("mr", "mirror", bModeMirror);
+  argp.addSwitch("ld", "leading-doubles", bModeDoubles);
+  argp.addSwitch("lx", "leading-match", strModeLeadingMatch);
+  argp.addSwitch("lt", "leading-trailing", leadingTrailing);
+  argp.addSwitch("t", "trailing", strModeTrailing);
+  argp.addSwitch("a", "all", scoreAll);
+  argp.addSwitch("al", "all-leading", allLeading);
+  argp.addSwitch("alt", "all-leading-trailing", allLeadingTrailing);
+  argp.addSwitch("m", "min", rangeMin);
+  argp.addSwitch("M", "max", rangeMax);
+  argp.addSwitch("p", "pattern", strPattern);
+  argp.addSwitch("wm", "weights", strWeights);
+  argp.addSwitch("wf", "weights-file", strWeightsFile);
+  argp.addSwitch("ct", "constraint", strConstraint);
+}
+
+bool ModeArgs::select(mode& m, unsigned int& scoreMin) const {
+  if (bModeBenchmark) {
+    m = ModeFactory::benchmark();
+  } else if (bModeZeroBytes) {
+    m = ModeFactory::zerobytes();
+  } else if (bModeZeros) {
+    m = ModeFactory::zeros();
+  } else if (bModeLetters) {
+    m = ModeFactory::letters();
+  } else if (bModeNumbers) {
+    m = ModeFactory::numbers();
+  } else if (!strModeLeading.empty()) {
+    if (scoreMin == 0) scoreMin = 2;
+    m = ModeFactory::leading(strModeLeading.front());
+  } else if (!strModeTrailing.empty()) {
+    m = ModeFactory::trailing(strModeTrailing.back());
+  } else if (!strModeLeadingMatch.empty()) {
+    if (scoreMin == 0) scoreMin = 2;
+    m = ModeFactory::matchLeading(strModeLeadingMatch);
+  } else if (!strModeMatching.empty()) {
+    m = ModeFactory::matching(strModeMatching);
+  } else if (bModeLeadingRange) {
+    m = ModeFactory::leadingRange(rangeMin, rangeMax);
+  } else if (bModeRange) {
+    m = ModeFactory::range(rangeMin, rangeMax);
+  } else if (bModeMirror) {
+    m = ModeFactory::mirror();
+  } else if (bModeDoubles) {
+    m = ModeFactory::doubles();
+  } else if (scoreAll > 0) {
+    m = ModeFactory::all(scoreAll);
+  } else if (allLeading) {
+    m = ModeFactory::allLeading();
+  } else if (!leadingTrailing.empty() || allLeadingTrailing) {
+    m = ModeFactory::allLeadingTrailing(leadingTrailing);
+  } else if (!strPattern.empty()) {
+    // Short patterns only report complete matches by default
+    if (scoreMin == 0) scoreMin = min(6, max(pattern().maxScore() - 1, 1));
+    m = ModeFactory::pattern();
+  } else if (!strWeights.empty() || !strWeightsFile.empty()) {
+    m = ModeFactory::weights();
+  } else {
+    return false;
+  }
+
+  if (scoreMin == 0) scoreMin = 6;
+  return true;
+}
+
+Pattern ModeArgs::pattern() const {
+  return strPattern.empty() ? Pattern() : Pattern::parse(strPattern);
+}
+
+Weights ModeArgs::weights() const {
+  if (!strWeights.empty() && !strWeightsFile.empty()) {
+    throw runtime_error("weights can be given by --weights or --weights-file, not both");
+  }
+
+  return !strWeightsFile.empty() ? Weights::read(strWeightsFile) : !strWeights.empty() ? Weights::parse(strWeights) : Weights();
+}
+
+Constraint ModeArgs::constraint() const {
+  return strConstraint.empty() ? Constraint() : Constraint::parse(strConstraint);
+}
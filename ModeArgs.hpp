@@ -0,0 +1,62 @@
+#ifndef HPP_MODEARGS
+#define HPP_MODEARGS
+
+#include <string>
+
+#include "ArgParser.hpp"
+#include "Constraint.hpp"
+#include "Pattern.hpp"
+#include "Weights.hpp"
+#include "types.hpp"
+
+using namespace std;
+
+/* The mode switches (-z, -l, -x, -al, ...) shared by every tool that scores
+ * addresses. Register them with add() before ArgParser::parse() and turn them
+ * into a mode with select() after.
+ */
+class ModeArgs {
+ public:
+  ModeArgs();
+
+  void add(ArgParser& argp);
+
+  // False if no mode switch was given. A scoreMin of 0 is replaced by the mode's default.
+  bool select(mode& m, unsigned int& scoreMin) const;
+
+  // Parsed --pattern, disabled if it wasn't given
+  Pattern pattern() const;
+
+  // Parsed --weights or read --weights-file, disabled if neither was given
+  Weights weights() const;
+
+  // Parsed --constraint, disabled if it wasn't given
+  Constraint constraint() const;
+
+ private:
+  bool bModeBenchmark;
+  bool bModeZeroBytes;
+  bool bModeZeros;
+  bool bModeLetters;
+  bool bModeNumbers;
+  string strModeLeading;
+  string strModeMatching;
+  string strModeLeadingMatch;
+  string strModeTrailing;
+  bool bModeLeadingRange;
+  bool bModeRange;
+  bool bModeMirror;
+  bool bModeDoubles;
+  bool allLeading;
+  bool allLeadingTrailing;
+  string leadingTrailing;
+  string strPattern;
+  string strWeights;
+  string strWeightsFile;
+  string strConstraint;
+  int scoreAll;
+  int rangeMin;
+  int rangeMax;
+};
+
+#endif /* HPP_MODEARGS */
@@ -49,6 +49,20 @@ mode ModeFactory::allLeadingTrailing(const string strHex) {
   return r;
 }
 
+// The pattern itself is compiled into the kernel by Pattern::source()
+mode ModeFactory::pattern() {
+  mode r;
+  r.function = ModeFunction::Pattern;
+  return r;
+}
+
+// The table itself is compiled into the kernel by Weights::source()
+mode ModeFactory::weights() {
+  mode r;
+  r.function = ModeFunction::Weights;
+  return r;
+}
+
 mode ModeFactory::matchLeading(const string strHex) {
   mode r;
   r.function = ModeFunction::MatchLeading;
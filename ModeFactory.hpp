@@ -22,6 +22,8 @@ class ModeFactory {
   static mode allLeading();
   static mode matchLeading(const string strHex);
   static mode allLeadingTrailing(const string strHex);
+  static mode pattern();
+  static mode weights();
 
   static mode benchmark();
   static mode zerobytes();
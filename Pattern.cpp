@@ -0,0 +1,368 @@
+#include "Pattern.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "hexadecimal.hpp"
+
+namespace {
+struct Item {
+  cl_ushort members;
+  size_t count;
+  bool open;
+};
+
+cl_uchar nibble(const cl_uchar hash[20], const int i) {
+  return (i & 1) ? (hash[i >> 1] & 0x0f) : (hash[i >> 1] >> 4);
+}
+
+// Lane and shift of character i in the lanes built by eradicate2_lane
+void position(const int i, int& lane, int& shift) {
+  lane = i < 8 ? 0 : (i + 8) >> 4;
+  shift = 60 - 4 * (i < 8 ? i : (i + 8) & 15);
+}
+}  // namespace
+
+Pattern::Pattern() : m_runPrefix(None), m_runSuffix(None) {
+}
+
+Pattern Pattern::parse(const string& strPattern) {
+  string s = strPattern;
+  const bool bStart = !s.empty() && s.front() == '^';
+  const bool bEnd = !s.empty() && s.back() == '$';
+  s = s.substr(bStart ? 1 : 0, s.size() - (bStart ? 1 : 0) - (bEnd ? 1 : 0));
+  if (s.size() >= 2 && s.substr(0, 2) == "0x") {
+    s.erase(0, 2);
+  }
+
+  vector<Item> vLeft;
+  vector<Item> vRight;
+  bool bGap = false;
+  for (size_t i = 0; i < s.size();) {
+    if (s.compare(i, 2, ".*") == 0) {
+      if (bGap) {
+        throw runtime_error("pattern can only have one .*");
+      }
+
+      bGap = true;
+      i += 2;
+      continue;
+    }
+
+    Item item = {parseClass(s, i), 1, false};
+    if (i < s.size() && (s[i] == '+' || s[i] == '*')) {
+      item.count = s[i] == '+' ? 1 : 0;
+      item.open = true;
+      ++i;
+    } else if (i < s.size() && s[i] == '{') {
+      const size_t end = s.find('}', i);
+      if (end == string::npos) {
+        throw runtime_error("unterminated {} in pattern");
+      }
+
+      const string strCount = s.substr(i + 1, end - i - 1);
+      item.open = !strCount.empty() && strCount.back() == ',';
+      try {
+        item.count = stoul(strCount);
+      } catch (exception&) {
+        throw runtime_error("bad repeat count {" + strCount + "} in pattern");
+      }
+      i = end + 1;
+    }
+
+    if (item.open && item.members == Any) {
+      throw runtime_error("open runs of . aren't supported, use .* between prefix and suffix");
+    }
+
+    (bGap ? vRight : vLeft).push_back(item);
+  }
+
+  // Without .* a pattern is a prefix, unless it's only anchored at the end
+  if (!bGap && bEnd && !bStart) {
+    swap(vLeft, vRight);
+  }
+
+  Pattern p;
+  p.m_str = strPattern;
+  for (size_t i = 0; i < vLeft.size(); ++i) {
+    if (vLeft[i].open && i + 1 != vLeft.size()) {
+      throw runtime_error("an open run can only end the prefix");
+    }
+
+    p.m_prefix.insert(p.m_prefix.end(), vLeft[i].count, vLeft[i].members);
+    p.m_runPrefix = vLeft[i].open ? vLeft[i].members : None;
+  }
+
+  for (size_t i = 0; i < vRight.size(); ++i) {
+    if (vRight[i].open && i != 0) {
+      throw runtime_error("an open run can only start the suffix");
+    }
+
+    p.m_suffix.insert(p.m_suffix.end(), vRight[i].count, vRight[i].members);
+    p.m_runSuffix = vRight[0].open ? vRight[0].members : None;
+  }
+
+  if (p.m_prefix.size() + p.m_suffix.size() > 40) {
+    throw runtime_error("pattern is longer than an address");
+  }
+
+  if (bStart && bEnd && !bGap && (p.m_prefix.size() != 40 || p.m_runPrefix != None)) {
+    throw runtime_error("pattern anchored at both ends without .* must be exactly 40 characters");
+  }
+
+  if (p.maxScore() == 0 && p.m_runPrefix == None && p.m_runSuffix == None) {
+    throw runtime_error("pattern doesn't constrain any character");
+  }
+
+  return p;
+}
+
+Pattern::Class Pattern::parseClass(const string& s, size_t& i) {
+  if (s[i] == '.') {
+    ++i;
+    return Any;
+  }
+
+  if (s[i] != '[') {
+    const auto value = hexValueNoException(s[i]);
+    if (value == string::npos) {
+      throw runtime_error(string("unexpected '") + s[i] + "' in pattern");
+    }
+
+    ++i;
+    return static_cast<Class>(1 << value);
+  }
+
+  const size_t end = s.find(']', i);
+  if (end == string::npos) {
+    throw runtime_error("unterminated [] in pattern");
+  }
+
+  const bool bNegate = i + 1 < end && s[i + 1] == '^';
+  Class c = None;
+  for (size_t j = i + (bNegate ? 2 : 1); j < end; ++j) {
+    const auto lo = hexValueNoException(s[j]);
+    auto hi = lo;
+    if (j + 2 < end && s[j + 1] == '-') {
+      hi = hexValueNoException(s[j + 2]);
+      j += 2;
+    }
+
+    if (lo == string::npos || hi == string::npos || lo > hi) {
+      throw runtime_error("bad class " + s.substr(i, end - i + 1) + " in pattern");
+    }
+
+    for (auto k = lo; k <= hi; ++k) {
+      c |= 1 << k;
+    }
+  }
+
+  c = bNegate ? static_cast<Class>(~c) : c;
+  if (c == None) {
+    throw runtime_error("class " + s.substr(i, end - i + 1) + " in pattern matches nothing");
+  }
+
+  i = end + 1;
+  return c;
+}
+
+bool Pattern::enabled() const {
+  return !m_str.empty();
+}
+
+string Pattern::str() const {
+  return m_str;
+}
+
+int Pattern::maxScore() const {
+  return static_cast<int>(count_if(m_prefix.begin(), m_prefix.end(), [](const Class c) { return c != Any; }) + count_if(m_suffix.begin(), m_suffix.end(), [](const Class c) { return c != Any; }));
+}
+
+bool Pattern::open() const {
+  return m_runPrefix != None || m_runSuffix != None;
+}
+
+int Pattern::score(const cl_uchar hash[20]) const {
+  const auto member = [&](const Class c, const int i) { return (c >> nibble(hash, i)) & 1; };
+  const int lp = static_cast<int>(m_prefix.size());
+  const int ls = static_cast<int>(m_suffix.size());
+  int score = 0;
+
+  int f = 0;
+  for (; f < lp && member(m_prefix[f], f); ++f) {
+    score += m_prefix[f] != Any;
+  }
+
+  int runPrefix = 0;
+  if (m_runPrefix != None && f == lp) {
+    for (int i = lp; i < 40 - ls && member(m_runPrefix, i); ++i) {
+      ++runPrefix;
+    }
+  }
+
+  int t = 0;
+  for (; t < ls && member(m_suffix[ls - 1 - t], 39 - t); ++t) {
+    score += m_suffix[ls - 1 - t] != Any;
+  }
+
+  int runSuffix = 0;
+  if (m_runSuffix != None && t == ls) {
+    for (int i = 39 - ls; i >= lp + runPrefix && member(m_runSuffix, i); --i) {
+      ++runSuffix;
+    }
+  }
+
+  return score + runPrefix + runSuffix;
+}
+
+// Expression for a whole lane with a non-zero nibble wherever the character isn't in the class
+string Pattern::mismatchSource(const Class c, const string& lane) {
+  for (int k = 0; k < 16; ++k) {
+    if (c == (1 << k)) {
+      return "(" + lane + " ^ " + hex64(k * 0x1111111111111111ULL) + ")";
+    }
+  }
+
+  // One range comparison per run of consecutive characters in the class
+  string r;
+  for (int lo = 0; lo < 16; ++lo) {
+    if ((c >> lo) & 1) {
+      int hi = lo;
+      while (hi < 15 && ((c >> (hi + 1)) & 1)) {
+        ++hi;
+      }
+
+      r += (r.empty() ? "" : " | ") + string("eradicate2_range_nibbles(") + lane + ", " + to_string(lo) + ", " + to_string(hi) + ")";
+      lo = hi;
+    }
+  }
+
+  return "(~(" + r + ") & 0x8888888888888888UL)";
+}
+
+// Mismatch lanes for fixed characters starting at offset, as the three arguments to eradicate2_leading_zeros
+string Pattern::fixedSource(const vector<Class>& vClasses, const int offset) const {
+  cl_ulong value[3] = {0, 0, 0};
+  cl_ulong mask[3] = {0, 0, 0};
+  vector<string> vTerms[3];
+
+  for (size_t i = 0; i < vClasses.size(); ++i) {
+    const Class c = vClasses[i];
+    int lane, shift;
+    position(offset + static_cast<int>(i), lane, shift);
+    if (c == Any) {
+      continue;
+    }
+
+    // Single characters are compared a lane at a time, classes look up the character in their complement
+    bool bSingle = false;
+    for (int k = 0; k < 16; ++k) {
+      if (c == (1 << k)) {
+        value[lane] |= static_cast<cl_ulong>(k) << shift;
+        mask[lane] |= 0xFULL << shift;
+        bSingle = true;
+      }
+    }
+
+    if (!bSingle) {
+      ostringstream oss;
+      oss << "(((0x" << hex << static_cast<Class>(~c) << dec << "UL >> ((a" << lane << " >> " << shift << ") & 0xF)) & 1) << " << shift << ")";
+      vTerms[lane].push_back(oss.str());
+    }
+  }
+
+  string r;
+  for (int lane = 0; lane < 3; ++lane) {
+    string s;
+    if (mask[lane] != 0) {
+      s = "((a" + to_string(lane) + " ^ " + hex64(value[lane]) + ") & " + hex64(mask[lane]) + ")";
+    }
+
+    for (auto& term : vTerms[lane]) {
+      s += (s.empty() ? "" : " | ") + term;
+    }
+
+    r += (lane == 0 ? "" : ", ") + (s.empty() ? string("0") : s);
+  }
+
+  return r;
+}
+
+string Pattern::source() const {
+  if (!enabled()) {
+    return "";
+  }
+
+  const int lp = static_cast<int>(m_prefix.size());
+  const int ls = static_cast<int>(m_suffix.size());
+  const int gap = 40 - lp - ls;
+
+  // Bit 39 - i set for every character i that counts towards the score
+  cl_ulong carePrefix = 0;
+  for (int i = 0; i < lp; ++i) {
+    carePrefix |= static_cast<cl_ulong>(m_prefix[i] != Any) << (39 - i);
+  }
+
+  cl_ulong careSuffix = 0;
+  for (int i = 0; i < ls; ++i) {
+    careSuffix |= static_cast<cl_ulong>(m_suffix[i] != Any) << (39 - (40 - ls + i));
+  }
+
+  // Nibbles of each lane from character begin up to end, to limit open runs to the gap
+  const auto range = [](const int begin, const int end) {
+    string r;
+    for (int lane = 0; lane < 3; ++lane) {
+      cl_ulong m = 0;
+      for (int i = begin; i < end; ++i) {
+        int l, shift;
+        position(i, l, shift);
+        m |= l == lane ? 0xFULL << shift : 0;
+      }
+      r += (lane == 0 ? "" : ", ") + string("m") + to_string(lane) + " & " + hex64(m);
+    }
+    return r;
+  };
+
+  ostringstream oss;
+  oss << "#define ERADICATE2_PATTERN" << endl;
+  oss << "uint eradicate2_leading_zeros(const ulong x0, const ulong x1, const ulong x2);" << endl;
+  oss << "uint eradicate2_trailing_zeros(const ulong x0, const ulong x1, const ulong x2);" << endl;
+  oss << "ulong eradicate2_range_nibbles(const ulong x, const ulong lo, const ulong hi);" << endl;
+  oss << endl;
+  oss << "// " << m_str << endl;
+  oss << "int eradicate2_score_pattern(const ulong a0, const ulong a1, const ulong a2) {" << endl;
+  oss << "\tint score = 0;" << endl;
+  oss << "\tuint runPrefix = 0;" << endl;
+
+  if (lp > 0 || m_runPrefix != None) {
+    oss << "\tconst uint f = min(eradicate2_leading_zeros(" << fixedSource(m_prefix, 0) << "), " << lp << "U);" << endl;
+    oss << "\tscore += popcount(" << hex64(carePrefix) << " >> (40 - f));" << endl;
+    if (m_runPrefix != None) {
+      oss << "\tif (f == " << lp << ") {" << endl;
+      oss << "\t\tconst ulong m0 = " << mismatchSource(m_runPrefix, "a0") << ";" << endl;
+      oss << "\t\tconst ulong m1 = " << mismatchSource(m_runPrefix, "a1") << ";" << endl;
+      oss << "\t\tconst ulong m2 = " << mismatchSource(m_runPrefix, "a2") << ";" << endl;
+      oss << "\t\trunPrefix = min(eradicate2_leading_zeros(" << range(lp, 40) << "), " << 40 - ls << "U) - " << lp << ";" << endl;
+      oss << "\t}" << endl;
+    }
+  }
+
+  if (ls > 0 || m_runSuffix != None) {
+    oss << "\tconst uint t = min(eradicate2_trailing_zeros(" << fixedSource(m_suffix, 40 - ls) << "), " << ls << "U);" << endl;
+    oss << "\tscore += popcount(" << hex64(careSuffix) << " & ((1UL << t) - 1));" << endl;
+    if (m_runSuffix != None) {
+      oss << "\tif (t == " << ls << ") {" << endl;
+      oss << "\t\tconst ulong m0 = " << mismatchSource(m_runSuffix, "a0") << ";" << endl;
+      oss << "\t\tconst ulong m1 = " << mismatchSource(m_runSuffix, "a1") << ";" << endl;
+      oss << "\t\tconst ulong m2 = " << mismatchSource(m_runSuffix, "a2") << ";" << endl;
+      oss << "\t\tscore += min(eradicate2_trailing_zeros(" << range(0, 40 - ls) << ") - " << ls << ", " << gap << " - runPrefix);" << endl;
+      oss << "\t}" << endl;
+    }
+  }
+
+  oss << "\treturn score + runPrefix;" << endl;
+  oss << "}" << endl;
+
+  return oss.str();
+}
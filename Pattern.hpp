@@ -0,0 +1,79 @@
+#ifndef HPP_PATTERN
+#define HPP_PATTERN
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+using namespace std;
+
+/* Vanity shapes written as a small pattern language instead of a new
+ * ModeFunction and a hand-written eradicate2_score_* for each of them.
+ *
+ *   ^dead[0-9]{4}.*beef$   dead and four digits first, beef last
+ *   ^c0ffee0+              c0ffee followed by as many zeros as possible
+ *   ^.{4}[a-f]{4}          four letters after any four characters
+ *   0{3,}beef$             beef last, after at least three zeros
+ *
+ * A pattern is a prefix matched from the first character and a suffix matched
+ * backwards from the last one, separated by .* Without .* it's a prefix, or a
+ * suffix if it ends in $ and doesn't start with ^. An item is a hex character,
+ * . for any character or a class such as [0-9], [a-f], [048c] or [^0], and may
+ * be repeated with {n}. The last item of the prefix and the first of the suffix
+ * may instead be an open run, written + or * or {n,} for at least n.
+ *
+ * The score is the number of characters other than . that match before the
+ * first mismatch, counted from the start for the prefix and from the end for
+ * the suffix, plus the length of an open run once everything before it
+ * matched. A pattern matches fully when the score reaches maxScore() without
+ * open runs.
+ *
+ * source() compiles the pattern to straight-line OpenCL on the 64-bit nibble
+ * lanes the built-in scorers use, score() is the host's equivalent.
+ */
+class Pattern {
+ public:
+  Pattern();
+
+  static Pattern parse(const string& strPattern);
+
+  bool enabled() const;
+  string str() const;
+
+  // Highest score the fixed characters can reach, open runs can add to it
+  int maxScore() const;
+
+  // Whether there's an open run, without one no hash scores above maxScore()
+  bool open() const;
+
+  int score(const cl_uchar hash[20]) const;
+
+  // OpenCL source defining eradicate2_score_pattern, empty when disabled
+  string source() const;
+
+ public:
+  // Set of characters allowed at a position, bit n for character n. Weights uses them too.
+  typedef cl_ushort Class;
+
+  static const Class Any = 0xffff;
+  static const Class None = 0;
+
+  // A hex character, . or [...] starting at s[i], i is moved past it
+  static Class parseClass(const string& s, size_t& i);
+
+  // Expression for a whole lane with a non-zero nibble wherever the character isn't in the class
+  static string mismatchSource(const Class c, const string& lane);
+
+ private:
+  string fixedSource(const vector<Class>& vClasses, const int offset) const;
+
+ private:
+  string m_str;
+  vector<Class> m_prefix;
+  vector<Class> m_suffix;
+  Class m_runPrefix;  // Open run after the prefix, None if there isn't one
+  Class m_runSuffix;  // Open run before the suffix, None if there isn't one
+};
+
+#endif /* HPP_PATTERN */
@@ -0,0 +1,170 @@
+#include "Reference.hpp"
+
+#include <cstring>
+
+#include "sha3.hpp"
+
+static cl_uchar nibble(const cl_uchar hash[20], const int i) {
+  return (i & 1) ? (hash[i >> 1] & 0x0f) : (hash[i >> 1] >> 4);
+}
+
+void Reference::salt(const ethhash& init, const cl_uint deviceId, const cl_uint id, const cl_ulong round, cl_uchar salt[32], const SaltTemplate& saltTemplate) {
+  saltTemplate.salt(init, deviceId, id, round, salt);
+}
+
+void Reference::address(const cl_uchar deployer[20], const cl_uchar salt[32], const cl_uchar proxyHash[32], cl_uchar hash[20], const Guard& guard) {
+  // keccak256(0xff ++ deployer ++ salt ++ keccak256(init_code))[12:]
+  cl_uchar create2[85];
+  create2[0] = 0xff;
+  memcpy(create2 + 1, deployer, 20);
+  if (guard.enabled()) {
+    guard.apply(salt, create2 + 21);
+  } else {
+    memcpy(create2 + 21, salt, 32);
+  }
+  memcpy(create2 + 53, proxyHash, 32);
+
+  cl_uchar digest[32];
+  sha3(create2, sizeof(create2), digest, 32);
+
+  // keccak256(rlp([proxy, 1]))[12:]
+  cl_uchar create[23];
+  create[0] = 0xd6;
+  create[1] = 0x94;
+  memcpy(create + 2, digest + 12, 20);
+  create[22] = 0x01;
+
+  sha3(create, sizeof(create), digest, 32);
+  memcpy(hash, digest + 12, 20);
+}
+
+void Reference::iterate(const ethhash& init, const cl_uint deviceId, const cl_uint id, const cl_ulong round, cl_uchar salt[32], cl_uchar hash[20], const SaltTemplate& saltTemplate, const Guard& guard) {
+  Reference::salt(init, deviceId, id, round, salt, saltTemplate);
+  address(init.b + 1, salt, init.b + 53, hash, guard);
+}
+
+cl_uchar Reference::threshold(const mode& m, const cl_uchar scoreMax) {
+  return m.function == ModeFunction::All ? static_cast<cl_uchar>(m.data1[0] - 1) : scoreMax;
+}
+
+int Reference::score(const mode& m, const cl_uchar hash[20], const Pattern& pattern, const Weights& weights, const Constraint& constraint) {
+  int score = 0;
+  if (!constraint.check(hash)) {
+    return score;
+  }
+
+  switch (m.function) {
+    case ModeFunction::Benchmark:
+      break;
+
+    case ModeFunction::ZeroBytes:
+      for (int i = 0; i < 20; ++i) {
+        score += !hash[i];
+      }
+      break;
+
+    case ModeFunction::Matching:
+      for (int i = 0; i < 20; ++i) {
+        if (m.data1[i] > 0 && (hash[i] & m.data1[i]) == m.data2[i]) {
+          ++score;
+        }
+      }
+      break;
+
+    case ModeFunction::MatchLeading: {
+      // Patterns longer than 20 characters continue into data2, both here and in the kernel
+      const cl_uchar* const pattern = m.data1;
+      for (int i = 0; i < m.data2[0] && i < 40; ++i) {
+        if (pattern[i] != nibble(hash, i)) {
+          break;
+        }
+        ++score;
+      }
+      break;
+    }
+
+    case ModeFunction::Leading:
+      for (int i = 0; i < 40 && nibble(hash, i) == m.data1[0]; ++i) {
+        ++score;
+      }
+      break;
+
+    case ModeFunction::Trailing:
+      for (int i = 39; i > 0 && nibble(hash, i) == m.data1[0]; --i) {
+        ++score;
+      }
+      break;
+
+    case ModeFunction::Range:
+      for (int i = 0; i < 40; ++i) {
+        score += nibble(hash, i) >= m.data1[0] && nibble(hash, i) <= m.data2[0];
+      }
+      break;
+
+    case ModeFunction::LeadingRange:
+      for (int i = 0; i < 40 && nibble(hash, i) >= m.data1[0] && nibble(hash, i) <= m.data2[0]; ++i) {
+        ++score;
+      }
+      break;
+
+    case ModeFunction::Mirror:
+      // Pairs of nibbles moving outwards from the center, 19|20, 18|21, ...
+      for (int i = 0; i < 20 && nibble(hash, 19 - i) == nibble(hash, 20 + i); ++i) {
+        ++score;
+      }
+      break;
+
+    case ModeFunction::Doubles:
+      for (int i = 0; i < 20 && (hash[i] >> 4) == (hash[i] & 0x0f); ++i) {
+        ++score;
+      }
+      break;
+
+    case ModeFunction::All: {
+      // Longest run of any character
+      int length = 1;
+      score = 1;
+      for (int i = 1; i < 40; ++i) {
+        length = nibble(hash, i) == nibble(hash, i - 1) ? length + 1 : 1;
+        score = length > score ? length : score;
+      }
+      break;
+    }
+
+    case ModeFunction::AllLeading:
+      // Number of characters following the first that are equal to it
+      for (int i = 1; i < 40 && nibble(hash, i) == nibble(hash, 0); ++i) {
+        ++score;
+      }
+      break;
+
+    case ModeFunction::AllLeadingTrailing: {
+      // Without arguments the first and last character are free and count as one, otherwise they are
+      // given by data1. Leading and trailing runs grow together, the score is the shorter run.
+      int i = 0;
+      cl_uchar chl = m.data1[0];
+      cl_uchar cht = m.data2[0] == 1 ? chl : m.data1[1];
+      if (m.data2[0] == 0) {
+        chl = nibble(hash, 0);
+        cht = nibble(hash, 39);
+        score = 1;
+        i = 1;
+      }
+
+      for (int j = 39 - i; i < 40 && nibble(hash, i) == chl && j >= 0 && nibble(hash, j) == cht; ++i, --j) {
+        ++score;
+      }
+      break;
+    }
+
+    case ModeFunction::Pattern:
+      score = pattern.score(hash);
+      break;
+
+    case ModeFunction::Weights:
+      score = weights.score(hash);
+      break;
+  }
+
+  return score;
+}
@@ -0,0 +1,43 @@
+#ifndef HPP_REFERENCE
+#define HPP_REFERENCE
+
+#include "Constraint.hpp"
+#include "Guard.hpp"
+#include "Pattern.hpp"
+#include "SaltTemplate.hpp"
+#include "Weights.hpp"
+#include "types.hpp"
+
+/* Host implementation of everything eradicate2_iterate does, built on sha3.cpp.
+ * It is deliberately written from the specification of the CREATE2/CREATE
+ * derivation rather than from the kernel's state tricks, and the scorers are
+ * straight ports of the original byte-wise kernel scorers, which the kernel
+ * has since replaced with bit tricks on 64-bit lanes. Kernel changes are
+ * checked against it by ERADICATE2-selftest.x64.
+ */
+class Reference {
+ private:
+  Reference();
+  Reference(Reference& o);
+  ~Reference();
+
+ public:
+  // Salt used by thread id of a round, as eradicate2_result_update reconstructs it
+  static void salt(const ethhash& init, const cl_uint deviceId, const cl_uint id, const cl_ulong round, cl_uchar salt[32], const SaltTemplate& saltTemplate = SaltTemplate());
+
+  // CREATE3 address: the CREATE2 address of the proxy, followed by CREATE from the proxy with nonce 1. A
+  // guarded factory deploys the proxy with the guarded salt instead of salt.
+  static void address(const cl_uchar deployer[20], const cl_uchar salt[32], const cl_uchar proxyHash[32], cl_uchar hash[20], const Guard& guard = Guard());
+
+  // Salt and address for thread id of a round, deployer and proxy hash are taken from the initial state
+  static void iterate(const ethhash& init, const cl_uint deviceId, const cl_uint id, const cl_ulong round, cl_uchar salt[32], cl_uchar hash[20], const SaltTemplate& saltTemplate = SaltTemplate(), const Guard& guard = Guard());
+
+  // Pattern and weights modes are scored by the pattern and weights the kernel was built with, addresses outside
+  // its constraint score 0
+  static int score(const mode& m, const cl_uchar hash[20], const Pattern& pattern = Pattern(), const Weights& weights = Weights(), const Constraint& constraint = Constraint());
+
+  // Scores strictly above this are reported, mirrors the scoreMax handed to eradicate2_result_update
+  static cl_uchar threshold(const mode& m, const cl_uchar scoreMax);
+};
+
+#endif /* HPP_REFERENCE */
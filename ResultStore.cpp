@@ -0,0 +1,180 @@
+#include "ResultStore.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+struct ResultStore::Header {
+  char magic[8];
+  cl_uint version;
+  cl_uint recordSize;
+  cl_ulong count;
+  cl_uchar reserved[40];
+};
+
+static const char g_storeMagic[8] = {'E', 'R', 'A', 'D', 'S', 'T', 'O', 'R'};
+static const cl_uint g_storeVersion = 1;
+
+// Records added per growth step at least, the file at most doubles after that
+static const size_t g_storeChunk = 65536;
+
+static_assert(sizeof(ResultStore::Record) == 64, "store records must be 64 bytes");
+
+// Exclusive flock() for a scope, the mutex only keeps out the threads of one store
+class FileLock {
+ public:
+  FileLock(const int fd, const string& fileName) : m_fd(fd) {
+    while (flock(m_fd, LOCK_EX) != 0) {
+      if (errno != EINTR) {
+        throw runtime_error("failed to lock result store " + fileName);
+      }
+    }
+  }
+
+  ~FileLock() {
+    flock(m_fd, LOCK_UN);
+  }
+
+ private:
+  const int m_fd;
+};
+
+ResultStore::ResultStore(const string& fileName, const bool bReadOnly) : m_fileName(fileName), m_bReadOnly(bReadOnly), m_fd(-1), m_pMap(NULL), m_mapSize(0), m_pHeader(NULL) {
+  static_assert(sizeof(Header) == sizeof(Record), "store header must be one record");
+
+  m_fd = open(fileName.c_str(), bReadOnly ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+  if (m_fd < 0) {
+    throw runtime_error("failed to open result store " + fileName);
+  }
+
+  // Held until the store is mapped, so other writers can't create or grow it meanwhile. A store that fails
+  // to open doesn't get destroyed, it cleans up here.
+  try {
+    const FileLock lock(m_fd, fileName);
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) {
+      throw runtime_error("failed to stat result store " + fileName);
+    }
+
+    const size_t fileSize = static_cast<size_t>(st.st_size);
+    if (fileSize == 0 && !bReadOnly) {
+      map(g_storeChunk);
+      memcpy(m_pHeader->magic, g_storeMagic, sizeof(g_storeMagic));
+      m_pHeader->version = g_storeVersion;
+      m_pHeader->recordSize = sizeof(Record);
+      m_pHeader->count = 0;
+      return;
+    }
+
+    if (fileSize < sizeof(Header)) {
+      throw runtime_error("not a result store " + fileName);
+    }
+
+    map((fileSize - sizeof(Header)) / sizeof(Record));
+    if (memcmp(m_pHeader->magic, g_storeMagic, sizeof(g_storeMagic)) != 0 || m_pHeader->version != g_storeVersion || m_pHeader->recordSize != sizeof(Record) || sizeof(Header) + m_pHeader->count * sizeof(Record) > m_mapSize) {
+      throw runtime_error("not a result store or an incompatible version " + fileName);
+    }
+  } catch (...) {
+    if (m_pMap) {
+      munmap(m_pMap, m_mapSize);
+    }
+    close(m_fd);
+    throw;
+  }
+}
+
+ResultStore::~ResultStore() {
+  if (m_pMap) {
+    munmap(m_pMap, m_mapSize);
+  }
+
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+}
+
+void ResultStore::append(const Record& r) {
+  if (m_bReadOnly) {
+    throw runtime_error("result store " + m_fileName + " is read only");
+  }
+
+  lock_guard<mutex> lock(m_mutex);
+  const FileLock fileLock(m_fd, m_fileName);
+
+  // Other writers may have grown the file past this store's mapping, it's mapped as it is before growing further
+  if (m_pHeader->count >= capacity()) {
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) {
+      throw runtime_error("failed to stat result store " + m_fileName);
+    }
+
+    const size_t fileCapacity = (static_cast<size_t>(st.st_size) - sizeof(Header)) / sizeof(Record);
+    if (fileCapacity > capacity()) {
+      map(fileCapacity);
+    }
+  }
+
+  if (m_pHeader->count >= capacity()) {
+    map(capacity() + max(capacity(), g_storeChunk));
+  }
+
+  Record* const pRecords = reinterpret_cast<Record*>(m_pHeader + 1);
+  pRecords[m_pHeader->count] = r;
+  __atomic_store_n(&m_pHeader->count, m_pHeader->count + 1, __ATOMIC_RELEASE);
+}
+
+void ResultStore::append(const cl_uchar score, const result& r, const ModeFunction function, const cl_ulong jobId) {
+  Record rec;
+  memcpy(rec.salt, r.salt, sizeof(rec.salt));
+  memcpy(rec.hash, r.hash, sizeof(rec.hash));
+  rec.score = score;
+  rec.function = static_cast<cl_uchar>(function);
+  rec.reserved[0] = rec.reserved[1] = 0;
+  rec.jobId = jobId;
+  append(rec);
+}
+
+size_t ResultStore::size() const {
+  lock_guard<mutex> lock(m_mutex);
+  return min<size_t>(__atomic_load_n(&m_pHeader->count, __ATOMIC_ACQUIRE), capacity());
+}
+
+const ResultStore::Record* ResultStore::records() const {
+  return reinterpret_cast<const Record*>(m_pHeader + 1);
+}
+
+size_t ResultStore::capacity() const {
+  return (m_mapSize - sizeof(Header)) / sizeof(Record);
+}
+
+void ResultStore::map(const size_t capacity) {
+  const size_t mapSize = sizeof(Header) + capacity * sizeof(Record);
+  if (m_pMap) {
+    munmap(m_pMap, m_mapSize);
+    m_pMap = NULL;
+  }
+
+  // The file only ever grows, other writers may have mapped more of it than this store
+  if (!m_bReadOnly) {
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || (static_cast<size_t>(st.st_size) < mapSize && ftruncate(m_fd, static_cast<off_t>(mapSize)) != 0)) {
+      throw runtime_error("failed to grow result store " + m_fileName);
+    }
+  }
+
+  void* const p = mmap(NULL, mapSize, m_bReadOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (p == MAP_FAILED) {
+    throw runtime_error("failed to map result store " + m_fileName);
+  }
+
+  m_pMap = p;
+  m_mapSize = mapSize;
+  m_pHeader = static_cast<Header*>(p);
+}
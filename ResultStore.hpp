@@ -0,0 +1,75 @@
+#ifndef HPP_RESULTSTORE
+#define HPP_RESULTSTORE
+
+#include <mutex>
+#include <string>
+
+#include "types.hpp"
+
+using namespace std;
+
+/* Binary, append only store of results shared by any number of runs. The file
+ * is a 64 byte header followed by fixed 64 byte records and is mapped into
+ * memory, so appending is a copy and reading a whole store back costs no parsing.
+ *
+ * The file grows in chunks and the header holds the number of valid records,
+ * it's only bumped once a record is complete. A store that was being written
+ * when the process died is still consistent up to its last complete record.
+ *
+ * Appends hold an flock() on the file, so writers in other processes and other
+ * stores on the same file take turns, and a store remaps the file when another
+ * writer has grown it.
+ *
+ * Records are stored in host byte order, stores aren't portable between hosts
+ * of different endianness.
+ */
+class ResultStore {
+ public:
+#pragma pack(push, 1)
+  struct Record {
+    cl_uchar salt[32];
+    cl_uchar hash[20];
+    cl_uchar score;
+    cl_uchar function;  // ModeFunction the score was given under, NoMode if unknown
+    cl_uchar reserved[2];
+    cl_ulong jobId;
+  };
+#pragma pack(pop)
+
+  static const cl_uchar NoMode = 0xff;
+
+ public:
+  // Opens or creates a store, read only stores are mapped as they are and can't be appended to
+  ResultStore(const string& fileName, const bool bReadOnly = false);
+  ~ResultStore();
+
+  // Safe to call from any thread
+  void append(const Record& r);
+  void append(const cl_uchar score, const result& r, const ModeFunction function, const cl_ulong jobId);
+
+  // Records that fit this store's mapping, those other writers appended since it last grew aren't counted
+  size_t size() const;
+
+  // Records stay valid until the next append
+  const Record* records() const;
+
+ private:
+  ResultStore(ResultStore& o);
+  ResultStore& operator=(const ResultStore& o);
+
+  void map(const size_t capacity);
+  size_t capacity() const;
+
+ private:
+  struct Header;
+
+  const string m_fileName;
+  const bool m_bReadOnly;
+  int m_fd;
+  void* m_pMap;
+  size_t m_mapSize;
+  Header* m_pHeader;
+  mutable mutex m_mutex;
+};
+
+#endif /* HPP_RESULTSTORE */
@@ -0,0 +1,63 @@
+#include "ResultWriter.hpp"
+
+#include "hexadecimal.hpp"
+
+ResultWriter::ResultWriter(const string& fileName) : m_file(fileName, ios::app), m_quit(false), m_dedupHits(0), m_written(0), m_thread(&ResultWriter::loop, this) {
+}
+
+ResultWriter::~ResultWriter() {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_quit = true;
+  }
+
+  m_cv.notify_one();
+  m_thread.join();
+}
+
+void ResultWriter::push(const cl_uchar score, const result& r) {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_queue.emplace_back(score, r);
+  }
+
+  m_cv.notify_one();
+}
+
+size_t ResultWriter::depth() const {
+  lock_guard<mutex> lock(m_mutex);
+  return m_queue.size();
+}
+
+unsigned long long ResultWriter::dedupHits() const {
+  return m_dedupHits;
+}
+
+unsigned long long ResultWriter::written() const {
+  return m_written;
+}
+
+void ResultWriter::loop() {
+  unique_lock<mutex> lock(m_mutex);
+
+  while (true) {
+    m_cv.wait(lock, [&] { return m_quit || !m_queue.empty(); });
+    if (m_queue.empty()) {
+      break;
+    }
+
+    const auto item = m_queue.front();
+    m_queue.pop_front();
+    lock.unlock();
+
+    const string addr = toHex(item.second.hash, 20);
+    if (m_saved.insert(addr).second) {
+      m_file << (int)item.first << ",0x" << toHex(item.second.salt, 32) << ",0x" << addr << endl;
+      ++m_written;
+    } else {
+      ++m_dedupHits;
+    }
+
+    lock.lock();
+  }
+}
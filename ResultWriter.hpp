@@ -0,0 +1,50 @@
+#ifndef HPP_RESULTWRITER
+#define HPP_RESULTWRITER
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "types.hpp"
+
+using namespace std;
+
+/* Writes results to the output file from its own thread so that the device
+ * callbacks never block on disk. Addresses already written are skipped, the
+ * kernel keeps reporting the first result of every score on each round.
+ */
+class ResultWriter {
+ public:
+  ResultWriter(const string& fileName);
+  ~ResultWriter();
+
+  void push(const cl_uchar score, const result& r);
+
+  size_t depth() const;
+  unsigned long long dedupHits() const;
+  unsigned long long written() const;
+
+ private:
+  void loop();
+
+ private:
+  ofstream m_file;
+  set<string> m_saved;
+
+  mutable mutex m_mutex;
+  condition_variable m_cv;
+  deque<pair<cl_uchar, result>> m_queue;
+  bool m_quit;
+
+  atomic<unsigned long long> m_dedupHits;
+  atomic<unsigned long long> m_written;
+
+  thread m_thread;
+};
+
+#endif /* HPP_RESULTWRITER */
@@ -0,0 +1,197 @@
+#include "SaltTemplate.hpp"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "hexadecimal.hpp"
+
+#define ERADICATE2_SALT_COUNTER_BYTES 9
+#define ERADICATE2_SALT_DEVICE_ID_BYTES 4
+#define ERADICATE2_SALT_ROUND_BYTES 8
+
+SaltTemplate::SaltTemplate() : m_bEnabled(false) {
+  fill(m_value, m_value + 32, cl_uchar(0));
+  fill(m_free, m_free + 32, true);
+}
+
+SaltTemplate SaltTemplate::parse(const string& strTemplate) {
+  string s = strTemplate;
+  if (s.size() >= 2 && s.substr(0, 2) == "0x") {
+    s.erase(0, 2);
+  }
+
+  if (s.size() % 2 != 0 || s.size() > 64) {
+    throw runtime_error("salt template must be at most 32 whole bytes");
+  }
+
+  SaltTemplate t;
+  t.m_bEnabled = true;
+  for (size_t i = 0; i < s.size(); i += 2) {
+    if (s[i] == '?' && s[i + 1] == '?') {
+      continue;
+    }
+
+    if (s[i] == '?' || s[i + 1] == '?') {
+      throw runtime_error("salt template can only leave whole bytes free");
+    }
+
+    t.m_value[i / 2] = static_cast<cl_uchar>(hexValue(s[i]) * 16 + hexValue(s[i + 1]));
+    t.m_free[i / 2] = false;
+  }
+
+  if (t.freeBytes() < ERADICATE2_SALT_COUNTER_BYTES) {
+    throw runtime_error("salt template needs at least " + to_string(ERADICATE2_SALT_COUNTER_BYTES) + " free bytes for the device, round and thread counters");
+  }
+
+  return t;
+}
+
+bool SaltTemplate::enabled() const {
+  return m_bEnabled;
+}
+
+size_t SaltTemplate::freeBytes() const {
+  return count(m_free, m_free + 32, true);
+}
+
+string SaltTemplate::str() const {
+  string r = "0x";
+  for (size_t i = 0; i < 32; ++i) {
+    r += m_free[i] ? "??" : toHex(m_value + i, 1);
+  }
+
+  return r;
+}
+
+void SaltTemplate::apply(ethhash& h, const unsigned long long seed) const {
+  if (!m_bEnabled) {
+    return;
+  }
+
+  random_device rd;
+  mt19937_64 eng(seed == 0 ? rd() : seed);
+  uniform_int_distribution<unsigned int> distr(0, 255);
+
+  for (size_t i = 0; i < 32; ++i) {
+    h.b[21 + i] = m_free[i] ? static_cast<cl_uchar>(distr(eng)) : m_value[i];
+  }
+}
+
+SaltTemplate::Counters SaltTemplate::counters() const {
+  vector<int> vFree;
+  for (int i = 0; i < 32; ++i) {
+    if (m_free[i]) {
+      vFree.push_back(i);
+    }
+  }
+
+  // Bytes beyond the minimum widen the device id first, fleets outgrow one byte long before a device
+  // exhausts 2^32 rounds, then the round
+  const size_t extra = vFree.size() - ERADICATE2_SALT_COUNTER_BYTES;
+  const size_t deviceIdBytes = min<size_t>(ERADICATE2_SALT_DEVICE_ID_BYTES, 1 + extra);
+  const size_t roundBytes = min<size_t>(ERADICATE2_SALT_ROUND_BYTES, 4 + extra - (deviceIdBytes - 1));
+
+  // Thread id in the last four free bytes, the round before it and the device id before that. Read
+  // as hex they show up in big endian order when the free bytes are contiguous.
+  Counters c;
+  auto it = vFree.rbegin();
+  c.id.assign(it, it + 4);
+  it += 4;
+  c.round.assign(it, it + roundBytes);
+  it += roundBytes;
+  c.deviceId.assign(it, it + deviceIdBytes);
+  return c;
+}
+
+cl_ulong SaltTemplate::roundMax() const {
+  const size_t bytes = m_bEnabled ? counters().round.size() : ERADICATE2_SALT_ROUND_BYTES;
+  return bytes == 8 ? ~0ULL : (1ULL << (8 * bytes)) - 1;
+}
+
+cl_uint SaltTemplate::deviceIdMax() const {
+  const size_t bytes = m_bEnabled ? counters().deviceId.size() : ERADICATE2_SALT_DEVICE_ID_BYTES;
+  return static_cast<cl_uint>((1ULL << (8 * bytes)) - 1);
+}
+
+cl_uint SaltTemplate::deviceId(const cl_uint workerId, const size_t deviceIndex) {
+  if (deviceIndex > 0xff) {
+    throw runtime_error("device index " + to_string(deviceIndex) + " doesn't fit the salt's eight bits, run more workers with fewer devices each");
+  }
+
+  if (workerId > 0xffffff) {
+    throw runtime_error("worker id " + to_string(workerId) + " doesn't fit the salt's 24 bits");
+  }
+
+  return (workerId << 8) | static_cast<cl_uint>(deviceIndex);
+}
+
+void SaltTemplate::salt(const ethhash& init, const cl_uint deviceId, const cl_uint id, const cl_ulong round, cl_uchar salt[32]) const {
+  ethhash h = init;
+
+  if (!m_bEnabled) {
+    for (int i = 0; i < 3; ++i) {
+      h.b[21 + i] ^= static_cast<cl_uchar>(deviceId >> (8 + 8 * i));
+    }
+    h.q[3] += round;
+    h.d[8] += id;
+    h.b[36] ^= static_cast<cl_uchar>(deviceId);
+  } else {
+    const Counters c = counters();
+    for (size_t i = 0; i < c.deviceId.size(); ++i) {
+      h.b[21 + c.deviceId[i]] ^= static_cast<cl_uchar>(deviceId >> (8 * i));
+    }
+
+    for (size_t i = 0; i < c.id.size(); ++i) {
+      h.b[21 + c.id[i]] ^= static_cast<cl_uchar>(id >> (8 * i));
+    }
+
+    for (size_t i = 0; i < c.round.size(); ++i) {
+      h.b[21 + c.round[i]] ^= static_cast<cl_uchar>(round >> (8 * i));
+    }
+  }
+
+  copy(h.b + 21, h.b + 53, salt);
+}
+
+string SaltTemplate::source() const {
+  if (!m_bEnabled) {
+    return "";
+  }
+
+  // Terms grouped by the state lane they land in, one XOR per lane
+  vector<string> vLanes(25);
+  const auto add = [&](const int saltIndex, const string& variable, const int byte) {
+    const int lane = (21 + saltIndex) / 8;
+    const int shift = 8 * ((21 + saltIndex) % 8);
+    ostringstream oss;
+    oss << (vLanes[lane].empty() ? "" : " | ") << "((ulong)((" << variable << " >> " << 8 * byte << ") & 0xff) << " << shift << ")";
+    vLanes[lane] += oss.str();
+  };
+
+  const Counters c = counters();
+  for (size_t i = 0; i < c.deviceId.size(); ++i) {
+    add(c.deviceId[i], "deviceId", i);
+  }
+
+  for (size_t i = 0; i < c.round.size(); ++i) {
+    add(c.round[i], "round", i);
+  }
+
+  for (size_t i = 0; i < c.id.size(); ++i) {
+    add(c.id[i], "id", i);
+  }
+
+  ostringstream oss;
+  oss << "#define ERADICATE2_SALT_TEMPLATE" << endl;
+  oss << "void eradicate2_salt_apply(ethhash * const h, const uint deviceId, const uint id, const ulong round) {" << endl;
+  for (size_t i = 0; i < vLanes.size(); ++i) {
+    if (!vLanes[i].empty()) {
+      oss << "\th->q[" << i << "] ^= " << vLanes[i] << ";" << endl;
+    }
+  }
+  oss << "}" << endl;
+
+  return oss.str();
+}
@@ -0,0 +1,72 @@
+#ifndef HPP_SALTTEMPLATE
+#define HPP_SALTTEMPLATE
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+using namespace std;
+
+/* Constrains the 32 byte salt to a template of fixed and free bytes, written as
+ * hex with ?? for every free byte, e.g. 0x<20 byte caller>00???????????????????????
+ * Bytes left out at the end are free.
+ *
+ * Fixed bytes are stored in the initial state and fold into the kernel's
+ * constant initializer. Free bytes start out random and the device id, round
+ * and thread id are XORed into the last of them, which is why at least nine are
+ * required. The thread id always takes four bytes and the others grow with the
+ * bytes available: the device id from one up to four, then the round from four
+ * up to eight. The XORs are generated as OpenCL source and prepended to
+ * eradicate2.cl, replacing its default layout.
+ *
+ * A default constructed template is disabled and reproduces the default layout
+ * documented above eradicate2_salt_apply: 16 random bytes holding a 32 bit
+ * device id, a 64 bit round and the thread id, followed by keccak(deployer).
+ *
+ * The device id is the worker id shifted left by eight bits with the device's
+ * index on the worker below it, see deviceId().
+ */
+class SaltTemplate {
+ public:
+  SaltTemplate();
+
+  static SaltTemplate parse(const string& strTemplate);
+
+  bool enabled() const;
+  size_t freeBytes() const;
+  string str() const;
+
+  // Overwrites fixed salt bytes in the initial state and randomizes the free ones, seed 0 means random_device
+  void apply(ethhash& h, const unsigned long long seed = 0) const;
+
+  // Largest round and device id the layout holds, beyond them salts would repeat
+  cl_ulong roundMax() const;
+  cl_uint deviceIdMax() const;
+
+  // Device id passed to the kernel for a device of a worker, throws when the index doesn't fit its eight bits
+  static cl_uint deviceId(const cl_uint workerId, const size_t deviceIndex);
+
+  // Salt used by the kernel for a device, thread and round, given the initial state
+  void salt(const ethhash& init, const cl_uint deviceId, const cl_uint id, const cl_ulong round, cl_uchar salt[32]) const;
+
+  // OpenCL source defining eradicate2_salt_apply, empty when disabled
+  string source() const;
+
+ private:
+  // Salt index that byte i (least significant first) of the device id, thread id and round is XORed into
+  struct Counters {
+    vector<int> deviceId;
+    vector<int> id;
+    vector<int> round;
+  };
+
+  Counters counters() const;
+
+ private:
+  bool m_bEnabled;
+  cl_uchar m_value[32];
+  bool m_free[32];
+};
+
+#endif /* HPP_SALTTEMPLATE */
@@ -0,0 +1,112 @@
+#include "Scheduler.hpp"
+
+#include <stdexcept>
+
+#include "lexical_cast.hpp"
+
+Scheduler::Scheduler(const vector<Job>& vJobs) : m_vJobs(vJobs), m_vPass(vJobs.size(), 0), m_vLaunched(vJobs.size(), 0), m_vCompleted(vJobs.size(), 0) {
+  for (auto& j : m_vJobs) {
+    if (j.weight == 0) {
+      throw runtime_error("job weights must be at least 1");
+    }
+  }
+}
+
+bool Scheduler::next(const function<bool(size_t)>& bUsable, size_t& job) {
+  lock_guard<mutex> lock(m_mutex);
+  bool bFound = false;
+  for (size_t i = 0; i < m_vJobs.size(); ++i) {
+    if (!runnable(i) || !bUsable(i)) {
+      continue;
+    }
+
+    const bool bBetter = !bFound || m_vJobs[i].priority > m_vJobs[job].priority || (m_vJobs[i].priority == m_vJobs[job].priority && m_vPass[i] < m_vPass[job]);
+    if (bBetter) {
+      job = i;
+      bFound = true;
+    }
+  }
+
+  if (bFound) {
+    ++m_vLaunched[job];
+    m_vPass[job] += static_cast<double>(m_vJobs[job].size) / m_vJobs[job].weight;
+  }
+
+  return bFound;
+}
+
+void Scheduler::completed(const size_t job) {
+  lock_guard<mutex> lock(m_mutex);
+  ++m_vCompleted[job];
+}
+
+void Scheduler::setShare(const size_t job, const unsigned int weight, const int priority) {
+  if (weight == 0) {
+    throw runtime_error("job weights must be at least 1");
+  }
+
+  lock_guard<mutex> lock(m_mutex);
+  if (job >= m_vJobs.size()) {
+    throw runtime_error("there's no job " + lexical_cast::write(job) + " in the run");
+  }
+
+  m_vJobs[job].weight = weight;
+  m_vJobs[job].priority = priority;
+
+  bool bFound = false;
+  double pass = 0;
+  for (size_t i = 0; i < m_vJobs.size(); ++i) {
+    if (i != job && runnable(i) && m_vJobs[i].priority == priority && (!bFound || m_vPass[i] < pass)) {
+      pass = m_vPass[i];
+      bFound = true;
+    }
+  }
+
+  if (bFound) {
+    m_vPass[job] = pass;
+  }
+}
+
+bool Scheduler::done() const {
+  lock_guard<mutex> lock(m_mutex);
+  for (size_t i = 0; i < m_vJobs.size(); ++i) {
+    if (runnable(i)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+vector<Scheduler::Stats> Scheduler::stats() const {
+  lock_guard<mutex> lock(m_mutex);
+
+  // Shares are split among the runnable jobs of the highest priority
+  bool bRunning = false;
+  int priorityTop = 0;
+  unsigned long long weights = 0;
+  for (size_t i = 0; i < m_vJobs.size(); ++i) {
+    if (runnable(i) && (!bRunning || m_vJobs[i].priority > priorityTop)) {
+      priorityTop = m_vJobs[i].priority;
+      bRunning = true;
+    }
+  }
+
+  for (size_t i = 0; i < m_vJobs.size(); ++i) {
+    if (runnable(i) && m_vJobs[i].priority == priorityTop) {
+      weights += m_vJobs[i].weight;
+    }
+  }
+
+  vector<Stats> vStats;
+  for (size_t i = 0; i < m_vJobs.size(); ++i) {
+    const bool bShare = bRunning && runnable(i) && m_vJobs[i].priority == priorityTop;
+    vStats.push_back(Stats{m_vCompleted[i], m_vCompleted[i] * m_vJobs[i].size, m_vJobs[i].weight, m_vJobs[i].priority, bShare ? static_cast<double>(m_vJobs[i].weight) / weights : 0.0});
+  }
+
+  return vStats;
+}
+
+bool Scheduler::runnable(const size_t job) const {
+  return m_vJobs[job].rounds == 0 || m_vLaunched[job] < m_vJobs[job].rounds;
+}
@@ -0,0 +1,74 @@
+#ifndef HPP_SCHEDULER
+#define HPP_SCHEDULER
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "types.hpp"
+
+using namespace std;
+
+/* Round-level fair share between the jobs of a scheduled run, see
+ * Dispatcher::run(). Instead of every launch running all jobs, each round of a
+ * device runs the one job next() picks:
+ *
+ *   - Only jobs of the highest priority with rounds left run, the others wait
+ *     until those are done. An urgent job takes the devices over from their
+ *     next round and gives them back once it has run its rounds.
+ *   - Among those, the job furthest behind its share of the salts goes next
+ *     (stride scheduling). Every round moves its job's pass on by the job's
+ *     size over its weight and the lowest pass wins, so over any stretch of
+ *     rounds a job gets its weight over the weights of the jobs running with
+ *     it, give or take a round of each.
+ *
+ * A job whose share changes starts from the lowest pass of the jobs it joins,
+ * so it neither makes up for the time it waited nor waits for the others to
+ * catch up with it. Rounds that are running aren't interrupted, changes take
+ * effect from the next round of every device.
+ *
+ * completed() accounts the salts of every round that completed to its job,
+ * stats() shows them next to the share the job is meant to get.
+ */
+class Scheduler {
+ public:
+  struct Job {
+    size_t size;  // Salts of one of its rounds
+    unsigned int weight;
+    int priority;
+    cl_ulong rounds;  // Rounds of all devices together before it's done, 0 for no end
+  };
+
+  struct Stats {
+    cl_ulong rounds;  // Completed
+    unsigned long long salts;
+    unsigned int weight;
+    int priority;
+    double share;  // Of the salts it's meant to get now, 0 while it waits and once it's done
+  };
+
+ public:
+  Scheduler(const vector<Job>& vJobs);
+
+  // The job of a device's next round among those bUsable accepts, false if none has rounds left
+  bool next(const function<bool(size_t)>& bUsable, size_t& job);
+  void completed(const size_t job);
+
+  // Weights are at least 1
+  void setShare(const size_t job, const unsigned int weight, const int priority);
+
+  bool done() const;
+  vector<Stats> stats() const;
+
+ private:
+  bool runnable(const size_t job) const;
+
+ private:
+  mutable mutex m_mutex;
+  vector<Job> m_vJobs;
+  vector<double> m_vPass;
+  vector<cl_ulong> m_vLaunched;
+  vector<cl_ulong> m_vCompleted;
+};
+
+#endif /* HPP_SCHEDULER */
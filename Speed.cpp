@@ -1,12 +1,11 @@
 #include "Speed.hpp"
 
 #include <functional>
-#include <iostream>
 #include <sstream>
-#include <numeric>
 #include <iomanip>
 
-static std::string formatSpeed(double f) {
+std::string Speed::format(const double speed) {
+	double f = speed;
 	const std::string S = " KMGT";
 
 	unsigned int index = 0;
@@ -29,58 +28,86 @@ Speed::Speed(const unsigned int intervalPrintMs, const unsigned int intervalSamp
 Speed::~Speed() {
 }
 
-void Speed::update(const unsigned int numPoints, const unsigned int indexDevice) {
-	std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
-
-	const auto ns = std::chrono::steady_clock::now().time_since_epoch().count();
-	const bool bPrint = ((ns - m_lastPrint) / 1000000) > m_intervalPrintMs;
+void Speed::addDevice(const unsigned int indexDevice) {
+	std::unique_ptr<DeviceSamples> & p = m_mDeviceSamples[indexDevice];
+	p.reset(new DeviceSamples());
+	p->head = 0;
+	for (auto & s : p->samples) {
+		s.ns = 0;
+		s.points = 0;
+	}
+}
 
-	updateList(numPoints, ns, m_mDeviceSamples[indexDevice]);
+void Speed::reset(const unsigned int indexDevice) {
+	const auto it = m_mDeviceSamples.find(indexDevice);
+	if (it != m_mDeviceSamples.end()) {
+		it->second->head.store(0, std::memory_order_release);
+	}
+}
 
-	if (bPrint) {
-		m_lastPrint = ns;
-		this->print();
+bool Speed::update(const unsigned int numPoints, const unsigned int indexDevice) {
+	const auto it = m_mDeviceSamples.find(indexDevice);
+	if (it == m_mDeviceSamples.end()) {
+		return false;
 	}
+
+	const auto ns = std::chrono::steady_clock::now().time_since_epoch().count();
+
+	// Only the device's own callback writes to its ring, the release on head publishes the sample
+	DeviceSamples & d = *it->second;
+	const auto head = d.head.load(std::memory_order_relaxed);
+	Sample & s = d.samples[head % SampleCount];
+	s.ns.store(ns, std::memory_order_relaxed);
+	s.points.store(numPoints, std::memory_order_relaxed);
+	d.head.store(head + 1, std::memory_order_release);
+
+	// Whichever callback wins the exchange does the printing
+	long long lastPrint = m_lastPrint.load(std::memory_order_relaxed);
+	return (ns - lastPrint) / 1000000 > m_intervalPrintMs && m_lastPrint.compare_exchange_strong(lastPrint, ns);
 }
 
 double Speed::getSpeed(const unsigned int indexDevice) const {
-	return m_mDeviceSamples.count(indexDevice) == 0 ? 0 : this->getSpeed(m_mDeviceSamples.at(indexDevice));
+	const auto it = m_mDeviceSamples.find(indexDevice);
+	return it == m_mDeviceSamples.end() ? 0 : this->getSpeed(*it->second);
 }
 
-double Speed::getSpeed(const sampleList & l) const {
-	std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
-	if (l.size() == 0) {
+double Speed::getSpeed(const DeviceSamples & d) const {
+	const auto head = d.head.load(std::memory_order_acquire);
+	if (head < 2) {
 		return 0.0;
 	}
 
-	auto lambda = [&](double a, samplePair b) { return a + static_cast<double>(b.second); };
-
-	const double timeDelta = static_cast<double>(l.back().first - l.front().first);
-	const double numPointsSum = std::accumulate(l.begin(), l.end(), 0.0, lambda);
+	// Walk backwards from the newest sample until the sample interval is covered. One slot is left
+	// untouched since the writer may be filling it while we read.
+	const long long nsLast = d.samples[(head - 1) % SampleCount].ns.load(std::memory_order_relaxed);
+	long long nsFirst = nsLast;
+	double numPointsSum = 0.0;
+
+	for (unsigned long long i = head - 1; i > 0 && head - i < SampleCount - 1; --i) {
+		const Sample & prev = d.samples[(i - 1) % SampleCount];
+		const long long ns = prev.ns.load(std::memory_order_relaxed);
+		if ((nsLast - ns) / 1000000 > m_intervalSampleMs) {
+			break;
+		}
+
+		numPointsSum += static_cast<double>(d.samples[i % SampleCount].points.load(std::memory_order_relaxed));
+		nsFirst = ns;
+	}
 
+	const double timeDelta = static_cast<double>(nsLast - nsFirst);
 	return timeDelta == 0.0 ? 0.0 : numPointsSum / (timeDelta / 1000000000.0);
 }
 
-void Speed::updateList(const unsigned int & numPoints, const long long & ns, sampleList & l) {
-	l.push_back(samplePair(ns, numPoints));
-
-	// Pop old samples until time difference between first and last element is less than or equal to m_sampleSeconds
-	while (l.size() > 2 && (l.back().first - l.front().first) / 1000000 > m_intervalSampleMs) {
-		l.pop_front();
-	}
-}
+Speed::Snapshot Speed::snapshot() const {
+	Snapshot r;
+	r.total = 0.0;
 
-void Speed::print() const {
-	double totalSpeed = 0.0;
-	// std::ostringstream oss;
 	// std::map is sorted by key so we'll always have the devices in numerical order
 	for (auto it = m_mDeviceSamples.begin(); it != m_mDeviceSamples.end(); ++it) {
-		const double speed = this->getSpeed(it->second);
-		totalSpeed += speed;
-		// oss << " GPU" << it->first << ": " << formatSpeed(speed);
+		const double speed = this->getSpeed(*it->second);
+		r.devices.push_back(std::make_pair(it->first, speed));
+		r.total += speed;
 	}
 
-	const std::string strVT100ClearLine = "\33[2K\r";
-	std::cout << strVT100ClearLine << "Speed: " << formatSpeed(totalSpeed) << "\r" << std::flush;
-	// std::cout << strVT100ClearLine << "Speed: " << formatSpeed(totalSpeed) << oss<< "\r" << std::flush;
+	return r;
 }
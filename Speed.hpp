@@ -1,36 +1,64 @@
 #ifndef _HPP_SPEED
 #define _HPP_SPEED
 
+#include <atomic>
 #include <chrono>
-#include <mutex>
-#include <list>
 #include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
+/* Every device owns a fixed ring of samples that only its own callback writes
+ * to, so update() neither locks nor allocates. Readers walk the rings without
+ * synchronizing with the writers and get a slightly stale but consistent-enough
+ * snapshot, which is all that printing and metrics need.
+ */
 class Speed {
 public:
-	typedef std::pair<long long, size_t> samplePair;
-	typedef std::list<samplePair> sampleList;
+	struct Snapshot {
+		std::vector<std::pair<unsigned int, double>> devices;
+		double total;
+	};
 
 public:
 	Speed(const unsigned int intervalPrintMs = 500, const unsigned int intervalSampleMs = 10000);
 	~Speed();
 
-	void update(const unsigned int numPoints, const unsigned int indexDevice);
-	void print() const;
+	// Devices must be added before the first call to update()
+	void addDevice(const unsigned int indexDevice);
+
+	// Returns true for the one caller per print interval that should report progress
+	bool update(const unsigned int numPoints, const unsigned int indexDevice);
+
+	// Drops the device's samples so it reads 0 until it updates again, e.g. after it failed
+	void reset(const unsigned int indexDevice);
 
 	double getSpeed(const unsigned int indexDevice) const;
+	Snapshot snapshot() const;
+
+	static std::string format(const double speed);
 
 private:
-	double getSpeed(const sampleList & l) const;
-	void updateList(const unsigned int & numPoints, const long long & ns, sampleList & l);
+	static const unsigned int SampleCount = 64;
+
+	struct Sample {
+		std::atomic<long long> ns;
+		std::atomic<unsigned long long> points;
+	};
+
+	struct DeviceSamples {
+		std::atomic<unsigned long long> head;
+		Sample samples[SampleCount];
+	};
+
+	double getSpeed(const DeviceSamples & d) const;
 
 private:
 	const unsigned int m_intervalPrintMs;
 	const unsigned int m_intervalSampleMs;
 
-	long long m_lastPrint;
-	mutable std::recursive_mutex m_mutex;
-	std::map<unsigned int, sampleList> m_mDeviceSamples;
+	std::atomic<long long> m_lastPrint;
+	std::map<unsigned int, std::unique_ptr<DeviceSamples>> m_mDeviceSamples;
 };
 
 #endif /* _HPP_SPEED */
\ No newline at end of file
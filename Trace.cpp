@@ -0,0 +1,50 @@
+#include "Trace.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+Trace::Trace(const std::string& fileName) : m_file(fileName, std::ios::trunc), m_nsStart(now()), m_bFirst(true) {
+  m_file << "[" << std::endl;
+}
+
+Trace::~Trace() {
+  m_file << std::endl
+         << "]" << std::endl;
+}
+
+void Trace::process(const unsigned int pid, const std::string& name) {
+  std::ostringstream oss;
+  oss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"args\":{\"name\":\"" << name << "\"}}";
+  write(oss.str());
+}
+
+void Trace::thread(const unsigned int pid, const unsigned int tid, const std::string& name) {
+  std::ostringstream oss;
+  oss << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"args\":{\"name\":\"" << name << "\"}}";
+  write(oss.str());
+}
+
+void Trace::complete(const std::string& name, const unsigned int pid, const unsigned int tid, const long long nsStart, const long long nsEnd, const std::string& args) {
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(3);
+  oss << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid;
+  oss << ",\"ts\":" << (nsStart - m_nsStart) / 1000.0 << ",\"dur\":" << (nsEnd - nsStart) / 1000.0;
+  if (!args.empty()) {
+    oss << ",\"args\":{" << args << "}";
+  }
+  oss << "}";
+  write(oss.str());
+}
+
+long long Trace::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::write(const std::string& event) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_bFirst) {
+    m_file << "," << std::endl;
+  }
+  m_file << event << std::flush;
+  m_bFirst = false;
+}
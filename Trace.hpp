@@ -0,0 +1,37 @@
+#ifndef HPP_TRACE
+#define HPP_TRACE
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+/* Streams events in Chrome trace format (chrome://tracing, Perfetto). Events are
+ * written as they arrive and the closing bracket is optional in that format, so
+ * the file stays loadable even if the process is killed mid-run.
+ *
+ * Timestamps are nanoseconds on the host steady clock, converted to microseconds
+ * relative to when the trace was opened.
+ */
+class Trace {
+ public:
+  Trace(const std::string& fileName);
+  ~Trace();
+
+  void process(const unsigned int pid, const std::string& name);
+  void thread(const unsigned int pid, const unsigned int tid, const std::string& name);
+  void complete(const std::string& name, const unsigned int pid, const unsigned int tid, const long long nsStart, const long long nsEnd, const std::string& args = "");
+
+  static long long now();
+
+ private:
+  void write(const std::string& event);
+
+ private:
+  std::mutex m_mutex;
+  std::ofstream m_file;
+  const long long m_nsStart;
+  bool m_bFirst;
+};
+
+#endif /* HPP_TRACE */
@@ -0,0 +1,164 @@
+#include "Verifier.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "Reference.hpp"
+#include "hexadecimal.hpp"
+
+Verifier::Verifier(const vector<job>& vJobs, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard, const unsigned int threads, function<void(const Hit&)> onVerified, function<void(const Hit&)> onMismatch)
+    : m_vJobs(vJobs), m_pattern(pattern), m_weights(weights), m_constraint(constraint), m_guard(guard), m_onVerified(onVerified), m_onMismatch(onMismatch), m_quit(false), m_verified(0), m_repeats(0) {
+  for (unsigned int i = 0; i < max(threads, 1u); ++i) {
+    m_vThreads.emplace_back(&Verifier::loop, this);
+  }
+}
+
+Verifier::~Verifier() {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_quit = true;
+  }
+
+  m_cv.notify_all();
+  for (auto& t : m_vThreads) {
+    t.join();
+  }
+}
+
+void Verifier::push(const Hit& hit) {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_queue.push_back(hit);
+  }
+
+  m_cv.notify_one();
+}
+
+size_t Verifier::depth() const {
+  lock_guard<mutex> lock(m_mutex);
+  return m_queue.size();
+}
+
+unsigned long long Verifier::verified() const {
+  return m_verified;
+}
+
+unsigned long long Verifier::repeats() const {
+  return m_repeats;
+}
+
+map<size_t, unsigned long long> Verifier::mismatches() const {
+  lock_guard<mutex> lock(m_mutex);
+  return m_mismatches;
+}
+
+void Verifier::loop() {
+  unique_lock<mutex> lock(m_mutex);
+
+  while (true) {
+    m_cv.wait(lock, [&] { return m_quit || !m_queue.empty(); });
+    if (m_queue.empty()) {
+      break;
+    }
+
+    const Hit hit = m_queue.front();
+    m_queue.pop_front();
+
+    const string key = string(reinterpret_cast<const char*>(&hit.jobIndex), sizeof(hit.jobIndex)) + string(1, static_cast<char>(hit.score)) + string(reinterpret_cast<const char*>(hit.r.salt), 32) + string(reinterpret_cast<const char*>(hit.r.hash), 20);
+    if (m_verdicts.count(key)) {
+      ++m_repeats;
+      continue;
+    }
+
+    lock.unlock();
+    const job& j = m_vJobs[hit.jobIndex];
+    const bool bValid = check(j.init, &j.m, m_pattern, m_weights, m_constraint, m_guard, hit.score, hit.r.salt, hit.r.hash);
+    lock.lock();
+
+    // Another thread may have checked the same result meanwhile, pass it on once
+    if (!m_verdicts.emplace(key, bValid).second) {
+      ++m_repeats;
+      continue;
+    }
+
+    if (bValid) {
+      ++m_verified;
+    } else {
+      ++m_mismatches[hit.deviceIndex];
+    }
+
+    lock.unlock();
+    (bValid ? m_onVerified : m_onMismatch)(hit);
+    lock.lock();
+  }
+}
+
+bool Verifier::check(const ethhash& init, const mode* const pMode, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard, const cl_uchar score, const cl_uchar salt[32], const cl_uchar hash[20]) {
+  cl_uchar expected[20];
+  Reference::address(init.b + 1, salt, init.b + 53, expected, guard);
+  return memcmp(expected, hash, 20) == 0 && (pMode == NULL || Reference::score(*pMode, hash, pattern, weights, constraint) == score);
+}
+
+size_t Verifier::verifyFile(const string& fileName, const ethhash& init, const mode* const pMode, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard, vector<string>& vFailed) {
+  ifstream ifs(fileName);
+  if (!ifs.is_open()) {
+    throw runtime_error("failed to open results file " + fileName);
+  }
+
+  vector<string> vLines;
+  for (string line; getline(ifs, line);) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    if (!line.empty()) {
+      vLines.push_back(line);
+    }
+  }
+
+  // Lines are handed out one at a time, the cost per line is two Keccak permutations, three with a guard
+  vector<char> vLineFailed(vLines.size(), 0);
+  atomic<size_t> next(0);
+  const auto worker = [&] {
+    for (size_t i = next++; i < vLines.size(); i = next++) {
+      try {
+        istringstream iss(vLines[i]);
+        string strScore, strSalt, strHash;
+        getline(iss, strScore, ',');
+        getline(iss, strSalt, ',');
+        getline(iss, strHash, ',');
+
+        const string salt = parseHexadecimalBytes(strSalt);
+        const string hash = parseHexadecimalBytes(strHash);
+        if (salt.size() != 32 || hash.size() != 20) {
+          throw runtime_error("bad length");
+        }
+
+        const int score = stoi(strScore);
+        vLineFailed[i] = !check(init, pMode, pattern, weights, constraint, guard, static_cast<cl_uchar>(score), reinterpret_cast<const cl_uchar*>(salt.data()), reinterpret_cast<const cl_uchar*>(hash.data()));
+      } catch (exception&) {
+        vLineFailed[i] = 1;
+      }
+    }
+  };
+
+  vector<thread> vThreads;
+  for (unsigned int i = 0; i < max(thread::hardware_concurrency(), 1u); ++i) {
+    vThreads.emplace_back(worker);
+  }
+
+  for (auto& t : vThreads) {
+    t.join();
+  }
+
+  for (size_t i = 0; i < vLines.size(); ++i) {
+    if (vLineFailed[i]) {
+      vFailed.push_back(vLines[i]);
+    }
+  }
+
+  return vLines.size();
+}
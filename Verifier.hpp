@@ -0,0 +1,85 @@
+#ifndef HPP_VERIFIER
+#define HPP_VERIFIER
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Constraint.hpp"
+#include "Guard.hpp"
+#include "Pattern.hpp"
+#include "Weights.hpp"
+#include "types.hpp"
+
+using namespace std;
+
+// A result as reported by a device
+struct Hit {
+  size_t deviceIndex;
+  size_t jobIndex;  // Position of the job in the run, 0 unless several jobs share the devices
+  cl_ulong jobId;
+  cl_uchar score;
+  result r;
+};
+
+/* Re-derives every result reported by a device on the host before it is passed
+ * on, so a miscomputing device can't put a salt in the output file that doesn't
+ * produce the address next to it. A result passes if its salt yields its address,
+ * through the factory's guard if there is one, and the address scores what the
+ * device claimed, both under the job it was reported for.
+ *
+ * Checks run on a small thread pool, push() only queues. The same slot is
+ * reported again every round, verdicts are cached so each distinct result is
+ * derived, counted and passed on once. Both callbacks run on the pool threads.
+ */
+class Verifier {
+ public:
+  // Only the init and mode of the jobs are used
+  Verifier(const vector<job>& vJobs, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard, const unsigned int threads, function<void(const Hit&)> onVerified, function<void(const Hit&)> onMismatch);
+  ~Verifier();
+
+  void push(const Hit& hit);
+
+  size_t depth() const;
+  unsigned long long verified() const;
+  unsigned long long repeats() const;
+  map<size_t, unsigned long long> mismatches() const;
+
+  // Checks every line of a file written by ResultWriter on all cores, scores are only checked if a mode
+  // is given. Lines that fail are added to vFailed, returns the number of lines checked.
+  static size_t verifyFile(const string& fileName, const ethhash& init, const mode* const pMode, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard, vector<string>& vFailed);
+
+ private:
+  void loop();
+
+  static bool check(const ethhash& init, const mode* const pMode, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard, const cl_uchar score, const cl_uchar salt[32], const cl_uchar hash[20]);
+
+ private:
+  const vector<job> m_vJobs;
+  const Pattern m_pattern;
+  const Weights m_weights;
+  const Constraint m_constraint;
+  const Guard m_guard;
+  const function<void(const Hit&)> m_onVerified;
+  const function<void(const Hit&)> m_onMismatch;
+
+  mutable mutex m_mutex;
+  condition_variable m_cv;
+  deque<Hit> m_queue;
+  map<string, bool> m_verdicts;
+  map<size_t, unsigned long long> m_mismatches;
+  bool m_quit;
+
+  atomic<unsigned long long> m_verified;
+  atomic<unsigned long long> m_repeats;
+
+  vector<thread> m_vThreads;
+};
+
+#endif /* HPP_VERIFIER */
@@ -0,0 +1,249 @@
+#include "Weights.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+cl_uchar nibble(const cl_uchar hash[20], const int i) {
+  return (i & 1) ? (hash[i >> 1] & 0x0f) : (hash[i >> 1] >> 4);
+}
+
+// Whole number from s[i], i is moved past it
+unsigned int parseNumber(const string& s, size_t& i, const string& strTerm) {
+  size_t end = i;
+  while (end < s.size() && isdigit(static_cast<unsigned char>(s[end]))) {
+    ++end;
+  }
+
+  if (end == i || end - i > 3) {
+    throw runtime_error("bad number in weight " + strTerm);
+  }
+
+  const unsigned int n = stoul(s.substr(i, end - i));
+  i = end;
+  return n;
+}
+
+cl_uchar saturate(const unsigned int x) {
+  return static_cast<cl_uchar>(min<unsigned int>(x, ERADICATE2_MAX_SCORE));
+}
+}  // namespace
+
+Weights::Weights() : m_runLeading(Pattern::None), m_runTrailing(Pattern::None), m_bonusLeading(0), m_bonusTrailing(0) {
+  memset(m_table, 0, sizeof(m_table));
+}
+
+Weights Weights::parse(const string& strWeights) {
+  Weights w;
+  w.m_str = strWeights;
+  istringstream iss(strWeights);
+  for (string strTerm; getline(iss, strTerm, ',');) {
+    w.add(strTerm);
+  }
+
+  w.validate();
+  return w;
+}
+
+Weights Weights::read(const string& fileName) {
+  ifstream ifs(fileName);
+  if (!ifs.is_open()) {
+    throw runtime_error("failed to open weights file " + fileName);
+  }
+
+  Weights w;
+  w.m_str = fileName;
+  size_t row = 0;
+  for (string line; getline(ifs, line);) {
+    line = line.substr(0, line.find('#'));
+    istringstream iss(line);
+    vector<string> vTokens;
+    for (string token; iss >> token;) {
+      vTokens.push_back(token);
+    }
+
+    // A row of the table, or terms
+    const bool bRow = vTokens.size() == 16 && all_of(vTokens.begin(), vTokens.end(), [](const string& s) { return s.find_first_not_of("0123456789") == string::npos; });
+    if (bRow) {
+      if (row == 40) {
+        throw runtime_error("more than 40 rows in weights file " + fileName);
+      }
+
+      for (size_t k = 0; k < 16; ++k) {
+        size_t i = 0;
+        w.m_table[row][k] = saturate(w.m_table[row][k] + parseNumber(vTokens[k], i, vTokens[k]));
+      }
+      ++row;
+      continue;
+    }
+
+    for (auto& token : vTokens) {
+      istringstream issTerms(token);
+      for (string strTerm; getline(issTerms, strTerm, ',');) {
+        if (!strTerm.empty()) {
+          w.add(strTerm);
+        }
+      }
+    }
+  }
+
+  w.validate();
+  return w;
+}
+
+void Weights::add(const string& strTerm) {
+  const size_t eq = strTerm.find('=');
+  if (eq == string::npos || eq == 0) {
+    throw runtime_error("weight " + strTerm + " must be <class>[@n[-m]]=<weight>");
+  }
+
+  const string s = strTerm.substr(0, eq);
+  size_t i = s[0] == '^' ? 1 : 0;
+  const bool bLeading = i == 1;
+  Pattern::Class c;
+  try {
+    c = Pattern::parseClass(s, i);
+  } catch (runtime_error& e) {
+    throw runtime_error("bad weight " + strTerm + " - " + e.what());
+  }
+
+  const bool bTrailing = i < s.size() && s[i] == '$';
+  i += bTrailing ? 1 : 0;
+
+  int from = 0;
+  int to = 39;
+  if (!bLeading && !bTrailing && i < s.size() && s[i] == '@') {
+    ++i;
+    from = to = parseNumber(s, i, strTerm);
+    if (i < s.size() && s[i] == '-') {
+      ++i;
+      to = parseNumber(s, i, strTerm);
+    }
+
+    if (from > to || to > 39) {
+      throw runtime_error("positions of weight " + strTerm + " must be n or n-m within 0-39");
+    }
+  }
+
+  size_t j = eq + 1;
+  const unsigned int weight = parseNumber(strTerm, j, strTerm);
+  if (i != s.size() || j != strTerm.size() || (bLeading && bTrailing)) {
+    throw runtime_error("bad weight " + strTerm);
+  }
+
+  if (bLeading || bTrailing) {
+    if (c == Pattern::Any) {
+      throw runtime_error("a run of . in weight " + strTerm + " would always be the whole address");
+    }
+
+    if ((bLeading ? m_runLeading : m_runTrailing) != Pattern::None) {
+      throw runtime_error(string("weights can only have one ") + (bLeading ? "leading" : "trailing") + " run");
+    }
+
+    (bLeading ? m_runLeading : m_runTrailing) = c;
+    (bLeading ? m_bonusLeading : m_bonusTrailing) = saturate(weight);
+    return;
+  }
+
+  for (int p = from; p <= to; ++p) {
+    for (int k = 0; k < 16; ++k) {
+      if ((c >> k) & 1) {
+        m_table[p][k] = saturate(m_table[p][k] + weight);
+      }
+    }
+  }
+}
+
+void Weights::validate() const {
+  const bool bTable = any_of(&m_table[0][0], &m_table[0][0] + 40 * 16, [](const cl_uchar x) { return x != 0; });
+  if (!bTable && m_bonusLeading == 0 && m_bonusTrailing == 0) {
+    throw runtime_error("weights " + m_str + " don't score anything");
+  }
+}
+
+bool Weights::enabled() const {
+  return !m_str.empty();
+}
+
+string Weights::str() const {
+  return m_str;
+}
+
+int Weights::score(const cl_uchar hash[20]) const {
+  const auto member = [&](const Pattern::Class c, const int i) { return (c >> nibble(hash, i)) & 1; };
+  int score = 0;
+  for (int i = 0; i < 40; ++i) {
+    score += m_table[i][nibble(hash, i)];
+  }
+
+  if (m_runLeading != Pattern::None) {
+    int n = 0;
+    while (n < 40 && member(m_runLeading, n)) {
+      ++n;
+    }
+    score += n * m_bonusLeading;
+  }
+
+  if (m_runTrailing != Pattern::None) {
+    int n = 0;
+    while (n < 40 && member(m_runTrailing, 39 - n)) {
+      ++n;
+    }
+    score += n * m_bonusTrailing;
+  }
+
+  return min(score, ERADICATE2_MAX_SCORE);
+}
+
+string Weights::source() const {
+  if (!enabled()) {
+    return "";
+  }
+
+  ostringstream oss;
+  oss << "#define ERADICATE2_WEIGHTS" << endl;
+  oss << "uint eradicate2_leading_zeros(const ulong x0, const ulong x1, const ulong x2);" << endl;
+  oss << "uint eradicate2_trailing_zeros(const ulong x0, const ulong x1, const ulong x2);" << endl;
+  oss << "ulong eradicate2_range_nibbles(const ulong x, const ulong lo, const ulong hi);" << endl;
+  oss << endl;
+  oss << "// " << m_str << endl;
+  oss << "__constant uchar eradicate2_weights[40][16] = {" << endl;
+  for (int i = 0; i < 40; ++i) {
+    oss << "\t{";
+    for (int k = 0; k < 16; ++k) {
+      oss << (k == 0 ? "" : ", ") << static_cast<int>(m_table[i][k]);
+    }
+    oss << "}," << endl;
+  }
+  oss << "};" << endl;
+  oss << endl;
+
+  // Positions without any weight cost nothing
+  oss << "int eradicate2_score_weights(const ulong a0, const ulong a1, const ulong a2) {" << endl;
+  oss << "\tint score = 0;" << endl;
+  for (int i = 0; i < 40; ++i) {
+    if (any_of(m_table[i], m_table[i] + 16, [](const cl_uchar x) { return x != 0; })) {
+      const int lane = i < 8 ? 0 : (i + 8) >> 4;
+      const int shift = 60 - 4 * (i < 8 ? i : (i + 8) & 15);
+      oss << "\tscore += eradicate2_weights[" << i << "][(a" << lane << " >> " << shift << ") & 0xF];" << endl;
+    }
+  }
+
+  if (m_runLeading != Pattern::None) {
+    oss << "\tscore += " << static_cast<int>(m_bonusLeading) << " * eradicate2_leading_zeros(" << Pattern::mismatchSource(m_runLeading, "a0") << ", " << Pattern::mismatchSource(m_runLeading, "a1") << ", " << Pattern::mismatchSource(m_runLeading, "a2") << ");" << endl;
+  }
+
+  if (m_runTrailing != Pattern::None) {
+    oss << "\tscore += " << static_cast<int>(m_bonusTrailing) << " * eradicate2_trailing_zeros(" << Pattern::mismatchSource(m_runTrailing, "a0") << ", " << Pattern::mismatchSource(m_runTrailing, "a1") << ", " << Pattern::mismatchSource(m_runTrailing, "a2") << ");" << endl;
+  }
+
+  oss << "\treturn min(score, ERADICATE2_MAX_SCORE);" << endl;
+  oss << "}" << endl;
+
+  return oss.str();
+}
@@ -0,0 +1,62 @@
+#ifndef HPP_WEIGHTS
+#define HPP_WEIGHTS
+
+#include <string>
+
+#include "Pattern.hpp"
+#include "types.hpp"
+
+using namespace std;
+
+/* Scores summed from a table instead of a hand-written eradicate2_score_*,
+ * for blends of the built-in notions of a nice address. Every character adds
+ * the weight of its position and value, and the leading and trailing runs of
+ * a class can add a bonus per character on top. Terms are separated by commas:
+ *
+ *   0=1,^0=2,f$=2           every 0 counts 1, 3 in the leading run, trailing
+ *                           fs count 2
+ *   [a-f]@0-3=2,0@36-39=1   letters among the first four characters count 2,
+ *                           zeros among the last four 1
+ *
+ * A term is a hex character, . or a class as in patterns, optionally limited
+ * to positions with @n or @n-m (0 is the first character), followed by =weight.
+ * Weights of terms that overlap add up. ^class=weight is the bonus of the
+ * leading run of class and class$=weight the one of the trailing run, there
+ * can be one of each. The score saturates at ERADICATE2_MAX_SCORE.
+ *
+ * read() takes the same terms from a file, one or more per line, where a line
+ * of 16 numbers instead sets the weights of characters 0 to f of the next
+ * position, so a whole 40x16 table can be given as 40 such lines.
+ *
+ * source() emits the table as __constant memory and one lookup per position
+ * that has any weight, score() is the host's equivalent.
+ */
+class Weights {
+ public:
+  Weights();
+
+  static Weights parse(const string& strWeights);
+  static Weights read(const string& fileName);
+
+  bool enabled() const;
+  string str() const;
+
+  int score(const cl_uchar hash[20]) const;
+
+  // OpenCL source defining eradicate2_score_weights, empty when disabled
+  string source() const;
+
+ private:
+  void add(const string& strTerm);
+  void validate() const;
+
+ private:
+  string m_str;
+  cl_uchar m_table[40][16];
+  Pattern::Class m_runLeading;  // None if there's no leading run bonus
+  Pattern::Class m_runTrailing;
+  cl_uchar m_bonusLeading;
+  cl_uchar m_bonusTrailing;
+};
+
+#endif /* HPP_WEIGHTS */
@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <magic_enum.hpp>
+
+#include "ArgParser.hpp"
+#include "Dispatcher.hpp"
+#include "Guard.hpp"
+#include "ModeFactory.hpp"
+#include "Pattern.hpp"
+#include "SaltTemplate.hpp"
+#include "Speed.hpp"
+#include "Weights.hpp"
+#include "clutil.hpp"
+#include "sha3.hpp"
+
+using namespace std;
+
+/* Repeatable benchmarks with JSON output, meant to be diffed between kernel
+ * changes. Every measurement is repeated and reported as min/median/max.
+ *
+ * usage: ./ERADICATE2-bench.x64 [-o file] [-r repeat] [-S size] [-w work] [-s skip] [--seed n] [--host-only]
+ */
+
+struct Measurement {
+  vector<double> vRuns;
+
+  void add(const double d) {
+    vRuns.push_back(d);
+  }
+
+  string json(const string& unit) {
+    sort(vRuns.begin(), vRuns.end());
+    ostringstream oss;
+    oss << "\"" << unit << "_min\":" << vRuns.front() << ",\"" << unit << "_median\":" << vRuns[vRuns.size() / 2] << ",\"" << unit << "_max\":" << vRuns.back();
+    return oss.str();
+  }
+
+  double median() {
+    sort(vRuns.begin(), vRuns.end());
+    return vRuns[vRuns.size() / 2];
+  }
+};
+
+static double secondsSince(const chrono::steady_clock::time_point& t) {
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t).count() / 1e9;
+}
+
+// Host Keccak-f[1600] permutations per second, single thread
+static double benchmarkKeccak(const unsigned int iterations) {
+  ethhash h = {{0}};
+  h.b[0] = 0xff;
+
+  const auto timeStart = chrono::steady_clock::now();
+  for (unsigned int i = 0; i < iterations; ++i) {
+    sha3_keccakf(h.q);
+  }
+  const double seconds = secondsSince(timeStart);
+
+  // Keep the result alive so the loop isn't optimized away
+  volatile cl_ulong sink = h.q[0];
+  (void)sink;
+
+  return iterations / seconds;
+}
+
+// Every thread plays one device and hammers Speed::update() like its dispatch callback would, while
+// another thread takes snapshots the way printing and the metrics endpoint do.
+static double benchmarkSpeedUpdate(const unsigned int devices, const unsigned int iterations) {
+  Speed speed(UINT_MAX);
+  for (unsigned int i = 0; i < devices; ++i) {
+    speed.addDevice(i);
+  }
+
+  atomic<bool> bQuit(false);
+  thread reader([&] {
+    while (!bQuit) {
+      speed.snapshot();
+      this_thread::yield();
+    }
+  });
+
+  vector<double> vNs(devices);
+  vector<thread> vThreads;
+  for (unsigned int i = 0; i < devices; ++i) {
+    vThreads.emplace_back([&, i] {
+      const auto timeStart = chrono::steady_clock::now();
+      for (unsigned int j = 0; j < iterations; ++j) {
+        speed.update(16777216, i);
+      }
+      vNs[i] = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timeStart).count());
+    });
+  }
+
+  for (auto& t : vThreads) {
+    t.join();
+  }
+
+  bQuit = true;
+  reader.join();
+
+  return *max_element(vNs.begin(), vNs.end()) / iterations;
+}
+
+// One representative parameter set for every ModeFunction
+static vector<mode> benchmarkModes() {
+  return {
+      ModeFactory::benchmark(),
+      ModeFactory::zerobytes(),
+      ModeFactory::matching("deadbeef"),
+      ModeFactory::leading('0'),
+      ModeFactory::range(0, 0),
+      ModeFactory::mirror(),
+      ModeFactory::doubles(),
+      ModeFactory::leadingRange(0, 3),
+      ModeFactory::trailing('f'),
+      ModeFactory::all(ERADICATE2_MAX_SCORE),
+      ModeFactory::allLeading(),
+      ModeFactory::allLeadingTrailing(""),
+      ModeFactory::matchLeading("deadbeef"),
+      ModeFactory::pattern(),
+      ModeFactory::weights(),
+  };
+}
+
+// Compiled into the program for ModeFactory::pattern(), classes and open runs at both ends
+static const string g_strBenchmarkPattern = "^dead[0-9]{4}0*.*[a-f]*beef$";
+
+// Compiled into the program for ModeFactory::weights(), a lookup at every position and both run bonuses
+static const string g_strBenchmarkWeights = "0=1,[a-f]@0-7=2,^0=2,f$=2";
+
+// Guarded pipeline, every profile costs one more Keccak-f whatever its prefix
+static const string g_strBenchmarkGuard = "createx:0x000000000000000000000000000000000000dead:1";
+
+// Hashes per second of repeat launches of a kernel with all arguments but the round set, after a warm-up
+// launch since the first one may include lazy compilation
+static Measurement benchmarkLaunches(cl_command_queue& clQueue, cl_kernel& clKernel, const unsigned int repeat, const size_t size, size_t& worksizeLocal, cl_ulong& round) {
+  CLMemory<cl_ulong>::setKernelArg(clKernel, 4, ++round);
+  runKernel(clQueue, clKernel, size, worksizeLocal);
+
+  Measurement m;
+  for (unsigned int j = 0; j < repeat; ++j) {
+    CLMemory<cl_ulong>::setKernelArg(clKernel, 4, ++round);
+    const auto timeStart = chrono::steady_clock::now();
+    runKernel(clQueue, clKernel, size, worksizeLocal);
+    m.add(size / secondsSince(timeStart));
+  }
+
+  return m;
+}
+
+// Full eradicate2_iterate throughput for every mode on one device with one Keccak variant. The
+// scoring overhead is the time per hash relative to the Benchmark mode, which does no scoring at all.
+// The Benchmark mode is also run through the CreateX guarded pipeline, the guard's own Keccak-f ahead
+// of CREATE3's two.
+static string benchmarkDevice(cl_device_id clDeviceId, const size_t index, const KeccakVariant variant, const string& strInitHash, const unsigned int repeat, const size_t size, size_t worksizeLocal) {
+  ostringstream oss;
+  oss << "{\"index\":" << index << ",\"name\":\"" << clGetWrapperString(clGetDeviceInfo, clDeviceId, CL_DEVICE_NAME) << "\"";
+  oss << ",\"keccak\":\"" << keccakVariantName(variant) << "\"";
+
+  cl_int errorCode;
+  cl_context clContext = clCreateContext(NULL, 1, &clDeviceId, NULL, NULL, &errorCode);
+  if (clContext == NULL) {
+    oss << ",\"error\":\"failed to create context (" << errorCode << ")\"}";
+    return oss.str();
+  }
+
+  const string strBuildOptions = "-D ERADICATE2_MAX_SCORE=" + lexical_cast::write(ERADICATE2_MAX_SCORE) + " -D ERADICATE2_INITHASH=" + strInitHash + keccakBuildOption(variant);
+  const auto timeBuild = chrono::steady_clock::now();
+  cl_program clProgram = buildProgram(clContext, {clDeviceId}, strBuildOptions, Pattern::parse(g_strBenchmarkPattern).source() + Weights::parse(g_strBenchmarkWeights).source());
+  const double secondsBuild = secondsSince(timeBuild);
+  if (clProgram == NULL) {
+    oss << ",\"error\":\"failed to build program\"}";
+    clReleaseContext(clContext);
+    return oss.str();
+  }
+
+  // Startup cost of compiling from source against loading the embedded SPIR-V, null without it
+  const auto timeSpirv = chrono::steady_clock::now();
+  cl_program clProgramSpirv = buildProgramSpirv(clContext, {clDeviceId}, variant);
+  oss << ",\"build_seconds\":{\"source\":" << secondsBuild << ",\"spirv\":";
+  if (clProgramSpirv == NULL) {
+    oss << "null}";
+  } else {
+    oss << secondsSince(timeSpirv) << "}";
+    clReleaseProgram(clProgramSpirv);
+  }
+
+  cl_command_queue clQueue = createQueue(clContext, clDeviceId);
+  cl_kernel clKernel = clCreateKernel(clProgram, "eradicate2_iterate", NULL);
+
+  // Private memory is where spills show up, kept next to the numbers so a regression is visible in the diff
+  cl_ulong privateMem = 0;
+  size_t workGroupSize = 0;
+  clGetKernelWorkGroupInfo(clKernel, clDeviceId, CL_KERNEL_PRIVATE_MEM_SIZE, sizeof(privateMem), &privateMem, NULL);
+  clGetKernelWorkGroupInfo(clKernel, clDeviceId, CL_KERNEL_WORK_GROUP_SIZE, sizeof(workGroupSize), &workGroupSize, NULL);
+  oss << ",\"private_mem_bytes\":" << privateMem << ",\"work_group_size\":" << workGroupSize;
+
+  {
+    CLMemory<result> memResult(clContext, clQueue, CL_MEM_READ_WRITE, ERADICATE2_MAX_SCORE + 1);
+    CLMemory<mode> memMode(clContext, clQueue, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, 1);
+
+    // Nothing scores above the maximum, so no result writes skew the numbers
+    const cl_uchar scoreMax = ERADICATE2_MAX_SCORE;
+    const cl_uint deviceId = SaltTemplate::deviceId(0, index);
+    memResult.setKernelArg(clKernel, 0);
+    memMode.setKernelArg(clKernel, 1);
+    CLMemory<cl_uchar>::setKernelArg(clKernel, 2, scoreMax);
+    CLMemory<cl_uint>::setKernelArg(clKernel, 3, deviceId);
+
+    double secondsPerHashBenchmark = 0.0;
+    Measurement mBenchmark;
+    cl_ulong round = 0;
+
+    oss << ",\"modes\":[";
+    const auto vModes = benchmarkModes();
+    for (size_t i = 0; i < vModes.size(); ++i) {
+      *memMode = vModes[i];
+      memMode.write(true);
+      for (size_t j = 0; j < ERADICATE2_MAX_SCORE + 1; ++j) {
+        memResult[j].found = 0;
+      }
+      memResult.write(true);
+
+      Measurement m = benchmarkLaunches(clQueue, clKernel, repeat, size, worksizeLocal, round);
+      const double secondsPerHash = 1.0 / m.median();
+      if (vModes[i].function == ModeFunction::Benchmark) {
+        secondsPerHashBenchmark = secondsPerHash;
+        mBenchmark = m;
+      }
+
+      oss << (i == 0 ? "" : ",") << "{\"mode\":\"" << magic_enum::enum_name(vModes[i].function) << "\"," << m.json("hashes_per_second");
+      oss << ",\"scoring_ns_per_hash\":" << (secondsPerHash - secondsPerHashBenchmark) * 1e9 << "}";
+    }
+    oss << "]";
+
+    oss << ",\"pipelines\":[{\"pipeline\":\"create3\"," << mBenchmark.json("hashes_per_second") << "}";
+    cl_program clProgramGuarded = buildProgram(clContext, {clDeviceId}, strBuildOptions, Pattern::parse(g_strBenchmarkPattern).source() + Weights::parse(g_strBenchmarkWeights).source() + Guard::parse(g_strBenchmarkGuard).source());
+    cl_kernel clKernelGuarded = clProgramGuarded == NULL ? NULL : clCreateKernel(clProgramGuarded, "eradicate2_iterate", NULL);
+    if (clKernelGuarded == NULL) {
+      oss << ",{\"pipeline\":\"createx_guarded\",\"error\":\"failed to build program\"}";
+    } else {
+      *memMode = ModeFactory::benchmark();
+      memMode.write(true);
+      memResult.setKernelArg(clKernelGuarded, 0);
+      memMode.setKernelArg(clKernelGuarded, 1);
+      CLMemory<cl_uchar>::setKernelArg(clKernelGuarded, 2, scoreMax);
+      CLMemory<cl_uint>::setKernelArg(clKernelGuarded, 3, deviceId);
+
+      Measurement m = benchmarkLaunches(clQueue, clKernelGuarded, repeat, size, worksizeLocal, round);
+      oss << ",{\"pipeline\":\"createx_guarded\",\"guard\":\"" << g_strBenchmarkGuard << "\"," << m.json("hashes_per_second");
+      oss << ",\"guard_ns_per_hash\":" << (1.0 / m.median() - secondsPerHashBenchmark) * 1e9 << "}";
+      clReleaseKernel(clKernelGuarded);
+    }
+    oss << "]}";
+
+    if (clProgramGuarded != NULL) {
+      clReleaseProgram(clProgramGuarded);
+    }
+  }
+
+  clReleaseKernel(clKernel);
+  clReleaseCommandQueue(clQueue);
+  clReleaseProgram(clProgram);
+  clReleaseContext(clContext);
+  return oss.str();
+}
+
+int main(int argc, char** argv) {
+  try {
+    string fileName;
+    unsigned int repeat = 5;
+    size_t size = 1048576;
+    size_t worksizeLocal = 128;
+    unsigned int devices = 8;
+    unsigned long long seed = 1;
+    bool bHostOnly = false;
+    vector<size_t> vDeviceSkipIndex;
+
+    ArgParser argp(argc, argv);
+    argp.addSwitch("o", "output", fileName);
+    argp.addSwitch("r", "repeat", repeat);
+    argp.addSwitch("S", "size", size);
+    argp.addSwitch("w", "work", worksizeLocal);
+    argp.addSwitch("d", "devices", devices);
+    argp.addSwitch("seed", "seed", seed);
+    argp.addSwitch("ho", "host-only", bHostOnly);
+    argp.addMultiSwitch('s', "skip", vDeviceSkipIndex);
+
+    if (!argp.parse() || repeat == 0 || size == 0 || devices == 0) {
+      cout << "usage: ./ERADICATE2-bench.x64 [-o file] [-r repeat] [-S size] [-w work] [-d devices] [-s skip] [--seed n] [--host-only]" << endl;
+      return 1;
+    }
+
+    ostringstream oss;
+    oss << "{\"config\":{\"repeat\":" << repeat << ",\"size\":" << size << ",\"work\":" << worksizeLocal << ",\"seed\":" << seed << "}";
+
+    // Host side
+    Measurement mKeccak, mSpeed;
+    for (unsigned int i = 0; i < repeat; ++i) {
+      mKeccak.add(benchmarkKeccak(1 << 20));
+      mSpeed.add(benchmarkSpeedUpdate(devices, 100000));
+    }
+
+    oss << ",\"host\":[";
+    oss << "{\"benchmark\":\"sha3_keccakf\"," << mKeccak.json("permutations_per_second") << "}";
+    oss << ",{\"benchmark\":\"speed_update\",\"devices\":" << devices << "," << mSpeed.json("ns_per_op") << "}";
+    oss << "]";
+
+    // Every OpenCL device, CPU devices included
+    oss << ",\"devices\":[";
+    if (!bHostOnly) {
+      const string c3Addr = "00000000000029398fcE86f09FF8453c8D0Cd60D";
+      const string c3ProxyHash = "21c35dbe1b344a2488cf3321d6ce542f8e9f305544ff09e4993a62319a497c1f";
+      const string strInitHash = makePreprocessorInitHashExpression(makeInitHash(hexStringToConstChar(c3Addr), string(20, '\0'), hexStringToConstChar(c3ProxyHash), seed));
+
+      const vector<cl_device_id> vDevices = getAllDevices(CL_DEVICE_TYPE_ALL);
+      bool bFirst = true;
+      for (size_t i = 0; i < vDevices.size(); ++i) {
+        if (find(vDeviceSkipIndex.begin(), vDeviceSkipIndex.end(), i) != vDeviceSkipIndex.end()) {
+          continue;
+        }
+
+        for (auto variant : {KeccakVariant::Lanes64, KeccakVariant::Interleaved32}) {
+          cerr << "Benchmarking device " << i << " with " << keccakVariantName(variant) << "-bit Keccak..." << endl;
+          oss << (bFirst ? "" : ",") << benchmarkDevice(vDevices[i], i, variant, strInitHash, repeat, size, worksizeLocal);
+          bFirst = false;
+        }
+      }
+    }
+    oss << "]}";
+
+    if (fileName.empty()) {
+      cout << oss.str() << endl;
+    } else {
+      ofstream(fileName) << oss.str() << endl;
+    }
+
+    return 0;
+  } catch (runtime_error& e) {
+    cout << "runtime_error - " << e.what() << endl;
+  }
+
+  return 1;
+}
@@ -0,0 +1,520 @@
+#include "clmock.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+struct _cl_platform_id {};
+
+struct _cl_device_id {
+  size_t index;
+};
+
+struct _cl_context {};
+
+struct _cl_program {};
+
+struct _cl_kernel {
+  string name;
+  map<cl_uint, vector<char>> args;
+};
+
+struct _cl_mem {
+  vector<char> data;
+};
+
+struct _cl_event {
+  _cl_event(cl_command_queue clQueue, const cl_int status);
+
+  const cl_command_queue queue;  // NULL for user events
+  mutex m;
+  condition_variable cv;
+  cl_int status;
+  atomic<cl_uint> refs;
+  vector<pair<void(CL_CALLBACK*)(cl_event, cl_int, void*), void*>> vCallbacks;  // Until it completes
+  cl_ulong nsQueued;
+  cl_ulong nsStart;
+  cl_ulong nsEnd;
+};
+
+struct _cl_command_queue {
+  _cl_command_queue(cl_device_id clDeviceId);
+
+  void loop();
+  void post(function<void()> f, cl_event event);
+
+  const cl_device_id device;
+  atomic<cl_uint> refs;
+  mutex m;
+  condition_variable cv;
+  deque<pair<function<void()>, cl_event>> dCommands;
+  size_t pending;  // Posted and not run yet, for clFinish()
+  bool quit;
+  thread t;
+};
+
+namespace {
+_cl_platform_id g_platform;
+vector<_cl_device_id> g_vDevices;
+bool g_bHostUnified = false;
+function<void(const MockLaunch&)> g_launch;
+
+cl_ulong now() {
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+cl_int setError(cl_int* const pError, const cl_int res) {
+  if (pError) {
+    *pError = res;
+  }
+  return res;
+}
+
+// A value of a clGet*Info query, any size for the size query alone
+cl_int info(const void* const pData, const size_t size, const size_t param_value_size, void* const param_value, size_t* const param_value_size_ret) {
+  if (param_value_size_ret) {
+    *param_value_size_ret = size;
+  }
+
+  if (param_value) {
+    if (param_value_size < size) {
+      return CL_INVALID_VALUE;
+    }
+    memcpy(param_value, pData, size);
+  }
+  return CL_SUCCESS;
+}
+
+cl_int infoString(const string& s, const size_t param_value_size, void* const param_value, size_t* const param_value_size_ret) {
+  return info(s.c_str(), s.size() + 1, param_value_size, param_value, param_value_size_ret);
+}
+
+// Zeros of whatever size was asked for, numbers the mock has no opinion on
+cl_int infoZero(const size_t param_value_size, void* const param_value, size_t* const param_value_size_ret) {
+  if (param_value) {
+    memset(param_value, 0, param_value_size);
+  }
+
+  if (param_value_size_ret) {
+    *param_value_size_ret = param_value ? param_value_size : sizeof(cl_ulong);
+  }
+  return CL_SUCCESS;
+}
+
+void release(cl_event event) {
+  if (--event->refs == 0) {
+    delete event;
+  }
+}
+
+void wait(cl_event event) {
+  unique_lock<mutex> lock(event->m);
+  event->cv.wait(lock, [&] { return event->status <= CL_COMPLETE; });
+}
+
+// Completes the event and calls its callbacks on the current thread, then drops the reference the queue held
+void complete(cl_event event) {
+  vector<pair<void(CL_CALLBACK*)(cl_event, cl_int, void*), void*>> vCallbacks;
+  {
+    lock_guard<mutex> lock(event->m);
+    event->nsEnd = now();
+    event->status = CL_COMPLETE;
+    vCallbacks.swap(event->vCallbacks);
+  }
+
+  event->cv.notify_all();
+  for (auto& c : vCallbacks) {
+    c.first(event, CL_COMPLETE, c.second);
+  }
+
+  release(event);
+}
+
+// Posts a command and waits for it if bBlock. The queue holds a reference to the event until the command has run.
+cl_int enqueue(cl_command_queue clQueue, function<void()> f, const cl_bool bBlock, cl_event* const pEvent) {
+  const cl_event event = new _cl_event(clQueue, CL_QUEUED);
+  if (pEvent) {
+    ++event->refs;
+    *pEvent = event;
+  }
+
+  ++event->refs;
+  clQueue->post(f, event);
+  if (bBlock) {
+    wait(event);
+  }
+
+  release(event);
+  return CL_SUCCESS;
+}
+}  // namespace
+
+_cl_event::_cl_event(cl_command_queue clQueue, const cl_int status) : queue(clQueue), status(status), refs(1), nsQueued(now()), nsStart(0), nsEnd(0) {
+}
+
+_cl_command_queue::_cl_command_queue(cl_device_id clDeviceId) : device(clDeviceId), refs(1), pending(0), quit(false) {
+  t = thread(&_cl_command_queue::loop, this);
+}
+
+// Commands and callbacks in the order they were posted, the queue is drained before the thread quits
+void _cl_command_queue::loop() {
+  unique_lock<mutex> lock(m);
+  for (;;) {
+    cv.wait(lock, [&] { return quit || !dCommands.empty(); });
+    if (dCommands.empty()) {
+      break;
+    }
+
+    const auto command = move(dCommands.front());
+    dCommands.pop_front();
+    lock.unlock();
+
+    if (command.second) {
+      lock_guard<mutex> lockEvent(command.second->m);
+      command.second->nsStart = now();
+    }
+
+    command.first();
+    if (command.second) {
+      complete(command.second);
+    }
+
+    lock.lock();
+    --pending;
+    cv.notify_all();
+  }
+}
+
+void _cl_command_queue::post(function<void()> f, cl_event event) {
+  {
+    lock_guard<mutex> lock(m);
+    dCommands.emplace_back(f, event);
+    ++pending;
+  }
+
+  cv.notify_all();
+}
+
+void* MockLaunch::bufferData(const cl_uint i) const {
+  cl_mem clMem;
+  memcpy(&clMem, args.at(i).data(), sizeof(cl_mem));
+  return clMem->data.data();
+}
+
+void mockSetup(const size_t devices, const bool bHostUnified, function<void(const MockLaunch&)> launch) {
+  g_vDevices.resize(devices);
+  for (size_t i = 0; i < devices; ++i) {
+    g_vDevices[i].index = i;
+  }
+
+  g_bHostUnified = bHostUnified;
+  g_launch = launch;
+}
+
+// Platforms and devices
+
+cl_int CL_API_CALL clGetPlatformIDs(cl_uint num_entries, cl_platform_id* platforms, cl_uint* num_platforms) {
+  if (num_platforms) {
+    *num_platforms = 1;
+  }
+
+  if (platforms && num_entries > 0) {
+    platforms[0] = &g_platform;
+  }
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clGetPlatformInfo(cl_platform_id, cl_platform_info, size_t param_value_size, void* param_value, size_t* param_value_size_ret) {
+  return infoString("eradicate2 mock", param_value_size, param_value, param_value_size_ret);
+}
+
+cl_int CL_API_CALL clGetDeviceIDs(cl_platform_id, cl_device_type, cl_uint num_entries, cl_device_id* devices, cl_uint* num_devices) {
+  if (g_vDevices.empty()) {
+    return CL_DEVICE_NOT_FOUND;
+  }
+
+  if (num_devices) {
+    *num_devices = static_cast<cl_uint>(g_vDevices.size());
+  }
+
+  for (cl_uint i = 0; devices && i < num_entries && i < g_vDevices.size(); ++i) {
+    devices[i] = &g_vDevices[i];
+  }
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clGetDeviceInfo(cl_device_id device, cl_device_info param_name, size_t param_value_size, void* param_value, size_t* param_value_size_ret) {
+  switch (param_name) {
+    case CL_DEVICE_NAME:
+      return infoString("Mock device " + to_string(device->index), param_value_size, param_value, param_value_size_ret);
+    case CL_DEVICE_VENDOR:
+    case CL_DEVICE_VERSION:
+    case CL_DRIVER_VERSION:
+      return infoString("eradicate2 mock", param_value_size, param_value, param_value_size_ret);
+#ifdef CL_VERSION_2_1
+    case CL_DEVICE_IL_VERSION:
+      return infoString("", param_value_size, param_value, param_value_size_ret);
+#endif
+    case CL_DEVICE_HOST_UNIFIED_MEMORY: {
+      const cl_bool unified = g_bHostUnified ? CL_TRUE : CL_FALSE;
+      return info(&unified, sizeof(unified), param_value_size, param_value, param_value_size_ret);
+    }
+    case CL_DEVICE_PLATFORM: {
+      const cl_platform_id platform = &g_platform;
+      return info(&platform, sizeof(platform), param_value_size, param_value, param_value_size_ret);
+    }
+    default:
+      return infoZero(param_value_size, param_value, param_value_size_ret);
+  }
+}
+
+cl_context CL_API_CALL clCreateContext(const cl_context_properties*, cl_uint, const cl_device_id*, void(CL_CALLBACK*)(const char*, const void*, size_t, void*), void*, cl_int* errcode_ret) {
+  setError(errcode_ret, CL_SUCCESS);
+  return new _cl_context;
+}
+
+cl_int CL_API_CALL clReleaseContext(cl_context context) {
+  delete context;
+  return CL_SUCCESS;
+}
+
+// Programs and kernels
+
+cl_program CL_API_CALL clCreateProgramWithSource(cl_context, cl_uint, const char**, const size_t*, cl_int* errcode_ret) {
+  setError(errcode_ret, CL_SUCCESS);
+  return new _cl_program;
+}
+
+#ifdef CL_VERSION_2_1
+cl_program CL_API_CALL clCreateProgramWithIL(cl_context, const void*, size_t, cl_int* errcode_ret) {
+  setError(errcode_ret, CL_SUCCESS);
+  return new _cl_program;
+}
+#endif
+
+cl_int CL_API_CALL clBuildProgram(cl_program, cl_uint, const cl_device_id*, const char*, void(CL_CALLBACK*)(cl_program, void*), void*) {
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clGetProgramInfo(cl_program, cl_program_info, size_t param_value_size, void* param_value, size_t* param_value_size_ret) {
+  return infoZero(param_value_size, param_value, param_value_size_ret);
+}
+
+cl_int CL_API_CALL clGetProgramBuildInfo(cl_program, cl_device_id, cl_program_build_info, size_t param_value_size, void* param_value, size_t* param_value_size_ret) {
+  return infoString("", param_value_size, param_value, param_value_size_ret);
+}
+
+cl_int CL_API_CALL clReleaseProgram(cl_program program) {
+  delete program;
+  return CL_SUCCESS;
+}
+
+cl_kernel CL_API_CALL clCreateKernel(cl_program, const char* kernel_name, cl_int* errcode_ret) {
+  setError(errcode_ret, CL_SUCCESS);
+  cl_kernel clKernel = new _cl_kernel;
+  clKernel->name = kernel_name;
+  return clKernel;
+}
+
+cl_int CL_API_CALL clReleaseKernel(cl_kernel kernel) {
+  delete kernel;
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clSetKernelArg(cl_kernel kernel, cl_uint arg_index, size_t arg_size, const void* arg_value) {
+  const char* const p = static_cast<const char*>(arg_value);
+  kernel->args[arg_index].assign(p, p + arg_size);
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clGetKernelWorkGroupInfo(cl_kernel, cl_device_id, cl_kernel_work_group_info, size_t param_value_size, void* param_value, size_t* param_value_size_ret) {
+  return infoZero(param_value_size, param_value, param_value_size_ret);
+}
+
+// Queues and buffers
+
+cl_command_queue CL_API_CALL clCreateCommandQueue(cl_context, cl_device_id device, cl_command_queue_properties, cl_int* errcode_ret) {
+  setError(errcode_ret, CL_SUCCESS);
+  return new _cl_command_queue(device);
+}
+
+#ifdef CL_VERSION_2_0
+cl_command_queue CL_API_CALL clCreateCommandQueueWithProperties(cl_context context, cl_device_id device, const cl_queue_properties*, cl_int* errcode_ret) {
+  return clCreateCommandQueue(context, device, 0, errcode_ret);
+}
+#endif
+
+cl_int CL_API_CALL clRetainCommandQueue(cl_command_queue command_queue) {
+  ++command_queue->refs;
+  return CL_SUCCESS;
+}
+
+// The last reference lets the thread drain the queue and quit. From a callback of the queue itself the thread
+// can't be joined, it's left to finish on its own.
+cl_int CL_API_CALL clReleaseCommandQueue(cl_command_queue command_queue) {
+  if (--command_queue->refs != 0) {
+    return CL_SUCCESS;
+  }
+
+  {
+    lock_guard<mutex> lock(command_queue->m);
+    command_queue->quit = true;
+  }
+
+  command_queue->cv.notify_all();
+  if (this_thread::get_id() == command_queue->t.get_id()) {
+    command_queue->t.detach();
+  } else {
+    command_queue->t.join();
+    delete command_queue;
+  }
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clFlush(cl_command_queue) {
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clFinish(cl_command_queue command_queue) {
+  unique_lock<mutex> lock(command_queue->m);
+  command_queue->cv.wait(lock, [&] { return command_queue->pending == 0; });
+  return CL_SUCCESS;
+}
+
+cl_mem CL_API_CALL clCreateBuffer(cl_context, cl_mem_flags, size_t size, void*, cl_int* errcode_ret) {
+  setError(errcode_ret, CL_SUCCESS);
+  cl_mem clMem = new _cl_mem;
+  clMem->data.resize(size);
+  return clMem;
+}
+
+cl_int CL_API_CALL clReleaseMemObject(cl_mem memobj) {
+  delete memobj;
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clEnqueueReadBuffer(cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_read, size_t offset, size_t size, void* ptr, cl_uint, const cl_event*, cl_event* event) {
+  return enqueue(command_queue, [=] { memcpy(ptr, buffer->data.data() + offset, size); }, blocking_read, event);
+}
+
+cl_int CL_API_CALL clEnqueueWriteBuffer(cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_write, size_t offset, size_t size, const void* ptr, cl_uint, const cl_event*, cl_event* event) {
+  return enqueue(command_queue, [=] { memcpy(buffer->data.data() + offset, ptr, size); }, blocking_write, event);
+}
+
+// Host and device share the buffer's memory, mapping and unmapping only order the commands
+void* CL_API_CALL clEnqueueMapBuffer(cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_map, cl_map_flags, size_t offset, size_t, cl_uint, const cl_event*, cl_event* event, cl_int* errcode_ret) {
+  setError(errcode_ret, enqueue(command_queue, [] {}, blocking_map, event));
+  return buffer->data.data() + offset;
+}
+
+cl_int CL_API_CALL clEnqueueUnmapMemObject(cl_command_queue command_queue, cl_mem, void*, cl_uint, const cl_event*, cl_event* event) {
+  return enqueue(command_queue, [] {}, CL_FALSE, event);
+}
+
+cl_int CL_API_CALL clEnqueueNDRangeKernel(cl_command_queue command_queue, cl_kernel kernel, cl_uint, const size_t* global_work_offset, const size_t* global_work_size, const size_t*, cl_uint, const cl_event*, cl_event* event) {
+  const MockLaunch launch{command_queue->device->index, kernel->name, global_work_offset ? global_work_offset[0] : 0, global_work_size[0], kernel->args};
+  const auto f = [launch] {
+    if (g_launch) {
+      g_launch(launch);
+    }
+  };
+
+  return enqueue(command_queue, f, CL_FALSE, event);
+}
+
+// Events
+
+cl_event CL_API_CALL clCreateUserEvent(cl_context, cl_int* errcode_ret) {
+  setError(errcode_ret, CL_SUCCESS);
+  return new _cl_event(NULL, CL_SUBMITTED);
+}
+
+cl_int CL_API_CALL clSetUserEventStatus(cl_event event, cl_int execution_status) {
+  vector<pair<void(CL_CALLBACK*)(cl_event, cl_int, void*), void*>> vCallbacks;
+  {
+    lock_guard<mutex> lock(event->m);
+    event->status = execution_status;
+    event->nsEnd = now();
+    vCallbacks.swap(event->vCallbacks);
+  }
+
+  event->cv.notify_all();
+  for (auto& c : vCallbacks) {
+    c.first(event, execution_status, c.second);
+  }
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clWaitForEvents(cl_uint num_events, const cl_event* event_list) {
+  for (cl_uint i = 0; i < num_events; ++i) {
+    wait(event_list[i]);
+  }
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clRetainEvent(cl_event event) {
+  ++event->refs;
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clReleaseEvent(cl_event event) {
+  release(event);
+  return CL_SUCCESS;
+}
+
+// A callback on an event that has already completed goes to the back of its queue, calling it right away would
+// recurse when it enqueues the next round and sets its callback in turn
+cl_int CL_API_CALL clSetEventCallback(cl_event event, cl_int, void(CL_CALLBACK* pfn_notify)(cl_event, cl_int, void*), void* user_data) {
+  {
+    lock_guard<mutex> lock(event->m);
+    if (event->status > CL_COMPLETE) {
+      event->vCallbacks.emplace_back(pfn_notify, user_data);
+      return CL_SUCCESS;
+    }
+  }
+
+  if (event->queue == NULL) {
+    pfn_notify(event, event->status, user_data);
+    return CL_SUCCESS;
+  }
+
+  const auto f = [=] {
+    pfn_notify(event, CL_COMPLETE, user_data);
+    release(event);
+  };
+
+  ++event->refs;
+  event->queue->post(f, NULL);
+  return CL_SUCCESS;
+}
+
+cl_int CL_API_CALL clGetEventInfo(cl_event event, cl_event_info param_name, size_t param_value_size, void* param_value, size_t* param_value_size_ret) {
+  if (param_name != CL_EVENT_COMMAND_EXECUTION_STATUS) {
+    return infoZero(param_value_size, param_value, param_value_size_ret);
+  }
+
+  lock_guard<mutex> lock(event->m);
+  return info(&event->status, sizeof(event->status), param_value_size, param_value, param_value_size_ret);
+}
+
+cl_int CL_API_CALL clGetEventProfilingInfo(cl_event event, cl_profiling_info param_name, size_t param_value_size, void* param_value, size_t* param_value_size_ret) {
+  lock_guard<mutex> lock(event->m);
+  cl_ulong ns = 0;
+  switch (param_name) {
+    case CL_PROFILING_COMMAND_QUEUED:
+    case CL_PROFILING_COMMAND_SUBMIT:
+      ns = event->nsQueued;
+      break;
+    case CL_PROFILING_COMMAND_START:
+      ns = event->nsStart;
+      break;
+    default:
+      ns = event->nsEnd;
+      break;
+  }
+
+  return info(&ns, sizeof(ns), param_value_size, param_value, param_value_size_ret);
+}
@@ -0,0 +1,57 @@
+#ifndef HPP_CLMOCK
+#define HPP_CLMOCK
+
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__APPLE__) || defined(__MACOSX)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+using namespace std;
+
+/* An OpenCL platform inside the process, linked instead of the OpenCL library
+ * to run the host side of a search without a device. There's one platform
+ * with the devices given to mockSetup(), programs build from any source and
+ * kernels don't run, every launch calls the function given to mockSetup()
+ * instead, which plays the kernel on the buffers set as its arguments.
+ *
+ * Every command queue has a thread that runs its commands in order, completes
+ * their events and calls their callbacks like a driver's thread would, so the
+ * Dispatcher's callback loop runs on it unchanged. A command completes as soon
+ * as it has run. Profiling times are taken from the host's steady clock.
+ *
+ * Only the calls eradicate2 makes are there. Blocking calls wait for the queue
+ * thread, so they mustn't be made from a callback of the same queue.
+ */
+struct MockLaunch {
+  size_t device;  // Index of the queue's device
+  string kernel;
+  size_t offset;
+  size_t size;
+  map<cl_uint, vector<char>> args;  // As they were set when the launch was enqueued
+
+  template<typename T> T arg(const cl_uint i) const {
+    T t;
+    memcpy(&t, args.at(i).data(), sizeof(T));
+    return t;
+  }
+
+  // Contents of the buffer set as argument i
+  template<typename T> T* buffer(const cl_uint i) const {
+    return static_cast<T*>(bufferData(i));
+  }
+
+  void* bufferData(const cl_uint i) const;
+};
+
+// Must be called before the first OpenCL call. bHostUnified devices report CL_DEVICE_HOST_UNIFIED_MEMORY, so
+// CLMemory maps their buffers instead of copying them.
+void mockSetup(const size_t devices, const bool bHostUnified, function<void(const MockLaunch&)> launch);
+
+#endif /* HPP_CLMOCK */
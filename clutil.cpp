@@ -0,0 +1,228 @@
+#include "clutil.hpp"
+
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "kernels.hpp"
+#include "lexical_cast.hpp"
+#include "sha3.hpp"
+
+vector<cl_device_id> getAllDevices(cl_device_type deviceType) {
+  vector<cl_device_id> vDevices;
+
+  cl_uint platformIdCount = 0;
+  clGetPlatformIDs(0, NULL, &platformIdCount);
+
+  vector<cl_platform_id> platformIds(platformIdCount);
+  clGetPlatformIDs(platformIdCount, platformIds.data(), NULL);
+
+  for (auto it = platformIds.cbegin(); it != platformIds.cend(); ++it) {
+    cl_uint countDevice;
+    clGetDeviceIDs(*it, deviceType, 0, NULL, &countDevice);
+
+    vector<cl_device_id> deviceIds(countDevice);
+    clGetDeviceIDs(*it, deviceType, countDevice, deviceIds.data(), &countDevice);
+
+    copy(deviceIds.begin(), deviceIds.end(), back_inserter(vDevices));
+  }
+
+  return vDevices;
+}
+
+vector<string> getBinaries(cl_program& clProgram) {
+  vector<string> vReturn;
+  auto vSizes = clGetWrapperVector<size_t>(clGetProgramInfo, clProgram, CL_PROGRAM_BINARY_SIZES);
+  if (!vSizes.empty()) {
+    unsigned char** pBuffers = new unsigned char*[vSizes.size()];
+    for (size_t i = 0; i < vSizes.size(); ++i) {
+      pBuffers[i] = new unsigned char[vSizes[i]];
+    }
+
+    clGetProgramInfo(clProgram, CL_PROGRAM_BINARIES, vSizes.size() * sizeof(unsigned char*), pBuffers, NULL);
+    for (size_t i = 0; i < vSizes.size(); ++i) {
+      string strData(reinterpret_cast<char*>(pBuffers[i]), vSizes[i]);
+      vReturn.push_back(strData);
+      delete[] pBuffers[i];
+    }
+
+    delete[] pBuffers;
+  }
+
+  return vReturn;
+}
+
+cl_program buildProgram(cl_context& clContext, const vector<cl_device_id>& vDevices, const string& strBuildOptions, const string& strGeneratedSource) {
+  const char* szKernels[] = {reinterpret_cast<const char*>(g_kernelKeccak.data), strGeneratedSource.c_str(), reinterpret_cast<const char*>(g_kernelEradicate2.data)};
+
+  cl_program clProgram = clCreateProgramWithSource(clContext, sizeof(szKernels) / sizeof(char*), szKernels, NULL, NULL);
+  if (clProgram != NULL && clBuildProgram(clProgram, vDevices.size(), vDevices.data(), strBuildOptions.c_str(), NULL, NULL) != CL_SUCCESS) {
+    clReleaseProgram(clProgram);
+    clProgram = NULL;
+  }
+
+  return clProgram;
+}
+
+cl_program buildProgramSpirv(cl_context& clContext, const vector<cl_device_id>& vDevices, const KeccakVariant variant) {
+#ifdef CL_VERSION_2_1
+  const EmbeddedFile& spirv = variant == KeccakVariant::Interleaved32 ? g_kernelSpirv32 : g_kernelSpirv64;
+  if (spirv.size == 0) {
+    return NULL;
+  }
+
+  // Devices before OpenCL 2.1 fail the query, later ones report an empty list without IL support
+  for (auto& d : vDevices) {
+    size_t len = 0;
+    if (clGetDeviceInfo(d, CL_DEVICE_IL_VERSION, 0, NULL, &len) != CL_SUCCESS || len == 0) {
+      return NULL;
+    }
+
+    string strVersions(len, '\0');
+    clGetDeviceInfo(d, CL_DEVICE_IL_VERSION, len, &strVersions[0], NULL);
+    if (strVersions.find("SPIR-V") == string::npos) {
+      return NULL;
+    }
+  }
+
+  cl_program clProgram = clCreateProgramWithIL(clContext, spirv.data, spirv.size, NULL);
+  if (clProgram != NULL && clBuildProgram(clProgram, vDevices.size(), vDevices.data(), "", NULL, NULL) != CL_SUCCESS) {
+    clReleaseProgram(clProgram);
+    clProgram = NULL;
+  }
+
+  return clProgram;
+#else
+  return NULL;
+#endif
+}
+
+KeccakVariant parseKeccakVariant(const string& s) {
+  if (s == "auto") {
+    return KeccakVariant::Auto;
+  } else if (s == "64") {
+    return KeccakVariant::Lanes64;
+  } else if (s == "32") {
+    return KeccakVariant::Interleaved32;
+  }
+
+  throw runtime_error("keccak variant must be auto, 64 or 32");
+}
+
+string keccakVariantName(const KeccakVariant variant) {
+  switch (variant) {
+    case KeccakVariant::Lanes64:
+      return "64";
+    case KeccakVariant::Interleaved32:
+      return "32";
+    default:
+      return "auto";
+  }
+}
+
+string keccakBuildOption(const KeccakVariant variant) {
+  return variant == KeccakVariant::Interleaved32 ? " -D ERADICATE2_KECCAK32" : "";
+}
+
+cl_command_queue createQueue(cl_context& clContext, cl_device_id& clDeviceId) {
+#ifdef CL_VERSION_2_0
+  const cl_command_queue ret = clCreateCommandQueueWithProperties(clContext, clDeviceId, NULL, NULL);
+#else
+  const cl_command_queue ret = clCreateCommandQueue(clContext, clDeviceId, 0, NULL);
+#endif
+  return ret == NULL ? throw runtime_error("failed to create command queue") : ret;
+}
+
+bool isHostUnified(cl_device_id clDeviceId) {
+  cl_bool unified = CL_FALSE;
+  clGetDeviceInfo(clDeviceId, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unified), &unified, NULL);
+  return unified == CL_TRUE;
+}
+
+string kernelInfo(cl_kernel& clKernel, cl_device_id clDeviceId) {
+  cl_ulong privateMem = 0;
+  cl_ulong localMem = 0;
+  size_t workGroupSize = 0;
+  size_t workGroupMultiple = 0;
+  clGetKernelWorkGroupInfo(clKernel, clDeviceId, CL_KERNEL_PRIVATE_MEM_SIZE, sizeof(privateMem), &privateMem, NULL);
+  clGetKernelWorkGroupInfo(clKernel, clDeviceId, CL_KERNEL_LOCAL_MEM_SIZE, sizeof(localMem), &localMem, NULL);
+  clGetKernelWorkGroupInfo(clKernel, clDeviceId, CL_KERNEL_WORK_GROUP_SIZE, sizeof(workGroupSize), &workGroupSize, NULL);
+  clGetKernelWorkGroupInfo(clKernel, clDeviceId, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(workGroupMultiple), &workGroupMultiple, NULL);
+
+  return lexical_cast::write(privateMem) + " bytes private, " + lexical_cast::write(localMem) + " bytes local, work group up to " + lexical_cast::write(workGroupSize) + " in multiples of " + lexical_cast::write(workGroupMultiple);
+}
+
+void runKernel(cl_command_queue& clQueue, cl_kernel& clKernel, const size_t size, size_t& worksizeLocal) {
+  const size_t offset = 0;
+  cl_int res = clEnqueueNDRangeKernel(clQueue, clKernel, 1, &offset, &size, worksizeLocal == 0 ? NULL : &worksizeLocal, 0, NULL, NULL);
+  if ((res == CL_INVALID_WORK_GROUP_SIZE || res == CL_INVALID_WORK_ITEM_SIZE) && worksizeLocal != 0) {
+    worksizeLocal = 0;
+    res = clEnqueueNDRangeKernel(clQueue, clKernel, 1, &offset, &size, NULL, 0, NULL, NULL);
+  }
+
+  if (res != CL_SUCCESS) {
+    throw runtime_error("kernel queueing failed - " + lexical_cast::write(res));
+  }
+
+  clFinish(clQueue);
+}
+
+string keccakDigest(const string data) {
+  char digest[32];
+  sha3(data.c_str(), data.size(), digest, 32);
+  return string(digest, 32);
+}
+
+const char* hexStringToConstChar(const string& hex) {
+  size_t length = hex.length();
+  char* charArray = new char[length / 2 + 1];
+  for (size_t i = 0; i < length; i += 2) {
+    string byteString = hex.substr(i, 2);
+    char byte = (char)strtol(byteString.c_str(), nullptr, 16);
+    charArray[i / 2] = byte;
+  }
+  charArray[length / 2] = '\0';
+  return charArray;
+}
+
+ethhash makeInitHash(const char* c3Addr, const string& c2AddrBinary, const char* c3ProxyHash, const unsigned long long seed) {
+  random_device rd;
+  mt19937_64 eng(seed == 0 ? rd() : seed);
+  uniform_int_distribution<unsigned int> distr;  // C++ requires integer type: "C2338	note : char, signed char, unsigned char, int8_t, and uint8_t are not allowed"
+  ethhash h = {{0}};
+
+  h.b[0] = 0xff;
+  for (int i = 0; i < 20; ++i) {
+    h.b[i + 1] = c3Addr[i];
+  }
+
+  for (int i = 0; i < 16; ++i) {
+    h.b[i + 21] = distr(eng);
+  }
+  for (int i = 16; i < 32; ++i) {
+    h.b[i + 21] = c2AddrBinary[i - 12];
+  }
+
+  for (int i = 0; i < 32; ++i) {
+    h.b[i + 53] = c3ProxyHash[i];
+  }
+
+  h.b[85] ^= 0x01;
+
+  return h;
+}
+
+string makePreprocessorInitHashExpression(const ethhash& h) {
+  ostringstream oss;
+  oss << hex;
+  for (int i = 0; i < 25; ++i) {
+    oss << "0x" << h.q[i];
+    if (i + 1 != 25) {
+      oss << ",";
+    }
+  }
+
+  return oss.str();
+}
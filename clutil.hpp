@@ -0,0 +1,94 @@
+#ifndef HPP_CLUTIL
+#define HPP_CLUTIL
+
+#include <string>
+#include <vector>
+
+#if defined(__APPLE__) || defined(__MACOSX)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "types.hpp"
+
+using namespace std;
+
+vector<cl_device_id> getAllDevices(cl_device_type deviceType = CL_DEVICE_TYPE_GPU);
+vector<string> getBinaries(cl_program& clProgram);
+
+// Program from keccak.cl, the generated sources (see SaltTemplate and Pattern) and eradicate2.cl built for the
+// given devices, NULL if either step fails. The sources are embedded in the executable, see kernels.hpp.
+cl_program buildProgram(cl_context& clContext, const vector<cl_device_id>& vDevices, const string& strBuildOptions, const string& strGeneratedSource = "");
+
+// Keccak-f implementations in keccak.cl: ulong lanes, or uint halves with interleaved bits for devices that
+// emulate 64-bit rotates. Auto measures both on every device and keeps the faster (see Engine).
+enum class KeccakVariant { Auto, Lanes64, Interleaved32 };
+
+// Program from the embedded SPIR-V of the variant (make spirv), which skips compiling OpenCL C. It has no
+// generated source and its initial state is zero, only eradicate2_iterate_jobs is usable since it reads the
+// state from the job buffer. NULL if none was embedded, a device doesn't take SPIR-V or the build fails.
+cl_program buildProgramSpirv(cl_context& clContext, const vector<cl_device_id>& vDevices, const KeccakVariant variant);
+
+// "auto", "64" or "32"
+KeccakVariant parseKeccakVariant(const string& s);
+string keccakVariantName(const KeccakVariant variant);
+
+// Build option compiling the variant, empty for Lanes64
+string keccakBuildOption(const KeccakVariant variant);
+
+cl_command_queue createQueue(cl_context& clContext, cl_device_id& clDeviceId);
+
+// Whether the device shares memory with the host (integrated GPUs, CPUs), where zero-copy CLMemory saves the copies
+bool isHostUnified(cl_device_id clDeviceId);
+
+// Private and local memory a kernel needs per work item and group on a device, and its work group limits. Private
+// memory beyond what fits in registers is spilled to scratch and costs occupancy.
+string kernelInfo(cl_kernel& clKernel, cl_device_id clDeviceId);
+
+// Enqueues the kernel and waits for it, retrying without a local work size if the device rejects it
+void runKernel(cl_command_queue& clQueue, cl_kernel& clKernel, const size_t size, size_t& worksizeLocal);
+
+string keccakDigest(const string data);
+const char* hexStringToConstChar(const string& hex);
+
+// Initial CREATE2 state with the salt randomized from the seed, or from random_device if it's zero
+ethhash makeInitHash(const char* c3Addr, const string& c2AddrBinary, const char* c3ProxyHash, const unsigned long long seed = 0);
+string makePreprocessorInitHashExpression(const ethhash& h);
+
+template <typename T, typename U, typename V, typename W>
+T clGetWrapper(U function, V param, W param2) {
+  T t;
+  function(param, param2, sizeof(t), &t, NULL);
+  return t;
+}
+
+template <typename U, typename V, typename W>
+string clGetWrapperString(U function, V param, W param2) {
+  size_t len;
+  function(param, param2, 0, NULL, &len);
+  char* const szString = new char[len];
+  function(param, param2, len, szString, NULL);
+  string r(szString);
+  delete[] szString;
+  return r;
+}
+
+template <typename T, typename U, typename V, typename W>
+vector<T> clGetWrapperVector(U function, V param, W param2) {
+  size_t len;
+  function(param, param2, 0, NULL, &len);
+  len /= sizeof(T);
+  vector<T> v;
+  if (len > 0) {
+    T* pArray = new T[len];
+    function(param, param2, len * sizeof(T), pArray, NULL);
+    for (size_t i = 0; i < len; ++i) {
+      v.push_back(pArray[i]);
+    }
+    delete[] pArray;
+  }
+  return v;
+}
+
+#endif /* HPP_CLUTIL */
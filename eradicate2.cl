@@ -1,5 +1,5 @@
 enum ModeFunction {
-	Benchmark, ZeroBytes, Matching, Leading, Range, Mirror, Doubles, LeadingRange, Trailing, All, AllLeading, AllLeadingTrailing, MatchLeading
+	Benchmark, ZeroBytes, Matching, Leading, Range, Mirror, Doubles, LeadingRange, Trailing, All, AllLeading, AllLeadingTrailing, MatchLeading, Pattern, Weights
 };
 
 typedef struct {
@@ -14,110 +14,175 @@ typedef struct __attribute__((packed)) {
 	uint found;
 } result;
 
-__kernel void eradicate2_iterate(__global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_result_update(const uchar * const hash, __global result * const pResult, const uchar score, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_leading(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_benchmark(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_zerobytes(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_matching(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_leadingmatch(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_trailing(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_range(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_leadingrange(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_mirror(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_doubles(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_all(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_all_leading(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
-void eradicate2_score_all_leading_trailing(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round);
+// One of the searches run by eradicate2_iterate_jobs, it owns global ids begin and up until the next job's begin
+typedef struct {
+	ethhash init;
+	mode m;
+	uint begin;
+	uchar scoreMax;
+	uchar reserved[7];
+} job;
+
+__kernel void eradicate2_iterate(__global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceId, const ulong round);
+__kernel void eradicate2_iterate_jobs(__global result * const pResults, __global const job * const pJobs, const uint jobCount, const uint deviceId, const ulong round);
+__kernel void eradicate2_export(__global uint * const pAddresses, const uint deviceId, const ulong round);
+__kernel void eradicate2_score_batch(__global const uchar * const pHashes, __global const mode * const pMode, __global uchar * const pScores);
+void eradicate2_create3(ethhash * const h);
+void eradicate2_result_update(const ulong a0, const ulong a1, const ulong a2, __global result * const pResult, const uchar score, const uchar scoreMax, const uint deviceId, const ulong round);
+void eradicate2_result_save(__global result * const pResult, const ethhash * const h, const ulong a0, const ulong a1, const ulong a2);
+ulong eradicate2_lane(const ethhash * const h, const int i);
+ulong eradicate2_bswap(ulong x);
+ulong eradicate2_reverse_nibbles(ulong x);
+ulong eradicate2_zero_nibbles(ulong x);
+ulong eradicate2_zero_bytes(ulong x);
+ulong eradicate2_compress_nibbles(ulong x);
+ulong eradicate2_range_nibbles(const ulong x, const ulong lo, const ulong hi);
+ulong eradicate2_pack_bytes(__global const uchar * const p, const int count);
+ulong eradicate2_pack_nibbles(__global const uchar * const p, const int count, ulong * const pInvalid);
+uint eradicate2_ctz(const ulong x);
+uint eradicate2_leading_zeros(const ulong x0, const ulong x1, const ulong x2);
+uint eradicate2_trailing_zeros(const ulong x0, const ulong x1, const ulong x2);
+int eradicate2_score(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_leading(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_zerobytes(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_matching(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_leadingmatch(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_trailing(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_range(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_leadingrange(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_mirror(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_doubles(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_all(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_all_leading(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_all_leading_trailing(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode);
+int eradicate2_score_pattern(const ulong a0, const ulong a1, const ulong a2);
+int eradicate2_score_weights(const ulong a0, const ulong a1, const ulong a2);
+
+// Scorers see the address as three lanes of nibbles, most significant first. Lane 0 holds nibbles 0-7 in
+// its upper half and zeros below, lanes 1 and 2 hold nibbles 8-23 and 24-39. Every nibble of a lane is
+// compared at once by XORing against a broadcast pattern, runs are counted with clz and matches with popcount.
+#define ERADICATE2_NIBBLES 0x1111111111111111UL
+#define ERADICATE2_BYTES 0x0101010101010101UL
+#define ERADICATE2_LANE0 0xFFFFFFFF00000000UL
  
-__kernel void eradicate2_iterate(__global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	ethhash h = { .q = { ERADICATE2_INITHASH } };
-
-	// Salt have index h.b[21:52] inclusive, which covers WORDS with index h.d[6:12] inclusive (they represent h.b[24:51] inclusive)
-	// We use three out of those six words to generate a unique salt value for each device, thread and round. We ignore any overflows
-	// and assume that there'll never be more than 2**32 devices, threads or rounds. Worst case scenario with default settings
-	// of 16777216 = 2**24 threads means the assumption fails after a device has tried 2**32 * 2**24 = 2**56 salts, enough to match
-	// 14 characters in the address! A GTX 1070 with speed of ~700*10**6 combinations per second would hit this target after ~3 years.
-	h.d[6] += deviceIndex; 
-	h.d[7] += get_global_id(0);
-	h.d[8] += round;
+#ifndef ERADICATE2_SALT_TEMPLATE
+// The salt is h.b[21:52]. Its first 16 bytes start out random and every field below is a counter XORed or added into
+// them, so distinct device ids, threads and rounds can never produce the same salt:
+//
+//   salt[0:2]    device id bits 8-31, the worker id (--worker-id) that tells machines of a fleet apart, XORed
+//   salt[3:10]   round, all 64 bits added to the random lane h.q[3], wraps only after 2^64 rounds
+//   salt[11:14]  thread id, added to the random word h.d[8], global ids are 32 bits
+//   salt[15]     device id bits 0-7, the device's index on its machine, XORed
+//   salt[16:31]  the last 16 bytes of keccak256(deployer)
+//
+// All counters are little endian. The host refuses worker ids and device indices that don't fit, and the dispatcher
+// stops a device rather than let its round wrap, see SaltTemplate::roundMax().
+//
+// A salt template (--salt-template) replaces this function with one generated by SaltTemplate::source().
+void eradicate2_salt_apply(ethhash * const h, const uint deviceId, const uint id, const ulong round) {
+	h->q[2] ^= (ulong)(deviceId >> 8) << 40;
+	h->q[3] += round;
+	h->d[8] += id;
+	h->q[4] ^= (ulong)(deviceId & 0xff) << 32;
+}
+#endif
 
-	// Hash for CREATE2
-	sha3_keccakf(&h);
-
-	// Hash for CREATE
-	ethhash h2 = { 0 };
-	h2.b[0] = 0xd6;
-	h2.b[1] = 0x94;
-	for (int i = 0; i < 20; i++) {
-		h2.b[2 + i] = h.b[12 + i];
-	}
-	h2.b[22] = 0x01;
-	h2.b[23] ^= 0x01; // IDK why but it works
-	sha3_keccakf(&h2);
-	h = h2;
+__kernel void eradicate2_iterate(__global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceId, const ulong round) {
+	ethhash h = { .q = { ERADICATE2_INITHASH } };
+	eradicate2_salt_apply(&h, deviceId, get_global_id(0), round);
+	eradicate2_create3(&h);
 
-	/* enum class ModeFunction {
-	 *      Benchmark, ZeroBytes, Matching, Leading, Range, Mirror, Doubles, LeadingRange, All
-	 * };
-	 */
-	switch (pMode->function) {
-	case Benchmark:
-		eradicate2_score_benchmark(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+	// Lanes are passed by value from here on so the state never has to be byte addressable
+	const ulong a0 = eradicate2_lane(&h, 0);
+	const ulong a1 = eradicate2_lane(&h, 1);
+	const ulong a2 = eradicate2_lane(&h, 2);
 
-	case ZeroBytes:
-		eradicate2_score_zerobytes(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+	// All reports everything above its own minimum rather than the best score so far
+	const uchar score = eradicate2_score(a0, a1, a2, pMode);
+	eradicate2_result_update(a0, a1, a2, pResult, score, pMode->function == All ? pMode->data1[0] - 1 : scoreMax, deviceId, round);
+}
 
-	case Matching:
-		eradicate2_score_matching(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+// Many small searches in one launch. The global range is split between the jobs, sorted by begin, and each
+// job sees its own ids from 0 so a job's salts are those of a single job eradicate2_iterate of the same size.
+// Every job has ERADICATE2_MAX_SCORE + 1 result slots of its own. All jobs share the program's salt template.
+__kernel void eradicate2_iterate_jobs(__global result * const pResults, __global const job * const pJobs, const uint jobCount, const uint deviceId, const ulong round) {
+	const uint gid = get_global_id(0);
+	uint lo = 0;
+	uint hi = jobCount;
+	while (hi - lo > 1) {
+		const uint mid = (lo + hi) / 2;
+		if (pJobs[mid].begin <= gid) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
 
-	case MatchLeading:
-		eradicate2_score_leadingmatch(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+	__global const job * const pJob = pJobs + lo;
+	const uint id = gid - pJob->begin;
 
-	case Leading:
-		eradicate2_score_leading(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+	ethhash h = pJob->init;
+	eradicate2_salt_apply(&h, deviceId, id, round);
+	eradicate2_create3(&h);
 
-	case Trailing:
-		eradicate2_score_trailing(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+	const ulong a0 = eradicate2_lane(&h, 0);
+	const ulong a1 = eradicate2_lane(&h, 1);
+	const ulong a2 = eradicate2_lane(&h, 2);
 
-	case Range:
-		eradicate2_score_range(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+	const uchar score = eradicate2_score(a0, a1, a2, &pJob->m);
+	const uchar scoreMax = pJob->m.function == All ? pJob->m.data1[0] - 1 : pJob->scoreMax;
+	__global result * const pResult = pResults + lo * (ERADICATE2_MAX_SCORE + 1);
+	if (score && score > scoreMax && atomic_inc(&pResult[score].found) == 0) {
+		ethhash s = pJob->init;
+		eradicate2_salt_apply(&s, deviceId, id, round);
+		eradicate2_result_save(pResult + score, &s, a0, a1, a2);
+	}
+}
 
-	case Mirror:
-		eradicate2_score_mirror(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+// Every address of the round in thread id order, 20 bytes each and nothing scored, see Exporter
+__kernel void eradicate2_export(__global uint * const pAddresses, const uint deviceId, const ulong round) {
+	const size_t id = get_global_id(0);
+	ethhash h = { .q = { ERADICATE2_INITHASH } };
+	eradicate2_salt_apply(&h, deviceId, id, round);
+	eradicate2_create3(&h);
 
-	case Doubles:
-		eradicate2_score_doubles(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+	// h.b[12:31] is five whole words
+	__global uint * const p = pAddresses + id * 5;
+	for (int i = 0; i < 5; ++i) {
+		p[i] = h.d[3 + i];
+	}
+}
 
-	case LeadingRange:
-		eradicate2_score_leadingrange(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+// Replaces the salted CREATE2 state in h with the state of the CREATE from the proxy, the address is h->b[12:31].
+// The CREATE preimage is built in place with whole-lane shifts, so both hashes share one state.
+void eradicate2_create3(ethhash * const h) {
+#ifdef ERADICATE2_GUARD
+	// Generated by Guard::source() for --guard, the factory deploys with a hash of the salt
+	eradicate2_guard(h);
+#endif
 
-	case AllLeading:
-		eradicate2_score_all_leading(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+	// Hash for CREATE2
+	sha3_keccakf(h);
+
+	// Hash for CREATE of rlp([proxy, 1]): 0xd6 0x94, the address moved from b[12:31] to b[2:21], the nonce 0x01
+	// in b[22] and the first padding byte in b[23]
+	h->q[0] = 0x94d6UL | ((h->q[1] >> 32) << 16) | (h->q[2] << 48);
+	h->q[1] = (h->q[2] >> 16) | (h->q[3] << 48);
+	h->q[2] = (h->q[3] >> 16) | 0x0101000000000000UL;
+	for (int i = 3; i < 25; ++i) {
+		h->q[i] = 0;
+	}
 
-	case AllLeadingTrailing:
-		eradicate2_score_all_leading_trailing(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
+	sha3_keccakf(h);
+}
 
-	case All:
-		eradicate2_score_all(h.b + 12, pResult, pMode, scoreMax, deviceIndex, round);
-		break;
-	}
-	
+// Scores addresses given by the host, used by the self-test to compare every scorer against the host's
+__kernel void eradicate2_score_batch(__global const uchar * const pHashes, __global const mode * const pMode, __global uchar * const pScores) {
+	__global const uchar * const pHash = pHashes + get_global_id(0) * 20;
+	pScores[get_global_id(0)] = eradicate2_score(eradicate2_pack_bytes(pHash, 4) << 32, eradicate2_pack_bytes(pHash + 4, 8), eradicate2_pack_bytes(pHash + 12, 8), pMode);
 }
 
-void eradicate2_result_update(const uchar * const H, __global result * const pResult, const uchar score, const uchar scoreMax, const uint deviceIndex, const uint round) {
+void eradicate2_result_update(const ulong a0, const ulong a1, const ulong a2, __global result * const pResult, const uchar score, const uchar scoreMax, const uint deviceId, const ulong round) {
 	if (score && score > scoreMax) {
 		const uchar hasResult = atomic_inc(&pResult[score].found); // NOTE: If "too many" results are found it'll wrap around to 0 again and overwrite last result. Only relevant if global worksize exceeds MAX(uint).
 
@@ -125,258 +190,304 @@ void eradicate2_result_update(const uchar * const H, __global result * const pRe
 		if (hasResult == 0) {
 			// Reconstruct state with hash and extract salt
 			ethhash h = { .q = { ERADICATE2_INITHASH } };
-			h.d[6] += deviceIndex;
-			h.d[7] += get_global_id(0);
-			h.d[8] += round;
+			eradicate2_salt_apply(&h, deviceId, get_global_id(0), round);
+			eradicate2_result_save(pResult + score, &h, a0, a1, a2);
+		}
+	}
+}
 
-			ethhash be;
+// Stores the salt of a reconstructed initial state and the address it derived, unpacked from its lanes
+void eradicate2_result_save(__global result * const pResult, const ethhash * const h, const ulong a0, const ulong a1, const ulong a2) {
+	for (int i = 0; i < 32; ++i) {
+		pResult->salt[i] = h->b[i + 21];
+	}
 
-			for (int i = 0; i < 32; ++i) {
-				pResult[score].salt[i] = h.b[i + 21];
-			}
+	for (int i = 0; i < 4; ++i) {
+		pResult->hash[i] = a0 >> (56 - 8 * i);
+	}
 
-			for (int i = 0; i < 20; ++i) {
-				pResult[score].hash[i] = H[i];
-			}
-		}
+	for (int i = 0; i < 8; ++i) {
+		pResult->hash[4 + i] = a1 >> (56 - 8 * i);
+		pResult->hash[12 + i] = a2 >> (56 - 8 * i);
 	}
 }
 
-void eradicate2_score_leading(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	int score = 0;
+ulong eradicate2_lane(const ethhash * const h, const int i) {
+	// The address is h.b[12:31], little endian lanes h.q[1:3]
+	return i == 0 ? eradicate2_bswap(h->q[1]) << 32 : eradicate2_bswap(h->q[1 + i]);
+}
 
-	for (int i = 0; i < 20; ++i) {
-		if ((hash[i] & 0xF0) >> 4 == pMode->data1[0]) {
-			++score;
-		} else {
-			break;
-		}
+ulong eradicate2_bswap(ulong x) {
+	x = ((x & 0x00FF00FF00FF00FFUL) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFUL);
+	x = ((x & 0x0000FFFF0000FFFFUL) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFUL);
+	return (x << 32) | (x >> 32);
+}
 
-		if ((hash[i] & 0x0F) == pMode->data1[0]) {
-			++score;
-		} else {
-			break;
-		}
-	}
+ulong eradicate2_reverse_nibbles(ulong x) {
+	x = eradicate2_bswap(x);
+	return ((x & 0x0F0F0F0F0F0F0F0FUL) << 4) | ((x >> 4) & 0x0F0F0F0F0F0F0F0FUL);
+}
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
+// Bit 0 of every nibble is set if the nibble is zero
+ulong eradicate2_zero_nibbles(ulong x) {
+	x |= x >> 1;
+	x |= x >> 2;
+	return ~x & ERADICATE2_NIBBLES;
 }
 
-void eradicate2_score_all_leading(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	int score = 0;
-	uchar ch = hash[0] >> 4;
-	for (int i = 1; i < 40; ++i) {
-		uchar nibble = (i & 1) ? (hash[i>>1] & 0x0f) : (hash[i>>1] >> 4);
-		if (nibble == ch) {
-			++score;
-		} else {
-			break;
-		}
-	}
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
-}
-
-void eradicate2_score_all_leading_trailing(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	int score = 0;
-
-	uchar chl; 
-	uchar cht; 
-	size_t i = pMode->data2[0] == 0 ? 1 : 0;
-	size_t j = i == 1 ? 38: 39;
-	if(i == 1){
-		chl = hash[0] >> 4;
-		cht = hash[19] & 0x0f;
-		score = 1;
-	}else {
-		chl = pMode->data1[0];
-		cht = pMode->data2[0] == 1 ? chl : pMode->data1[1];
-	}
-	
-	for (; i < 40; ++i) {
-		uchar nibblel = (i & 1) ? (hash[i>>1] & 0x0f) : (hash[i>>1] >> 4);
-		uchar nibblet = (j & 1) ? (hash[j>>1] & 0x0f) : (hash[j>>1] >> 4);
-		if (nibblel == chl && nibblet == cht) {
-			++score;
-			--j;
-		} else {
-			break;
-		}
-	}
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
-}
-void eradicate2_score_all(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	int score = 0;
-
-	// Find length of longest chain of repeated symbols
-	uchar ch = hash[0] >> 4;
-	int length = 1;
-	for (int i = 1; i < 40; ++i) {
-		uchar nibble = (i & 1) ? (hash[i>>1] & 0x0f) : (hash[i>>1] >> 4);
-		if (nibble == ch) {
-			++length;
-		}
+// Bit 0 of every byte is set if the byte is zero
+ulong eradicate2_zero_bytes(ulong x) {
+	x |= x >> 4;
+	x |= x >> 2;
+	x |= x >> 1;
+	return ~x & ERADICATE2_BYTES;
+}
 
-		if (nibble != ch || i == 39) {
-			if (length > score) {
-				score = length;
-			}
-			ch = nibble;
-			length = 1;
-		}
+// Gathers bit 0 of every nibble into the lower 16 bits, nibble 15 (least significant) becomes bit 0
+ulong eradicate2_compress_nibbles(ulong x) {
+	x = (x | (x >> 3)) & 0x0303030303030303UL;
+	x = (x | (x >> 6)) & 0x000F000F000F000FUL;
+	x = (x | (x >> 12)) & 0x000000FF000000FFUL;
+	return (x | (x >> 24)) & 0xFFFFUL;
+}
+
+// Bit 3 of every nibble is set if lo <= nibble <= hi. Nibbles are spread out to bytes so that both
+// comparisons are a subtraction that can only clear bit 7, never borrow from the next byte.
+ulong eradicate2_range_nibbles(const ulong x, const ulong lo, const ulong hi) {
+	const ulong loBytes = min(lo, 16UL) * ERADICATE2_BYTES;
+	const ulong hiBytes = (min(hi, 15UL) * ERADICATE2_BYTES) | 0x8080808080808080UL;
+	const ulong even = (x >> 4) & 0x0F0F0F0F0F0F0F0FUL;
+	const ulong odd = x & 0x0F0F0F0F0F0F0F0FUL;
+
+	const ulong inEven = ((even | 0x8080808080808080UL) - loBytes) & (hiBytes - even);
+	const ulong inOdd = ((odd | 0x8080808080808080UL) - loBytes) & (hiBytes - odd);
+	return (inEven & 0x8080808080808080UL) | ((inOdd & 0x8080808080808080UL) >> 4);
+}
+
+// Packs count bytes into a lane, first byte most significant
+ulong eradicate2_pack_bytes(__global const uchar * const p, const int count) {
+	ulong r = 0;
+	for (int i = 0; i < count; ++i) {
+		r = (r << 8) | p[i];
 	}
 
-	eradicate2_result_update(hash, pResult, score, pMode->data1[0] - 1, deviceIndex, round);
+	return r;
 }
-void eradicate2_score_benchmark(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	const size_t id = get_global_id(0);
-	int score = 0;
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
+// Packs count bytes holding one nibble each into a lane, first nibble most significant. Bytes that aren't a
+// nibble set all bits of their nibble in *pInvalid so they can never match.
+ulong eradicate2_pack_nibbles(__global const uchar * const p, const int count, ulong * const pInvalid) {
+	ulong r = 0;
+	ulong invalid = 0;
+	for (int i = 0; i < count; ++i) {
+		r = (r << 4) | (p[i] & 0x0F);
+		invalid = (invalid << 4) | (p[i] > 0x0F ? 0x0F : 0x00);
+	}
+
+	*pInvalid = invalid;
+	return r;
 }
 
-void eradicate2_score_zerobytes(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	const size_t id = get_global_id(0);
-	int score = 0;
+uint eradicate2_ctz(const ulong x) {
+	return popcount((x & -x) - 1);
+}
 
-	for (int i = 0; i < 20; ++i) {
-		score += !hash[i];
+// Number of leading zero nibbles over all three lanes, x0 is masked to lane 0's upper half
+uint eradicate2_leading_zeros(const ulong x0, const ulong x1, const ulong x2) {
+	uint n = min((uint)clz(x0 & ERADICATE2_LANE0), 32U) >> 2;
+	if (n == 8) {
+		n += (uint)clz(x1) >> 2;
+		if (n == 24) {
+			n += (uint)clz(x2) >> 2;
+		}
 	}
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
+	return n;
 }
 
-void eradicate2_score_matching(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	const size_t id = get_global_id(0);
-	int score = 0;
-
-	for (int i = 0; i < 20; ++i) {
-		if (pMode->data1[i] > 0 && (hash[i] & pMode->data1[i]) == pMode->data2[i]) {
-			++score;
+// Number of trailing zero nibbles over all three lanes, lane 0's lower half is ignored
+uint eradicate2_trailing_zeros(const ulong x0, const ulong x1, const ulong x2) {
+	uint n = eradicate2_ctz(x2) >> 2;
+	if (n == 16) {
+		n += eradicate2_ctz(x1) >> 2;
+		if (n == 32) {
+			n += min(eradicate2_ctz(x0 >> 32), 32U) >> 2;
 		}
 	}
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
+	return n;
 }
 
+int eradicate2_score(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	/* enum class ModeFunction {
+	 *      Benchmark, ZeroBytes, Matching, Leading, Range, Mirror, Doubles, LeadingRange, Trailing, All, AllLeading, AllLeadingTrailing, MatchLeading, Pattern, Weights
+	 * };
+	 */
+#ifdef ERADICATE2_CONSTRAINT
+	// Generated by Constraint::source() for --constraint, the mode only scores addresses that pass it
+	if (!eradicate2_constraint(a0, a1, a2)) {
+		return 0;
+	}
+#endif
 
-void eradicate2_score_leadingmatch(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-		const size_t id = get_global_id(0);
+	switch (pMode->function) {
+	case ZeroBytes:
+		return eradicate2_score_zerobytes(a0, a1, a2, pMode);
 
-    size_t len = (pMode->data2[0]);
+	case Matching:
+		return eradicate2_score_matching(a0, a1, a2, pMode);
 
-    int score = 0;
-    for (size_t i = 0; i < len; ++i) {
-			uchar nibble = (i & 1) ? (hash[i>>1] & 0x0f) : (hash[i>>1] >> 4);
-        if ( (pMode->data1[i]) == nibble) {
-            ++score;
-        } else {
-            break;
-        }
-    }
+	case MatchLeading:
+		return eradicate2_score_leadingmatch(a0, a1, a2, pMode);
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
-}
+	case Leading:
+		return eradicate2_score_leading(a0, a1, a2, pMode);
 
+	case Trailing:
+		return eradicate2_score_trailing(a0, a1, a2, pMode);
 
-void eradicate2_score_trailing(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	int score = 0;
+	case Range:
+		return eradicate2_score_range(a0, a1, a2, pMode);
 
-	for (int i = 39; i > 0; --i) {
-		uchar nibblet = (i & 1) ? (hash[i>>1] & 0x0f) : (hash[i>>1] >> 4);
-		if (nibblet == pMode->data1[0]) {
-			++score;
-		} else {
-			break;
-		}
-	}
+	case Mirror:
+		return eradicate2_score_mirror(a0, a1, a2, pMode);
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
-}
-void eradicate2_score_range(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	const size_t id = get_global_id(0);
-	int score = 0;
+	case Doubles:
+		return eradicate2_score_doubles(a0, a1, a2, pMode);
 
-	for (int i = 0; i < 20; ++i) {
-		const uchar first = (hash[i] & 0xF0) >> 4;
-		const uchar second = (hash[i] & 0x0F);
+	case LeadingRange:
+		return eradicate2_score_leadingrange(a0, a1, a2, pMode);
 
-		if (first >= pMode->data1[0] && first <= pMode->data2[0]) {
-			++score;
-		}
+	case AllLeading:
+		return eradicate2_score_all_leading(a0, a1, a2, pMode);
 
-		if (second >= pMode->data1[0] && second <= pMode->data2[0]) {
-			++score;
-		}
+	case AllLeadingTrailing:
+		return eradicate2_score_all_leading_trailing(a0, a1, a2, pMode);
+
+	case All:
+		return eradicate2_score_all(a0, a1, a2, pMode);
+
+#ifdef ERADICATE2_PATTERN
+	// Generated by Pattern::source() for --pattern
+	case Pattern:
+		return eradicate2_score_pattern(a0, a1, a2);
+#endif
+
+#ifdef ERADICATE2_WEIGHTS
+	// Generated by Weights::source() for --weights, the table is in __constant memory
+	case Weights:
+		return eradicate2_score_weights(a0, a1, a2);
+#endif
+
+	default:
+		return 0;
 	}
+}
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
+int eradicate2_score_leading(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	const ulong p = pMode->data1[0] * ERADICATE2_NIBBLES;
+	return eradicate2_leading_zeros(a0 ^ p, a1 ^ p, a2 ^ p);
 }
 
-void eradicate2_score_leadingrange(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	const size_t id = get_global_id(0);
-	int score = 0;
+int eradicate2_score_all_leading(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	// Characters following the first that are equal to it
+	const ulong p = (a0 >> 60) * ERADICATE2_NIBBLES;
+	return eradicate2_leading_zeros(a0 ^ p, a1 ^ p, a2 ^ p) - 1;
+}
 
-	for (int i = 0; i < 20; ++i) {
-		const uchar first = (hash[i] & 0xF0) >> 4;
-		const uchar second = (hash[i] & 0x0F);
+int eradicate2_score_all_leading_trailing(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	// Without arguments the first and last character are free, otherwise given by data1. The leading and
+	// trailing runs grow together so the score is the shorter of the two.
+	ulong chl = pMode->data1[0];
+	ulong cht = pMode->data2[0] == 1 ? chl : pMode->data1[1];
+	if (pMode->data2[0] == 0) {
+		chl = a0 >> 60;
+		cht = a2 & 0x0F;
+	}
 
-		if (first >= pMode->data1[0] && first <= pMode->data2[0]) {
-			++score;
-		}
-		else {
-			break;
-		}
+	const ulong pl = chl * ERADICATE2_NIBBLES;
+	const ulong pt = cht * ERADICATE2_NIBBLES;
+	return min(eradicate2_leading_zeros(a0 ^ pl, a1 ^ pl, a2 ^ pl), eradicate2_trailing_zeros(a0 ^ pt, a1 ^ pt, a2 ^ pt));
+}
 
-		if (second >= pMode->data1[0] && second <= pMode->data2[0]) {
-			++score;
-		}
-		else {
-			break;
-		}
+int eradicate2_score_all(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	// One bit per pair of neighbouring nibbles that are equal, 0|1 in bit 38 down to 38|39 in bit 0
+	const ulong e0 = eradicate2_zero_nibbles(a0 ^ (a0 >> 4)) & 0x0111111100000000UL;
+	const ulong e1 = eradicate2_zero_nibbles(a1 ^ ((a1 >> 4) | (a0 << 28)));
+	const ulong e2 = eradicate2_zero_nibbles(a2 ^ ((a2 >> 4) | (a1 << 60)));
+	ulong e = ((eradicate2_compress_nibbles(e0) >> 8) << 32) | (eradicate2_compress_nibbles(e1) << 16) | eradicate2_compress_nibbles(e2);
+
+	// Longest run of any character is one more than the longest run of set bits
+	int score = 1;
+	for (; e; ++score) {
+		e &= e << 1;
 	}
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
+	return score;
 }
 
-void eradicate2_score_mirror(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	const size_t id = get_global_id(0);
-	int score = 0;
-
-	for (int i = 0; i < 10; ++i) {
-		const uchar leftLeft = (hash[9 - i] & 0xF0) >> 4;
-		const uchar leftRight = (hash[9 - i] & 0x0F);
+int eradicate2_score_zerobytes(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	return popcount(eradicate2_zero_bytes(a0) & ERADICATE2_LANE0) + popcount(eradicate2_zero_bytes(a1)) + popcount(eradicate2_zero_bytes(a2));
+}
 
-		const uchar rightLeft = (hash[10 + i] & 0xF0) >> 4;
-		const uchar rightRight = (hash[10 + i] & 0x0F);
+int eradicate2_score_matching(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	// Bytes whose mask in data1 is non-zero and whose masked value is data2
+	const ulong m0 = eradicate2_pack_bytes(pMode->data1, 4) << 32;
+	const ulong m1 = eradicate2_pack_bytes(pMode->data1 + 4, 8);
+	const ulong m2 = eradicate2_pack_bytes(pMode->data1 + 12, 8);
+	const ulong v0 = eradicate2_pack_bytes(pMode->data2, 4) << 32;
+	const ulong v1 = eradicate2_pack_bytes(pMode->data2 + 4, 8);
+	const ulong v2 = eradicate2_pack_bytes(pMode->data2 + 12, 8);
+
+	const ulong r0 = eradicate2_zero_bytes((a0 & m0) ^ v0) & ~eradicate2_zero_bytes(m0);
+	const ulong r1 = eradicate2_zero_bytes((a1 & m1) ^ v1) & ~eradicate2_zero_bytes(m1);
+	const ulong r2 = eradicate2_zero_bytes((a2 & m2) ^ v2) & ~eradicate2_zero_bytes(m2);
+	return popcount(r0) + popcount(r1) + popcount(r2);
+}
 
-		if (leftRight != rightLeft) {
-			break;
-		}
+int eradicate2_score_leadingmatch(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	// One nibble per byte of data1, patterns longer than 20 characters continue into data2
+	__global const uchar * const pattern = pMode->data1;
+	const uint len = min((uint)pMode->data2[0], 40U);
 
-		++score;
+	ulong i0, i1, i2;
+	const ulong p0 = eradicate2_pack_nibbles(pattern, 8, &i0) << 32;
+	const ulong p1 = eradicate2_pack_nibbles(pattern + 8, 16, &i1);
+	const ulong p2 = eradicate2_pack_nibbles(pattern + 24, 16, &i2);
+	return min(eradicate2_leading_zeros((a0 ^ p0) | (i0 << 32), (a1 ^ p1) | i1, (a2 ^ p2) | i2), len);
+}
 
-		if (leftLeft != rightRight) {
-			break;
-		}
+int eradicate2_score_trailing(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	// The first character isn't counted
+	const ulong p = pMode->data1[0] * ERADICATE2_NIBBLES;
+	return min(eradicate2_trailing_zeros(a0 ^ p, a1 ^ p, a2 ^ p), 39U);
+}
 
-		++score;
-	}
+int eradicate2_score_range(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	const ulong lo = pMode->data1[0];
+	const ulong hi = pMode->data2[0];
+	return popcount(eradicate2_range_nibbles(a0, lo, hi) & ERADICATE2_LANE0) + popcount(eradicate2_range_nibbles(a1, lo, hi)) + popcount(eradicate2_range_nibbles(a2, lo, hi));
+}
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
+int eradicate2_score_leadingrange(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	const ulong lo = pMode->data1[0];
+	const ulong hi = pMode->data2[0];
+	const ulong outside = 0x8888888888888888UL;
+	return eradicate2_leading_zeros(~eradicate2_range_nibbles(a0, lo, hi) & outside, ~eradicate2_range_nibbles(a1, lo, hi) & outside, ~eradicate2_range_nibbles(a2, lo, hi) & outside);
 }
 
-void eradicate2_score_doubles(const uchar * const hash, __global result * const pResult, __global const mode * const pMode, const uchar scoreMax, const uint deviceIndex, const uint round) {
-	const size_t id = get_global_id(0);
-	int score = 0;
+int eradicate2_score_mirror(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	// Nibbles 19 down to 0 against 20 up to 39, as a lane of 16 nibbles followed by one of 4
+	const ulong r0 = eradicate2_reverse_nibbles(a0);
+	const ulong x0 = ((eradicate2_reverse_nibbles(a1) << 16) | (r0 >> 16)) ^ ((a1 << 48) | (a2 >> 16));
+	const ulong x1 = (r0 << 48) ^ (a2 << 48);
 
-	for (int i = 0; i < 20; ++i) {
-		if ((hash[i] == 0x00) || (hash[i] == 0x11) || (hash[i] == 0x22) || (hash[i] == 0x33) || (hash[i] == 0x44) || (hash[i] == 0x55) || (hash[i] == 0x66) || (hash[i] == 0x77) || (hash[i] == 0x88) || (hash[i] == 0x99) || (hash[i] == 0xAA) || (hash[i] == 0xBB) || (hash[i] == 0xCC) || (hash[i] == 0xDD) || (hash[i] == 0xEE) || (hash[i] == 0xFF)) {
-			++score;
-		}
-		else {
-			break;
-		}
-	}
+	const uint n = (uint)clz(x0) >> 2;
+	return n < 16 ? n : 16 + (min((uint)clz(x1), 16U) >> 2);
+}
 
-	eradicate2_result_update(hash, pResult, score, scoreMax, deviceIndex, round);
+int eradicate2_score_doubles(const ulong a0, const ulong a1, const ulong a2, __global const mode * const pMode) {
+	// Leading bytes whose nibbles are equal, a byte that isn't adds one zero nibble before its mismatch
+	const ulong m = 0x0F0F0F0F0F0F0F0FUL;
+	return eradicate2_leading_zeros((a0 ^ (a0 >> 4)) & m, (a1 ^ (a1 >> 4)) & m, (a2 ^ (a2 >> 4)) & m) >> 1;
 }
@@ -1,13 +1,18 @@
 #include <algorithm>
 #include <chrono>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <exception>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <random>
 #include <set>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 #if defined(__APPLE__) || defined(__MACOSX)
 #include <OpenCL/cl.h>
@@ -18,207 +23,236 @@
 #include <magic_enum.hpp>
 
 #include "ArgParser.hpp"
-#include "Dispatcher.hpp"
+#include "Engine.hpp"
+#include "Estimator.hpp"
+#include "Guard.hpp"
+#include "MetricsServer.hpp"
+#include "ModeArgs.hpp"
 #include "ModeFactory.hpp"
+#include "SaltTemplate.hpp"
+#include "Verifier.hpp"
+#include "clutil.hpp"
 #include "help.hpp"
 #include "hexadecimal.hpp"
 #include "sha3.hpp"
 
 using namespace std;
 
-string readFile(const char* const szFilename) {
-  ifstream in(szFilename, ios::in | ios::binary);
-  ostringstream contents;
-  contents << in.rdbuf();
-  return contents.str();
-}
-
-vector<cl_device_id> getAllDevices(cl_device_type deviceType = CL_DEVICE_TYPE_GPU) {
-  vector<cl_device_id> vDevices;
-
-  cl_uint platformIdCount = 0;
-  clGetPlatformIDs(0, NULL, &platformIdCount);
+const string strVT100ClearLine = "\33[2K\r";
 
-  vector<cl_platform_id> platformIds(platformIdCount);
-  clGetPlatformIDs(platformIdCount, platformIds.data(), NULL);
+void printResult(const result& r, const cl_uchar score, const chrono::steady_clock::time_point& timeStart, const string& strJob = "") {
+  const auto seconds = chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - timeStart).count();
+  cout << strVT100ClearLine << "  Time: " << setw(5) << seconds << "s Score: " << setw(2) << (int)score << (strJob.empty() ? "" : " Job: " + strJob) << " Magic: 0x" << toHex(r.salt, 32) << " Address: 0x" << toHex(r.hash, 20) << endl;
+}
 
-  for (auto it = platformIds.cbegin(); it != platformIds.cend(); ++it) {
-    cl_uint countDevice;
-    clGetDeviceIDs(*it, deviceType, 0, NULL, &countDevice);
+void trim(string& s) {
+  const auto iLeft = s.find_first_not_of(" \t\r\n");
+  if (iLeft != string::npos) {
+    s.erase(0, iLeft);
+  }
 
-    vector<cl_device_id> deviceIds(countDevice);
-    clGetDeviceIDs(*it, deviceType, countDevice, deviceIds.data(), &countDevice);
+  const auto iRight = s.find_last_not_of(" \t\r\n");
+  if (iRight != string::npos) {
+    const auto count = s.length() - iRight - 1;
+    s.erase(iRight + 1, count);
+  }
+}
 
-    copy(deviceIds.begin(), deviceIds.end(), back_inserter(vDevices));
+// Salts per second of a job over a few seconds on its devices, with nothing written anywhere
+static double measureSpeed(Engine::Job job) {
+  job.fileName.clear();
+  job.storeFileName.clear();
+  job.traceFileName.clear();
+  job.profiling = false;
+
+  Engine engine(job, Dispatcher::Callbacks());
+  exception_ptr pException;
+  thread t([&engine, &pException] {
+    try {
+      engine.run();
+    } catch (runtime_error&) {
+      pException = current_exception();
+    }
+  });
+  this_thread::sleep_for(chrono::seconds(5));
+  engine.stop();
+  t.join();
+  if (pException) {
+    rethrow_exception(pException);
   }
 
-  return vDevices;
+  return engine.speed().total;
 }
 
-template <typename T, typename U, typename V, typename W>
-T clGetWrapper(U function, V param, W param2) {
-  T t;
-  function(param, param2, sizeof(t), &t, NULL);
-  return t;
-}
+// Chance, expected time and the span in which 10% to 90% of searches succeed for every score above scoreMin
+static void printEstimate(const Estimator& e, const unsigned int scoreMin, const double speed) {
+  cout << "Speed: " << Speed::format(speed) << " | " << (e.samples() == 0 ? string("exact") : "sampled from " + to_string(e.samples()) + " hashes, ~ extrapolated") << endl;
+  cout << "Score      1 in        Expected   10% - 90% of searches" << endl;
+  for (int s = scoreMin + 1; s <= ERADICATE2_MAX_SCORE; ++s) {
+    const Estimator::Level& l = e.level(s);
+    if (l.p <= 0) {
+      break;
+    }
 
-template <typename U, typename V, typename W>
-string clGetWrapperString(U function, V param, W param2) {
-  size_t len;
-  function(param, param2, 0, NULL, &len);
-  char* const szString = new char[len];
-  function(param, param2, len, szString, NULL);
-  string r(szString);
-  delete[] szString;
-  return r;
-}
+    const double expected = 1 / l.p / speed;
+    cout << setw(5) << s << (l.bExtrapolated ? "~" : " ") << "  " << scientific << setprecision(2) << setw(9) << 1 / l.p << defaultfloat;
+    cout << "  " << setw(12) << Estimator::formatTime(expected) << "  " << Estimator::formatTime(Estimator::hashes(l.pHigh, 0.1) / speed) << " - " << Estimator::formatTime(Estimator::hashes(l.pLow, 0.9) / speed) << endl;
 
-template <typename T, typename U, typename V, typename W>
-vector<T> clGetWrapperVector(U function, V param, W param2) {
-  size_t len;
-  function(param, param2, 0, NULL, &len);
-  len /= sizeof(T);
-  vector<T> v;
-  if (len > 0) {
-    T* pArray = new T[len];
-    function(param, param2, len * sizeof(T), pArray, NULL);
-    for (size_t i = 0; i < len; ++i) {
-      v.push_back(pArray[i]);
+    // Beyond a million years nobody's waiting
+    if (expected > 3.15576e13) {
+      break;
     }
-    delete[] pArray;
   }
-  return v;
 }
 
-vector<string> getBinaries(cl_program& clProgram) {
-  vector<string> vReturn;
-  auto vSizes = clGetWrapperVector<size_t>(clGetProgramInfo, clProgram, CL_PROGRAM_BINARY_SIZES);
-  if (!vSizes.empty()) {
-    unsigned char** pBuffers = new unsigned char*[vSizes.size()];
-    for (size_t i = 0; i < vSizes.size(); ++i) {
-      pBuffers[i] = new unsigned char[vSizes[i]];
-    }
+/* Searches run together with -J, one per line of the file. A line holds the
+ * switches of a single search and anything it doesn't give is taken from base,
+ * which was built from the command line:
+ *
+ *   -d3 <deployer> [-c3 proxy hash] [-d create2 deployer] <mode> [-ms min-score] [-S size] [-f file] [-j job id]
+ *       [-jw weight] [-jp priority] [-jr rounds]
+ *
+ * Jobs without -S share base.size equally, job ids count up from base.jobId
+ * and results go to "Mode-<job id>.txt" by default. A weight, priority or
+ * round count other than the defaults schedules the jobs like -sc does, every
+ * round then runs a single job and jobs without -S take all of base.size.
+ * Empty lines and lines starting with # are skipped. At most one pattern and
+ * one set of weights can be used by all jobs, and all of them share the
+ * constraint of the command line.
+ */
+static vector<Engine::Job> readJobs(const string& fileName, const Engine::Job& base, const string& c3Addr, const string& c3ProxyHash, const string& c2Addr) {
+  ifstream ifs(fileName);
+  if (!ifs.is_open()) {
+    throw runtime_error("failed to open jobs file " + fileName);
+  }
 
-    clGetProgramInfo(clProgram, CL_PROGRAM_BINARIES, vSizes.size() * sizeof(unsigned char*), pBuffers, NULL);
-    for (size_t i = 0; i < vSizes.size(); ++i) {
-      string strData(reinterpret_cast<char*>(pBuffers[i]), vSizes[i]);
-      vReturn.push_back(strData);
-      delete[] pBuffers[i];
+  vector<Engine::Job> vJobs;
+  string strPattern;
+  Weights weights;
+  bool bSchedule = base.schedule;
+  size_t lineNumber = 0;
+  for (string line; getline(ifs, line);) {
+    ++lineNumber;
+    trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
     }
 
-    delete[] pBuffers;
-  }
-
-  return vReturn;
-}
+    vector<string> vTokens = {fileName};
+    istringstream iss(line);
+    for (string token; iss >> token;) {
+      vTokens.push_back(token);
+    }
 
-template <typename T>
-bool printResult(const T& t, const cl_int& err) {
-  cout << ((t == NULL) ? lexical_cast::write(err) : "OK") << endl;
-  return t == NULL;
-}
+    vector<char*> vArgv;
+    for (auto& token : vTokens) {
+      vArgv.push_back(&token[0]);
+    }
 
-bool printResult(const cl_int err) {
-  cout << ((err != CL_SUCCESS) ? lexical_cast::write(err) : "OK") << endl;
-  return err != CL_SUCCESS;
-}
+    Engine::Job job = base;
+    ModeArgs modeArgs;
+    string lineC3Addr = c3Addr;
+    string lineC3ProxyHash = c3ProxyHash;
+    string lineC2Addr = c2Addr;
+    unsigned int scoreMin = 0;
+    job.size = 0;
+    job.fileName.clear();
+    job.jobId = base.jobId + vJobs.size();
+
+    ArgParser argp(static_cast<int>(vArgv.size()), vArgv.data());
+    argp.addSwitch("d3", "c3-deployer", lineC3Addr);
+    argp.addSwitch("c3", "c3-proxy-hash", lineC3ProxyHash);
+    argp.addSwitch("d", "deployer", lineC2Addr);
+    argp.addSwitch("ms", "min-score", scoreMin);
+    argp.addSwitch("S", "size", job.size);
+    argp.addSwitch("f", "file", job.fileName);
+    argp.addSwitch("j", "job-id", job.jobId);
+    argp.addSwitch("jw", "weight", job.weight);
+    argp.addSwitch("jp", "priority", job.priority);
+    argp.addSwitch("jr", "rounds", job.rounds);
+    modeArgs.add(argp);
+
+    if (!argp.parse() || !modeArgs.select(job.m, scoreMin)) {
+      throw runtime_error("bad switches or no mode on line " + lexical_cast::write(lineNumber) + " of " + fileName);
+    }
 
-string keccakDigest(const string data) {
-  char digest[32];
-  sha3(data.c_str(), data.size(), digest, 32);
-  return string(digest, 32);
-}
+    if (modeArgs.constraint().enabled() && modeArgs.constraint().str() != base.constraint.str()) {
+      throw runtime_error("jobs share the constraint given on the command line, the kernel is built with it");
+    }
 
-void trim(string& s) {
-  const auto iLeft = s.find_first_not_of(" \t\r\n");
-  if (iLeft != string::npos) {
-    s.erase(0, iLeft);
-  }
+    job.pattern = modeArgs.pattern();
+    if (job.pattern.enabled()) {
+      if (!strPattern.empty() && strPattern != job.pattern.str()) {
+        throw runtime_error("jobs can only use one pattern, the kernel is built with it");
+      }
+      strPattern = job.pattern.str();
+    }
 
-  const auto iRight = s.find_last_not_of(" \t\r\n");
-  if (iRight != string::npos) {
-    const auto count = s.length() - iRight - 1;
-    s.erase(iRight + 1, count);
-  }
-}
+    job.weights = modeArgs.weights();
+    if (job.weights.enabled()) {
+      if (weights.enabled() && weights.str() != job.weights.str()) {
+        throw runtime_error("jobs can only use one set of weights, the kernel is built with it");
+      }
+      weights = job.weights;
+    }
 
-string makePreprocessorInitHashExpression(const char* c3Addr, const string& c2AddrBinary, const char* c3ProxyHash) {
-  random_device rd;
-  mt19937_64 eng(rd());
-  uniform_int_distribution<unsigned int> distr;  // C++ requires integer type: "C2338	note : char, signed char, unsigned char, int8_t, and uint8_t are not allowed"
-  ethhash h = {{0}};
+    if (job.weight == 0) {
+      throw runtime_error("the weight on line " + lexical_cast::write(lineNumber) + " of " + fileName + " must be at least 1");
+    }
+    bSchedule = bSchedule || job.weight != base.weight || job.priority != base.priority || job.rounds != base.rounds;
 
-  h.b[0] = 0xff;
-  for (int i = 0; i < 20; ++i) {
-    h.b[i + 1] = c3Addr[i];
-  }
+    job.scoreMin = scoreMin;
+    job.initHash = Engine::makeInitHash(lineC3Addr, lineC3ProxyHash, lineC2Addr, job.saltTemplate);
+    if (job.fileName.empty()) {
+      job.fileName = string(magic_enum::enum_name(job.m.function)) + "-" + to_string(job.jobId) + ".txt";
+    }
 
-  for (int i = 0; i < 16; ++i) {
-    h.b[i + 21] = distr(eng);
-  }
-  for (int i = 16; i < 32; ++i) {
-    h.b[i + 21] = c2AddrBinary[i - 12];
+    vJobs.push_back(job);
   }
 
-  for (int i = 0; i < 32; ++i) {
-    h.b[i + 53] = c3ProxyHash[i];
+  if (vJobs.empty()) {
+    throw runtime_error("no jobs in " + fileName);
   }
 
-  h.b[85] ^= 0x01;
-
-  ostringstream oss;
-  oss << hex;
-  for (int i = 0; i < 25; ++i) {
-    oss << "0x" << h.q[i];
-    if (i + 1 != 25) {
-      oss << ",";
-    }
+  const Pattern pattern = strPattern.empty() ? Pattern() : Pattern::parse(strPattern);
+  for (auto& job : vJobs) {
+    job.size = job.size != 0 ? job.size : bSchedule ? base.size : max<size_t>(base.size / vJobs.size(), 1);
+    job.schedule = bSchedule;
+    job.pattern = pattern;
+    job.weights = weights;
   }
 
-  return oss.str();
-}
-
-const char* hexStringToConstChar(const string& hex) {
-  size_t length = hex.length();
-  char* charArray = new char[length / 2 + 1];
-  for (size_t i = 0; i < length; i += 2) {
-    string byteString = hex.substr(i, 2);
-    char byte = (char)strtol(byteString.c_str(), nullptr, 16);
-    charArray[i / 2] = byte;
-  }
-  charArray[length / 2] = '\0';
-  return charArray;
+  return vJobs;
 }
 
 int main(int argc, char** argv) {
   try {
     ArgParser argp(argc, argv);
     bool bHelp = false;
-    bool bModeBenchmark = false;
-    bool bModeZeroBytes = false;
-    bool bModeZeros = false;
-    bool bModeLetters = false;
-    bool bModeNumbers = false;
-    string strModeLeading;
-    string strModeMatching;
-    string strModeLeadingMatch;
-    string strModeTrailing;
+    ModeArgs modeArgs;
     string fileName;
-    bool bModeLeadingRange = false;
-    bool bModeRange = false;
-    bool bModeMirror = false;
-    bool bModeDoubles = false;
-    bool allLeading = false;
-    bool allLeadingTrailing = false;
-    string leadingTrailing;
-    int scoreAll = 0;
-    int rangeMin = 0;
-    int rangeMax = 0;
+    string storeFileName;
+    unsigned long long jobId = 0;
     uint scoreMin = 0;
     vector<size_t> vDeviceSkipIndex;
     size_t worksizeLocal = 128;
     size_t worksizeMax = 0;  // Will be automatically determined later if not overriden by user
     size_t size = 16777216;
+    unsigned short metricsPort = 0;
+    string traceFileName;
+    string verifyFileName;
+    string jobsFileName;
+    bool bEstimate = false;
+    double estimateSpeed = 0;
+    string strKeccak = "auto";
+    unsigned int retries = 3;
+    cl_uint workerId = 0;
+    bool bNoCache = false;
+    string exportFileName;
+    cl_ulong exportRounds = 0;
+    bool bSchedule = false;
+    string strSaltTemplate;
+    string strGuard;
     string c2Addr;
     string c3ProxyHash = "21c35dbe1b344a2488cf3321d6ce542f8e9f305544ff09e4993a62319a497c1f";
     string c3Addr = "00000000000029398fcE86f09FF8453c8D0Cd60D";
@@ -229,35 +263,35 @@ int main(int argc, char** argv) {
     argp.addSwitch("f", "file", fileName);
 
     argp.addSwitch("h", "help", bHelp);
-    argp.addSwitch("b", "benchmark", bModeBenchmark);
-    argp.addSwitch("z", "zero-bytes", bModeZeroBytes);
-    argp.addSwitch("Z", "zeros", bModeZeros);
-    argp.addSwitch("L", "letters", bModeLetters);
-    argp.addSwitch("n", "numbers", bModeNumbers);
-    argp.addSwitch("l", "leading", strModeLeading);
-    argp.addSwitch("x", "matching", strModeMatching);
-    argp.addSwitch("lr", "leading-range", bModeLeadingRange);
-    argp.addSwitch("r", "range", bModeRange);
-    argp.addSwitch("mr", "mirror", bModeMirror);
-    argp.addSwitch("ld", "leading-doubles", bModeDoubles);
-    argp.addSwitch("lx", "leading-match", strModeLeadingMatch);
-    argp.addSwitch("lt", "leading-trailing", leadingTrailing);
-    argp.addSwitch("t", "trailing", strModeTrailing);
-    argp.addSwitch("a", "all", scoreAll);
-    argp.addSwitch("al", "all-leading", allLeading);
-    argp.addSwitch("alt", "all-leading-trailing", allLeadingTrailing);
-    argp.addSwitch("m", "min", rangeMin);
-    argp.addSwitch("M", "max", rangeMax);
+    argp.addSwitch("sf", "store", storeFileName);
+    argp.addSwitch("j", "job-id", jobId);
+    modeArgs.add(argp);
 
     argp.addMultiSwitch('s', "skip", vDeviceSkipIndex);
     argp.addSwitch("w", "work", worksizeLocal);
     argp.addSwitch("W", "work-max", worksizeMax);
     argp.addSwitch("S", "size", size);
+    argp.addSwitch("k", "keccak", strKeccak);
+    argp.addSwitch("R", "retries", retries);
+    argp.addSwitch("wi", "worker-id", workerId);
+    argp.addSwitch("n", "no-cache", bNoCache);
+    argp.addSwitch("mp", "metrics", metricsPort);
+    argp.addSwitch("tr", "trace", traceFileName);
+    argp.addSwitch("v", "verify", verifyFileName);
+    argp.addSwitch("J", "jobs", jobsFileName);
+    argp.addSwitch("sc", "schedule", bSchedule);
+    argp.addSwitch("e", "estimate", bEstimate);
+    argp.addSwitch("es", "estimate-speed", estimateSpeed);
+    argp.addSwitch("X", "export", exportFileName);
+    argp.addSwitch("Xr", "export-rounds", exportRounds);
 
     argp.addSwitch("d", "deployer", c2Addr);
     argp.addSwitch("I", "init-code", strInitCode);
     argp.addSwitch("i", "init-code-file", strInitCodeFile);
 
+    argp.addSwitch("st", "salt-template", strSaltTemplate);
+    argp.addSwitch("g", "guard", strGuard);
+
     argp.addSwitch("c3", "c3-proxy-hash", c3ProxyHash);  // create2 PROXY_CHILD_BYTECODE hash
     argp.addSwitch("d3", "c3-deployer", c3Addr);         // create3 deployer address
 
@@ -271,6 +305,14 @@ int main(int argc, char** argv) {
       return 0;
     }
 
+    // The feed owns stdout, everything else goes to stderr and a closed reader ends the export instead of the process
+    if (exportFileName == "-") {
+      cout.rdbuf(cerr.rdbuf());
+#ifndef _WIN32
+      signal(SIGPIPE, SIG_IGN);
+#endif
+    }
+
     // Parse hexadecimal values and/or read init code from file
     if (strInitCodeFile != "") {
       ifstream ifs(strInitCodeFile);
@@ -282,156 +324,140 @@ int main(int argc, char** argv) {
     }
 
     trim(strInitCode);
-    const string c2AddrBinary = keccakDigest(parseHexadecimalBytes(c2Addr)).substr(12);
     const string strInitCodeDigest = keccakDigest(parseHexadecimalBytes(strInitCode));
-    const char* c3Addr_chars = hexStringToConstChar(c3Addr);
-    const char* c3ProxyHash_chars = hexStringToConstChar(c3ProxyHash);
-    const string strPreprocessorInitStructure = makePreprocessorInitHashExpression(c3Addr_chars, c2AddrBinary, c3ProxyHash_chars);
+    const Guard guard = strGuard.empty() ? Guard() : Guard::parse(strGuard);
+    const SaltTemplate saltTemplate = guard.saltTemplate(strSaltTemplate.empty() ? SaltTemplate() : SaltTemplate::parse(strSaltTemplate));
+    const ethhash initHash = Engine::makeInitHash(c3Addr, c3ProxyHash, c2Addr, saltTemplate);
 
     mode mode = ModeFactory::benchmark();
-    if (bModeBenchmark) {
-      mode = ModeFactory::benchmark();
-    } else if (bModeZeroBytes) {
-      mode = ModeFactory::zerobytes();
-    } else if (bModeZeros) {
-      mode = ModeFactory::zeros();
-    } else if (bModeLetters) {
-      mode = ModeFactory::letters();
-    } else if (bModeNumbers) {
-      mode = ModeFactory::numbers();
-    } else if (!strModeLeading.empty()) {
-      if (scoreMin == 0) scoreMin = 2;
-      mode = ModeFactory::leading(strModeLeading.front());
-    } else if (!strModeTrailing.empty()) {
-      mode = ModeFactory::trailing(strModeTrailing.back());
-    } else if (!strModeLeadingMatch.empty()) {
-      if (scoreMin == 0) scoreMin = 2;
-      mode = ModeFactory::matchLeading(strModeLeadingMatch);
-    } else if (!strModeMatching.empty()) {
-      mode = ModeFactory::matching(strModeMatching);
-    } else if (bModeLeadingRange) {
-      mode = ModeFactory::leadingRange(rangeMin, rangeMax);
-    } else if (bModeRange) {
-      mode = ModeFactory::range(rangeMin, rangeMax);
-    } else if (bModeMirror) {
-      mode = ModeFactory::mirror();
-    } else if (bModeDoubles) {
-      mode = ModeFactory::doubles();
-    } else if (scoreAll > 0) {
-      mode = ModeFactory::all(scoreAll);
-    } else if (allLeading) {
-      mode = ModeFactory::allLeading();
-    } else if (!leadingTrailing.empty() || allLeadingTrailing) {
-      mode = ModeFactory::allLeadingTrailing(leadingTrailing);
-    } else {
+    const bool bModeGiven = modeArgs.select(mode, scoreMin);
+    const Pattern pattern = modeArgs.pattern();
+    const Weights weights = modeArgs.weights();
+    const Constraint constraint = modeArgs.constraint();
+    if (!bModeGiven && verifyFileName.empty() && jobsFileName.empty() && exportFileName.empty()) {
       cout << g_strHelp << endl;
       return 0;
     }
 
-    if (scoreMin == 0) scoreMin = 6;
-
-    if (fileName.empty()) {
-      fileName = string(magic_enum::enum_name(mode.function)) + "-" + to_string(chrono::steady_clock::now().time_since_epoch().count()) + ".txt";
-    }
-
-    const config cfg{fileName, scoreMin, std::chrono::steady_clock::now()};
-    cout << "Output file: " << cfg.fileName << " | Min score:" << cfg.scoreMin << endl;
-
-    vector<cl_device_id> vFoundDevices = getAllDevices();
-    vector<cl_device_id> vDevices;
-    map<cl_device_id, size_t> mDeviceIndex;
-
-    vector<string> vDeviceBinary;
-    vector<size_t> vDeviceBinarySize;
-    cl_int errorCode;
-
-    cout << "Devices:" << endl;
-    for (size_t i = 0; i < vFoundDevices.size(); ++i) {
-      // Ignore devices in skip index
-      if (find(vDeviceSkipIndex.begin(), vDeviceSkipIndex.end(), i) != vDeviceSkipIndex.end()) {
-        continue;
+    // Re-check a results file instead of searching, scores are checked too if a mode was given
+    if (!verifyFileName.empty()) {
+      vector<string> vFailed;
+      const size_t count = Verifier::verifyFile(verifyFileName, initHash, !bModeGiven || mode.function == ModeFunction::Benchmark ? NULL : &mode, pattern, weights, constraint, guard, vFailed);
+      for (auto& line : vFailed) {
+        cout << "FAIL " << line << endl;
       }
 
-      cl_device_id& deviceId = vFoundDevices[i];
-
-      const auto strName = clGetWrapperString(clGetDeviceInfo, deviceId, CL_DEVICE_NAME);
-      const auto computeUnits = clGetWrapper<cl_uint>(clGetDeviceInfo, deviceId, CL_DEVICE_MAX_COMPUTE_UNITS);
-      const auto globalMemSize = clGetWrapper<cl_ulong>(clGetDeviceInfo, deviceId, CL_DEVICE_GLOBAL_MEM_SIZE);
-
-      cout << "  GPU" << i << ": " << strName << ", " << globalMemSize << " bytes available, " << computeUnits << " compute units" << endl;
-      vDevices.push_back(vFoundDevices[i]);
-      mDeviceIndex[vFoundDevices[i]] = i;
+      cout << "Verified " << count << " results, " << vFailed.size() << " failed" << endl;
+      return vFailed.empty() ? 0 : 1;
     }
 
-    if (vDevices.empty()) {
-      return 1;
+    if (fileName.empty() && jobsFileName.empty() && exportFileName.empty()) {
+      fileName = string(magic_enum::enum_name(mode.function)) + "-" + to_string(chrono::steady_clock::now().time_since_epoch().count()) + ".txt";
     }
 
-    cout << endl;
-    cout << "Initializing OpenCL..." << endl;
-    cout << "  Creating context..." << flush;
-    auto clContext = clCreateContext(NULL, vDevices.size(), vDevices.data(), NULL, NULL, &errorCode);
-    if (printResult(clContext, errorCode)) {
-      return 1;
+    Engine::Job job;
+    job.m = mode;
+    job.initHash = initHash;
+    job.saltTemplate = saltTemplate;
+    job.pattern = pattern;
+    job.weights = weights;
+    job.constraint = constraint;
+    job.guard = guard;
+    job.scoreMin = scoreMin;
+    job.vDeviceSkipIndex = vDeviceSkipIndex;
+    job.worksizeLocal = worksizeLocal;
+    job.worksizeMax = worksizeMax;
+    job.size = size;
+    job.fileName = fileName;
+    job.storeFileName = storeFileName;
+    job.jobId = jobId != 0 ? jobId : chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+    job.traceFileName = traceFileName;
+    job.profiling = metricsPort != 0;
+    job.keccak = parseKeccakVariant(strKeccak);
+    job.retries = retries;
+    job.workerId = workerId;
+    job.spirv = !bNoCache;
+    job.exportFileName = exportFileName;
+    job.exportRounds = exportRounds;
+    job.schedule = bSchedule;
+
+    // Plan instead of searching, at a given speed or the one measured on the devices
+    if (bEstimate) {
+      const Estimator estimator(mode, pattern, weights, constraint);
+      printEstimate(estimator, scoreMin, estimateSpeed > 0 ? estimateSpeed : measureSpeed(job));
+      return 0;
     }
 
-    cl_program clProgram;
-    if (vDeviceBinary.size() == vDevices.size()) {
-      // Create program from binaries
-      cout << "  Loading kernel from binary..." << flush;
-      const unsigned char** pKernels = new const unsigned char*[vDevices.size()];
-      for (size_t i = 0; i < vDeviceBinary.size(); ++i) {
-        pKernels[i] = reinterpret_cast<const unsigned char*>(vDeviceBinary[i].data());
-      }
-
-      cl_int* pStatus = new cl_int[vDevices.size()];
-
-      clProgram = clCreateProgramWithBinary(clContext, vDevices.size(), vDevices.data(), vDeviceBinarySize.data(), pKernels, pStatus, &errorCode);
-      if (printResult(clProgram, errorCode)) {
-        return 1;
-      }
+    const vector<Engine::Job> vJobs = jobsFileName.empty() ? vector<Engine::Job>{job} : readJobs(jobsFileName, job, c3Addr, c3ProxyHash, c2Addr);
+    if (!exportFileName.empty()) {
+      cout << "Export: " << (exportFileName == "-" ? "stdout" : exportFileName) << (exportRounds != 0 ? " | Rounds: " + to_string(exportRounds) : "") << endl;
+    } else if (jobsFileName.empty()) {
+      cout << "Output file: " << job.fileName << " | Min score:" << job.scoreMin << endl;
     } else {
-      // Create a program from the kernel source
-      cout << "  Compiling kernel..." << flush;
-      const string strKeccak = readFile("keccak.cl");
-      const string strVanity = readFile("eradicate2.cl");
-      const char* szKernels[] = {strKeccak.c_str(), strVanity.c_str()};
-
-      clProgram = clCreateProgramWithSource(clContext, sizeof(szKernels) / sizeof(char*), szKernels, NULL, &errorCode);
-      if (printResult(clProgram, errorCode)) {
-        return 1;
+      for (auto& j : vJobs) {
+        cout << "Job " << j.jobId << ": " << magic_enum::enum_name(j.m.function) << " | Size: " << j.size << " | Output file: " << j.fileName << " | Min score:" << j.scoreMin;
+        if (j.schedule) {
+          cout << " | Weight: " << j.weight << " | Priority: " << j.priority << (j.rounds != 0 ? " | Rounds: " + to_string(j.rounds) : "");
+        }
+        cout << endl;
       }
     }
+    if (!job.storeFileName.empty()) {
+      cout << "Result store: " << job.storeFileName << (jobsFileName.empty() ? " | Job id: " + to_string(job.jobId) : "") << endl;
+    }
+    if (vJobs.front().pattern.enabled()) {
+      cout << "Pattern: " << vJobs.front().pattern.str() << " (" << vJobs.front().pattern.maxScore() << " fixed characters)" << endl;
+    }
+    if (vJobs.front().weights.enabled()) {
+      cout << "Weights: " << vJobs.front().weights.str() << endl;
+    }
+    if (constraint.enabled()) {
+      cout << "Constraint: " << constraint.str() << " (" << constraint.bits() << " fixed bits)" << endl;
+    }
+    if (guard.enabled()) {
+      cout << "Guard: " << guard.str() << endl;
+    }
+    if (saltTemplate.enabled()) {
+      cout << "Salt template: " << saltTemplate.str() << " (" << saltTemplate.freeBytes() << " free bytes)" << endl;
+    }
+    if (workerId != 0) {
+      cout << "Worker id: " << workerId << endl;
+    }
 
-    // Build the program
-    cout << "  Building program..." << flush;
-
-    const string strBuildOptions = "-D ERADICATE2_MAX_SCORE=" + lexical_cast::write(ERADICATE2_MAX_SCORE) + " -D ERADICATE2_INITHASH=" + strPreprocessorInitStructure;
-    if (printResult(clBuildProgram(clProgram, vDevices.size(), vDevices.data(), strBuildOptions.c_str(), NULL, NULL))) {
-#ifdef ERADICATE2_DEBUG
-      cout << endl;
-      cout << "build log:" << endl;
+    // Every verified result goes to the file, only new best scores of each job are printed
+    const auto timeStart = chrono::steady_clock::now();
+    mutex mutexPrint;
+    vector<cl_uchar> vScoreBest(vJobs.size(), 0);
+
+    Dispatcher::Callbacks callbacks;
+    callbacks.onHit = [&](const Hit& h) {
+      lock_guard<mutex> lock(mutexPrint);
+      if (h.score > vScoreBest[h.jobIndex]) {
+        vScoreBest[h.jobIndex] = h.score;
+        printResult(h.r, h.score, timeStart, vJobs.size() > 1 ? to_string(h.jobId) : "");
+      }
+    };
 
-      size_t sizeLog;
-      clGetProgramBuildInfo(clProgram, vDevices[0], CL_PROGRAM_BUILD_LOG, 0, NULL, &sizeLog);
-      char* const szLog = new char[sizeLog];
-      clGetProgramBuildInfo(clProgram, vDevices[0], CL_PROGRAM_BUILD_LOG, sizeLog, szLog, NULL);
+    callbacks.onSpeed = [&](const Speed::Snapshot& s) {
+      lock_guard<mutex> lock(mutexPrint);
+      cout << strVT100ClearLine << "Speed: " << Speed::format(s.total) << "\r" << flush;
+    };
 
-      cout << szLog << endl;
-      delete[] szLog;
-#endif
-      return 1;
-    }
+    callbacks.onLog = [&](const string& s) {
+      lock_guard<mutex> lock(mutexPrint);
+      cout << strVT100ClearLine << s << endl;
+    };
 
-    cout << endl;
+    Engine engine(vJobs, callbacks);
 
-    Dispatcher d(clContext, clProgram, worksizeMax == 0 ? size : worksizeMax, size, cfg);
-    for (auto& i : vDevices) {
-      d.addDevice(i, worksizeLocal, mDeviceIndex[i]);
+    MetricsServer* pMetrics = NULL;
+    if (metricsPort != 0) {
+      pMetrics = new MetricsServer(metricsPort, [&engine] { return engine.metrics(); });
+      cout << "Metrics: http://127.0.0.1:" << metricsPort << "/metrics" << endl;
     }
 
-    d.run(mode);
-    clReleaseContext(clContext);
+    engine.run();
+    delete pMetrics;
     return 0;
   } catch (runtime_error& e) {
     cout << "runtime_error - " << e.what() << endl;
@@ -28,6 +28,25 @@ usage: ./ERADICATE2 [OPTIONS]
   Modes with arguments:
     --leading <single hex>  Score on hashes leading with given hex character.
     --matching <hex string> Score on hashes matching given hex string.
+    --pattern <pattern>     Score on hashes matching a pattern such as
+                            ^dead[0-9]{4}.*beef$
+    -wm, --weights <terms>  Score on a sum of weights per position and
+                            character plus run bonuses, such as
+                            0=1,^0=2,f$=2
+    -wf, --weights-file <file>
+                            Same, with terms or 40 rows of 16 weights
+                            read from file.
+
+  Constraint:
+    -ct, --constraint <mask:value>
+                            Only score addresses whose bits under mask equal
+                            value, both hex aligned to the end of the address,
+                            e.g. 0x3fff:0x0880 for hook flags.
+
+  Factory:
+    -g, --guard <profile>   Salts are for a factory that hashes them before
+                            deploying: createx, createx:<sender>,
+                            createx:<sender>:<chain id> or createx::<chain id>.
 
   Advanced modes:
     --leading-range         Scores on hashes leading with characters within
@@ -41,12 +60,51 @@ usage: ./ERADICATE2 [OPTIONS]
 
   Device control:
     -s, --skip <index>      Skip device given by index.
+    -R, --retries <count>   Retry a failed device this many times, waiting 1s
+                            and doubling the wait every time, before the
+                            other devices go on without it. [default = 3]
+    -wi, --worker-id <id>   Unique id of this machine among those searching
+                            for the same deployer, keeps their salts apart.
+                            [default = 0]
+    -n, --no-cache          Compile the kernels from source even when the
+                            embedded SPIR-V could be used.
+
+  Jobs:
+    -J, --jobs <file>       Run the searches in file together, one per line
+                            given as -d3 <deployer> [-c3 <proxy hash>]
+                            [-d <deployer>] <mode> [-ms <score>] [-S <size>]
+                            [-f <file>] [-j <job id>] [-jw <weight>]
+                            [-jp <priority>] [-jr <rounds>].
+    -sc, --schedule         Run one job per round instead of all of them in
+                            every launch. Jobs get rounds in proportion to
+                            their -jw weight [default = 1], higher -jp
+                            priorities [default = 0] run first and a job
+                            with -jr stops after that many rounds. Any of
+                            these on a line also schedules the jobs.
+
+  Export:
+    -X, --export <file>     Stream every address to file instead of scoring,
+                            - for stdout. No mode is needed.
+    -Xr, --export-rounds <n>
+                            Rounds every device exports. [default = 0,
+                            until stopped]
+
+  Planning:
+    -e, --estimate          Print the chance, expected time and the time 10%
+                            to 90% of searches take for every score above the
+                            minimum score instead of searching.
+    -es, --estimate-speed <hashes per second>
+                            Speed to plan with. [default = measured on the
+                            devices for 5 seconds]
 
   Tweaking:
     -w, --work <size>       Set OpenCL local work size. [default = 64]
     -W, --work-max <size>   Set OpenCL maximum work size. [default = -i * -I]
     -S, --size <size>       Set number of salts tried per loop.
                             [default = 16777216]
+    -k, --keccak <variant>  Keccak-f implementation, 64 for ulong lanes, 32
+                            for interleaved uint halves or auto to measure
+                            both on every device. [default = auto]
 
   Examples:
     ./ERADICATE2 -A 0x00000000000000000000000000000000deadbeef -I 0x00 --leading 0
@@ -1,5 +1,7 @@
 #include "hexadecimal.hpp"
 
+#include <iomanip>
+#include <sstream>
 #include <stdexcept>
 
 std::string toHex(const uint8_t *const s, const size_t len) {
@@ -16,6 +18,12 @@ std::string toHex(const uint8_t *const s, const size_t len) {
   return r;
 }
 
+std::string hex64(const uint64_t x) {
+  std::ostringstream oss;
+  oss << "0x" << std::hex << std::setw(16) << std::setfill('0') << x << "UL";
+  return oss.str();
+}
+
 std::string::size_type hexValueNoException(char c) {
   if (c >= 'A' && c <= 'F') {
     c -= 'A' - 'a';
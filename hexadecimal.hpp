@@ -6,6 +6,7 @@
 #include <string>
 
 std::string toHex(const uint8_t* const s, const size_t len);
+std::string hex64(const uint64_t x);  // OpenCL C literal, 0x0123456789abcdefUL
 std::string::size_type hexValueNoException(char c);
 std::string::size_type hexValue(char c);
 std::string parseHexadecimalBytes(std::string o);
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "ArgParser.hpp"
+#include "Dispatcher.hpp"
+#include "ModeFactory.hpp"
+#include "Reference.hpp"
+#include "SaltTemplate.hpp"
+#include "clmock.hpp"
+#include "clutil.hpp"
+#include "hexadecimal.hpp"
+
+using namespace std;
+
+/* The most the host side of a search can sustain, measured without a device.
+ * The Dispatcher runs against the mock OpenCL platform of clmock.cpp, whose
+ * kernels finish at once, so every round is nothing but the callback's work:
+ * scanning the results, pushing them to the verifier, Speed::update() and
+ * launching the next round, plus what verifying, writing and printing the
+ * results costs the other threads. Rounds per second is then the ceiling on
+ * the rounds the devices can be kept busy with, at any size, and rounds per
+ * second times the size the hash rate the host would start holding back.
+ *
+ * Every launch reports fresh results at the given number of scores for every
+ * job, as if the kernel kept finding new ones. They're real addresses of salts
+ * drawn ahead of time, so they verify, and once the pool runs out of a score
+ * they come round again and are counted as repeats. A verify backlog that
+ * grows means the verifier falls behind, only the hits it handles count.
+ *
+ * With --schedule the jobs take turns by round instead, job i with weight i + 1,
+ * and every job's share of the salts is reported next to the share it's meant
+ * to get, see Scheduler.
+ *
+ * usage: ./ERADICATE2-hostbench.x64 [-o file] [-t seconds] [-S size] [-d devices] [-H hits] [-J jobs] [-p pool] [-f file] [-sf store] [--zero-copy] [--schedule] [--seed n]
+ */
+
+// Salts and addresses scored by the benchmark's mode, by score
+static vector<vector<result>> makePool(const ethhash& init, const mode& m, const size_t size, const unsigned long long seed) {
+  vector<vector<result>> vPool(ERADICATE2_MAX_SCORE + 1);
+  mt19937_64 rng(seed);
+  for (size_t i = 0; i < size; ++i) {
+    result r;
+    for (size_t j = 0; j < 32; j += 8) {
+      const cl_ulong x = rng();
+      memcpy(r.salt + j, &x, 8);
+    }
+
+    Reference::address(init.b + 1, r.salt, init.b + 53, r.hash);
+    r.found = 0;
+    vPool[Reference::score(m, r.hash)].push_back(r);
+  }
+
+  return vPool;
+}
+
+// Sum of a metric over all its labels in Dispatcher::metrics()
+static double metric(const string& strMetrics, const string& name) {
+  double sum = 0;
+  istringstream iss(strMetrics);
+  for (string line; getline(iss, line);) {
+    if (line.compare(0, name.size(), name) == 0 && line.size() > name.size() && (line[name.size()] == ' ' || line[name.size()] == '{')) {
+      sum += stod(line.substr(line.rfind(' ') + 1));
+    }
+  }
+
+  return sum;
+}
+
+int main(int argc, char** argv) {
+  try {
+    string outputFileName;
+    double seconds = 5;
+    size_t size = 65536;
+    size_t devices = 1;
+    size_t hits = 8;
+    size_t jobs = 1;
+    size_t poolSize = 65536;
+    string fileName;
+    string storeFileName;
+    bool bZeroCopy = false;
+    bool bSchedule = false;
+    unsigned long long seed = 1;
+
+    ArgParser argp(argc, argv);
+    argp.addSwitch("o", "output", outputFileName);
+    argp.addSwitch("t", "seconds", seconds);
+    argp.addSwitch("S", "size", size);
+    argp.addSwitch("d", "devices", devices);
+    argp.addSwitch("H", "hits", hits);
+    argp.addSwitch("J", "jobs", jobs);
+    argp.addSwitch("p", "pool", poolSize);
+    argp.addSwitch("f", "file", fileName);
+    argp.addSwitch("sf", "store", storeFileName);
+    argp.addSwitch("z", "zero-copy", bZeroCopy);
+    argp.addSwitch("sc", "schedule", bSchedule);
+    argp.addSwitch("seed", "seed", seed);
+
+    if (!argp.parse() || seconds <= 0 || size < jobs || devices == 0 || jobs == 0 || poolSize == 0) {
+      cout << "usage: ./ERADICATE2-hostbench.x64 [-o file] [-t seconds] [-S size] [-d devices] [-H hits] [-J jobs] [-p pool] [-f file] [-sf store] [--zero-copy] [--schedule] [--seed n]" << endl;
+      return 1;
+    }
+
+    // Digits score anywhere from about 15 to 35, plenty of distinct scores to put results at
+    const mode m = ModeFactory::range(0, 9);
+    const string c3Addr = "00000000000029398fcE86f09FF8453c8D0Cd60D";
+    const string c3ProxyHash = "21c35dbe1b344a2488cf3321d6ce542f8e9f305544ff09e4993a62319a497c1f";
+    const ethhash init = makeInitHash(hexStringToConstChar(c3Addr), string(20, '\0'), hexStringToConstChar(c3ProxyHash), seed);
+
+    cerr << "Scoring a pool of " << poolSize << " addresses..." << endl;
+    const vector<vector<result>> vPool = makePool(init, m, poolSize, seed);
+
+    // The scores with the most addresses, so results take longest to come round again
+    vector<cl_uchar> vScores;
+    for (size_t i = ERADICATE2_MIN_SCORE; i < vPool.size(); ++i) {
+      if (!vPool[i].empty()) {
+        vScores.push_back(static_cast<cl_uchar>(i));
+      }
+    }
+
+    if (hits > vScores.size()) {
+      throw runtime_error("the pool has addresses at " + lexical_cast::write(vScores.size()) + " scores, hits can't be more");
+    }
+
+    stable_sort(vScores.begin(), vScores.end(), [&](const cl_uchar a, const cl_uchar b) { return vPool[a].size() > vPool[b].size(); });
+    vScores.resize(hits);
+
+    // Plays eradicate2_iterate and eradicate2_iterate_jobs. A round split by the maximum work size is played by
+    // its first launch, and so is a job by the launch its first salt is in, which is also how a scheduled round
+    // runs a single job.
+    atomic<size_t> cursors[ERADICATE2_MAX_SCORE + 1];
+    for (auto& c : cursors) {
+      c = 0;
+    }
+
+    mockSetup(devices, bZeroCopy, [&](const MockLaunch& l) {
+      const bool bJobs = l.kernel == "eradicate2_iterate_jobs";
+      const cl_uint count = bJobs ? l.arg<cl_uint>(2) : 1;
+      result* const pResults = l.buffer<result>(0);
+      for (cl_uint j = 0; j < count; ++j) {
+        const size_t begin = bJobs ? l.buffer<job>(1)[j].begin : 0;
+        if (begin < l.offset || begin >= l.offset + l.size) {
+          continue;
+        }
+
+        const cl_uchar scoreMax = bJobs ? l.buffer<job>(1)[j].scoreMax : l.arg<cl_uchar>(2);
+        for (auto score : vScores) {
+          if (score <= scoreMax) {
+            continue;
+          }
+
+          result& r = pResults[j * (ERADICATE2_MAX_SCORE + 1) + score];
+          const cl_uint found = r.found;
+          r = vPool[score][cursors[score]++ % vPool[score].size()];
+          r.found = found + 1;
+        }
+      }
+    });
+
+    // Results are handled like eradicate2 does, printing goes to a string instead of the terminal
+    const auto timeStart = chrono::steady_clock::now();
+    mutex mutexPrint;
+    vector<cl_uchar> vScoreBest(jobs, 0);
+    atomic<unsigned long long> printed(0);
+
+    Dispatcher::Callbacks callbacks;
+    callbacks.onHit = [&](const Hit& h) {
+      lock_guard<mutex> lock(mutexPrint);
+      if (h.score > vScoreBest[h.jobIndex]) {
+        vScoreBest[h.jobIndex] = h.score;
+        const auto secondsRun = chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - timeStart).count();
+        ostringstream oss;
+        oss << "  Time: " << secondsRun << "s Score: " << (int)h.score << " Magic: 0x" << toHex(h.r.salt, 32) << " Address: 0x" << toHex(h.r.hash, 20) << endl;
+        printed += oss.str().size();
+      }
+    };
+
+    callbacks.onSpeed = [&](const Speed::Snapshot& s) {
+      lock_guard<mutex> lock(mutexPrint);
+      printed += Speed::format(s.total).size();
+    };
+
+    callbacks.onLog = [](const string& s) {
+      cerr << s << endl;
+    };
+
+    vector<cl_device_id> vDevices = getAllDevices(CL_DEVICE_TYPE_ALL);
+    cl_int errorCode;
+    cl_context clContext = clCreateContext(NULL, static_cast<cl_uint>(vDevices.size()), vDevices.data(), NULL, NULL, &errorCode);
+    cl_program clProgram = buildProgram(clContext, vDevices, "");
+
+    const config cfg{fileName, 0, timeStart, false, "", init, storeFileName, 0, 0, 1000, 0, SaltTemplate().roundMax(), bSchedule};
+    vector<Dispatcher::Job> vJobs;
+    for (size_t i = 0; i < jobs; ++i) {
+      vJobs.push_back(Dispatcher::Job{init, m, 0, size / jobs + (i < size % jobs ? 1 : 0), fileName, i, bSchedule ? static_cast<unsigned int>(i + 1) : 1, 0, 0});
+    }
+
+    string strMetricsStart, strMetricsEnd;
+    {
+      Dispatcher dispatcher(clContext, size, size, cfg, callbacks, jobs);
+      for (size_t i = 0; i < vDevices.size(); ++i) {
+        dispatcher.addDevice(vDevices[i], clProgram, 0, i);
+      }
+
+      exception_ptr pException;
+      thread t([&] {
+        try {
+          if (jobs == 1 && !bSchedule) {
+            dispatcher.run(m);
+          } else {
+            dispatcher.run(vJobs);
+          }
+        } catch (runtime_error&) {
+          pException = current_exception();
+        }
+      });
+
+      // The first fifth warms up, the rest is measured
+      cerr << "Running for " << seconds << " seconds..." << endl;
+      this_thread::sleep_for(chrono::duration<double>(seconds / 5));
+      strMetricsStart = dispatcher.metrics();
+      this_thread::sleep_for(chrono::duration<double>(seconds - seconds / 5));
+      strMetricsEnd = dispatcher.metrics();
+
+      dispatcher.stop();
+      t.join();
+      if (pException) {
+        rethrow_exception(pException);
+      }
+    }
+
+    clReleaseProgram(clProgram);
+    clReleaseContext(clContext);
+
+    const auto delta = [&](const string& name) { return metric(strMetricsEnd, name) - metric(strMetricsStart, name); };
+    const double secondsMeasured = seconds - seconds / 5;
+    const double rounds = delta("eradicate2_rounds_total");
+    const double verified = delta("eradicate2_verified_total");
+    const double repeats = delta("eradicate2_dedup_hits_total");
+
+    ostringstream oss;
+    oss << "{\"config\":{\"seconds\":" << seconds << ",\"size\":" << size << ",\"devices\":" << devices << ",\"hits\":" << hits << ",\"jobs\":" << jobs << ",\"pool\":" << poolSize;
+    oss << ",\"zero_copy\":" << (bZeroCopy ? "true" : "false") << ",\"schedule\":" << (bSchedule ? "true" : "false") << ",\"file\":" << (fileName.empty() ? "false" : "true") << ",\"store\":" << (storeFileName.empty() ? "false" : "true") << "}";
+    oss << ",\"rounds_per_second\":" << rounds / secondsMeasured;
+    oss << ",\"hashes_per_second\":" << (bSchedule ? delta("eradicate2_job_salts_total") : rounds * size) / secondsMeasured;
+    oss << ",\"hits_per_second\":" << (verified + repeats) / secondsMeasured;
+    oss << ",\"verified_per_second\":" << verified / secondsMeasured;
+    oss << ",\"repeats_per_second\":" << repeats / secondsMeasured;
+    oss << ",\"callback_us_per_round\":" << (rounds == 0 ? 0 : delta("eradicate2_callback_seconds_total") / rounds * 1e6);
+    oss << ",\"verify_backlog_per_second\":" << delta("eradicate2_verify_queue_depth") / secondsMeasured;
+    oss << ",\"mismatches\":" << metric(strMetricsEnd, "eradicate2_verify_mismatches_total");
+
+    // Rounds differ in size by job, shares are of the salts
+    if (bSchedule) {
+      const double salts = delta("eradicate2_job_salts_total");
+      oss << ",\"job_shares\":[";
+      for (size_t i = 0; i < jobs; ++i) {
+        const string label = "{job=\"" + lexical_cast::write(i) + "\"}";
+        oss << (i == 0 ? "" : ",") << "{\"weight\":" << vJobs[i].weight << ",\"target\":" << metric(strMetricsEnd, "eradicate2_job_share" + label);
+        oss << ",\"achieved\":" << (salts == 0 ? 0 : delta("eradicate2_job_salts_total" + label) / salts) << "}";
+      }
+      oss << "]";
+    }
+    oss << "}";
+
+    if (outputFileName.empty()) {
+      cout << oss.str() << endl;
+    } else {
+      ofstream(outputFileName) << oss.str() << endl;
+    }
+
+    return 0;
+  } catch (runtime_error& e) {
+    cout << "runtime_error - " << e.what() << endl;
+  }
+
+  return 1;
+}
@@ -97,6 +97,137 @@ __constant ulong keccakf_rndc[24] = {
 	0x8000000000008080, 0x0000000080000001, 0x8000000080008008
 };
 
+#ifdef ERADICATE2_KECCAK32
+/* Bit-interleaved Keccak-f for devices where 64-bit rotates are emulated with
+ * several 32-bit operations. Every lane is kept as two uints, e holding its even
+ * bits and o its odd bits, so rotating a lane by 2n rotates both halves by n and
+ * rotating by 2n + 1 also swaps them. Built instead of the ulong version above
+ * when ERADICATE2_KECCAK32 is defined, see keccakBuildOption().
+ */
+
+// Even bits of x to its low half and odd bits to its high half
+uint keccak_unshuffle(uint x) {
+	uint t;
+	t = (x ^ (x >> 1)) & 0x22222222; x ^= t ^ (t << 1);
+	t = (x ^ (x >> 2)) & 0x0c0c0c0c; x ^= t ^ (t << 2);
+	t = (x ^ (x >> 4)) & 0x00f000f0; x ^= t ^ (t << 4);
+	t = (x ^ (x >> 8)) & 0x0000ff00; x ^= t ^ (t << 8);
+	return x;
+}
+
+// Inverse of keccak_unshuffle
+uint keccak_shuffle(uint x) {
+	uint t;
+	t = (x ^ (x >> 8)) & 0x0000ff00; x ^= t ^ (t << 8);
+	t = (x ^ (x >> 4)) & 0x00f000f0; x ^= t ^ (t << 4);
+	t = (x ^ (x >> 2)) & 0x0c0c0c0c; x ^= t ^ (t << 2);
+	t = (x ^ (x >> 1)) & 0x22222222; x ^= t ^ (t << 1);
+	return x;
+}
+
+// (e1, o1) = (e0, o0) rotated by n as a 64-bit lane, n is a constant so the branch folds away
+#define ROTATE32(e1, o1, e0, o0, n) \
+{ \
+	if ((n) & 1) { \
+		e1 = rotate(o0, (uint)((n) / 2 + 1)); \
+		o1 = rotate(e0, (uint)((n) / 2)); \
+	} else { \
+		e1 = rotate(e0, (uint)((n) / 2)); \
+		o1 = rotate(o0, (uint)((n) / 2)); \
+	} \
+}
+
+#define TH32_COLUMN(x) \
+	ce##x = e[x] ^ e[x + 5] ^ e[x + 10] ^ e[x + 15] ^ e[x + 20]; \
+	co##x = o[x] ^ o[x + 5] ^ o[x + 10] ^ o[x + 15] ^ o[x + 20];
+
+#define TH32_APPLY(x, l, r) \
+	t0 = ce##l ^ rotate(co##r, (uint) 1); \
+	t1 = co##l ^ ce##r; \
+	e[x] ^= t0; e[x + 5] ^= t0; e[x + 10] ^= t0; e[x + 15] ^= t0; e[x + 20] ^= t0; \
+	o[x] ^= t1; o[x + 5] ^= t1; o[x + 10] ^= t1; o[x + 15] ^= t1; o[x + 20] ^= t1;
+
+#define THETA32() \
+{ \
+	TH32_COLUMN(0) TH32_COLUMN(1) TH32_COLUMN(2) TH32_COLUMN(3) TH32_COLUMN(4) \
+	TH32_APPLY(0, 4, 1) TH32_APPLY(1, 0, 2) TH32_APPLY(2, 1, 3) TH32_APPLY(3, 2, 4) TH32_APPLY(4, 3, 0) \
+}
+
+#define RHOPI32() \
+{ \
+	ROTATE32(t0, t1, e[1], o[1],  1); \
+	ROTATE32(e[1], o[1], e[6], o[6], 44); \
+	ROTATE32(e[6], o[6], e[9], o[9], 20); \
+	ROTATE32(e[9], o[9], e[22], o[22], 61); \
+	ROTATE32(e[22], o[22], e[14], o[14], 39); \
+	ROTATE32(e[14], o[14], e[20], o[20], 18); \
+	ROTATE32(e[20], o[20], e[2], o[2], 62); \
+	ROTATE32(e[2], o[2], e[12], o[12], 43); \
+	ROTATE32(e[12], o[12], e[13], o[13], 25); \
+	ROTATE32(e[13], o[13], e[19], o[19],  8); \
+	ROTATE32(e[19], o[19], e[23], o[23], 56); \
+	ROTATE32(e[23], o[23], e[15], o[15], 41); \
+	ROTATE32(e[15], o[15], e[4], o[4], 27); \
+	ROTATE32(e[4], o[4], e[24], o[24], 14); \
+	ROTATE32(e[24], o[24], e[21], o[21],  2); \
+	ROTATE32(e[21], o[21], e[8], o[8], 55); \
+	ROTATE32(e[8], o[8], e[16], o[16], 45); \
+	ROTATE32(e[16], o[16], e[5], o[5], 36); \
+	ROTATE32(e[5], o[5], e[3], o[3], 28); \
+	ROTATE32(e[3], o[3], e[18], o[18], 21); \
+	ROTATE32(e[18], o[18], e[17], o[17], 15); \
+	ROTATE32(e[17], o[17], e[11], o[11], 10); \
+	ROTATE32(e[11], o[11], e[7], o[7],  6); \
+	ROTATE32(e[7], o[7], e[10], o[10],  3); \
+	e[10] = t0; o[10] = t1; \
+}
+
+#define KH32_ROW(s, y) \
+	t0 = s[y]; t1 = s[y + 1]; s[y] ^= (~t1) & s[y + 2]; s[y + 1] ^= (~s[y + 2]) & s[y + 3]; s[y + 2] ^= (~s[y + 3]) & s[y + 4]; s[y + 3] ^= (~s[y + 4]) & t0; s[y + 4] ^= (~t0) & t1;
+
+#define KHI32() \
+{ \
+	KH32_ROW(e, 0) KH32_ROW(e, 5) KH32_ROW(e, 10) KH32_ROW(e, 15) KH32_ROW(e, 20) \
+	KH32_ROW(o, 0) KH32_ROW(o, 5) KH32_ROW(o, 10) KH32_ROW(o, 15) KH32_ROW(o, 20) \
+}
+
+// keccakf_rndc interleaved, even half then odd half
+__constant uint keccakf_rndc32[48] = {
+	0x00000001, 0x00000000, 0x00000000, 0x00000089, 0x00000000, 0x8000008b, 0x00000000, 0x80008080,
+	0x00000001, 0x0000008b, 0x00000001, 0x00008000, 0x00000001, 0x80008088, 0x00000001, 0x80000082,
+	0x00000000, 0x0000000b, 0x00000000, 0x0000000a, 0x00000001, 0x00008082, 0x00000000, 0x00008003,
+	0x00000001, 0x0000808b, 0x00000001, 0x8000000b, 0x00000001, 0x8000008a, 0x00000001, 0x80000081,
+	0x00000000, 0x80000081, 0x00000000, 0x80000008, 0x00000000, 0x00000083, 0x00000000, 0x80008003,
+	0x00000001, 0x80008088, 0x00000000, 0x80000088, 0x00000001, 0x00008000, 0x00000000, 0x80008082
+};
+
+void sha3_keccakf(ethhash * const h)
+{
+	h->d[33] ^= 0x80000000;
+	uint e[25], o[25];
+	uint t0, t1, ce0, ce1, ce2, ce3, ce4, co0, co1, co2, co3, co4;
+
+	for (int i = 0; i < 25; ++i) {
+		const uint lo = keccak_unshuffle(h->d[2 * i]);
+		const uint hi = keccak_unshuffle(h->d[2 * i + 1]);
+		e[i] = (lo & 0x0000ffff) | (hi << 16);
+		o[i] = (lo >> 16) | (hi & 0xffff0000);
+	}
+
+	for (int i = 0; i < 24; ++i) {
+		THETA32();
+		RHOPI32();
+		KHI32();
+		e[0] ^= keccakf_rndc32[2 * i];
+		o[0] ^= keccakf_rndc32[2 * i + 1];
+	}
+
+	for (int i = 0; i < 25; ++i) {
+		h->d[2 * i] = keccak_shuffle((e[i] & 0x0000ffff) | (o[i] << 16));
+		h->d[2 * i + 1] = keccak_shuffle((e[i] >> 16) | (o[i] & 0xffff0000));
+	}
+}
+#else
 // Barely a bottleneck. No need to tinker more.
 void sha3_keccakf(ethhash * const h)
 {
@@ -112,3 +243,4 @@ void sha3_keccakf(ethhash * const h)
 		IOTA(st[0], keccakf_rndc[i]);
 	}
 }
+#endif
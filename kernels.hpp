@@ -0,0 +1,21 @@
+#ifndef HPP_KERNELS
+#define HPP_KERNELS
+
+#include <cstddef>
+
+/* Kernel sources and their SPIR-V builds, embedded in kernels.cpp by the
+ * Makefile so the executables run from any directory. Data is always followed
+ * by a zero byte, sources can be used as C strings. The SPIR-V ones are empty
+ * unless `make spirv` built them before the executables.
+ */
+struct EmbeddedFile {
+  const unsigned char* data;
+  size_t size;
+};
+
+extern const EmbeddedFile g_kernelKeccak;
+extern const EmbeddedFile g_kernelEradicate2;
+extern const EmbeddedFile g_kernelSpirv64;
+extern const EmbeddedFile g_kernelSpirv32;
+
+#endif /* HPP_KERNELS */
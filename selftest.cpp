@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include <magic_enum.hpp>
+
+#include "ArgParser.hpp"
+#include "Constraint.hpp"
+#include "Dispatcher.hpp"
+#include "Guard.hpp"
+#include "ModeFactory.hpp"
+#include "Pattern.hpp"
+#include "Reference.hpp"
+#include "SaltTemplate.hpp"
+#include "Weights.hpp"
+#include "clutil.hpp"
+#include "hexadecimal.hpp"
+
+using namespace std;
+
+/* Differential test of eradicate2_iterate against the host implementation in
+ * Reference.cpp. Every mode runs once with a fixed seed, device id and round
+ * and a low threshold, and every result slot read back from the device must be
+ * exactly what the host derives for the same thread ids.
+ *
+ * Only the first hit per score is stored by the kernel and which thread gets
+ * there first depends on scheduling, so a stored salt/hash must be one of the
+ * host's hits for that score rather than a specific one. Hit counts and empty
+ * slots are compared as is.
+ *
+ * The scorers are also run on their own through eradicate2_score_batch, on
+ * addresses built to contain long runs, runs crossing the 64-bit lanes the
+ * kernel scores on, mirrors and full scores. Random hashes almost never reach
+ * those, and every score must equal the host's.
+ *
+ * The program is built with a pattern (-p) that has classes and open runs at
+ * both ends and with weights (-wm) that have both run bonuses, their generated
+ * scorers are tested like the built-in ones. A
+ * constraint (-ct) is compiled in as well when given, every mode is then
+ * tested with it. So is a guard (-g), the host then derives every address from
+ * the guarded salt.
+ *
+ * The default round is above 2^32 and the worker id (--worker-id) goes into
+ * the device id, so both halves of the 64 bit round and every device id byte
+ * of the salt layout are covered.
+ *
+ * Defaults to OpenCL CPU devices so it can run on machines without a GPU.
+ *
+ * usage: ./ERADICATE2-selftest.x64 [-t cpu|gpu|all] [-S size] [-w work] [-s skip] [--seed n] [--round n] [-wi worker] [-st template] [-p pattern] [-wm weights] [-ct constraint] [-g guard]
+ */
+
+// Modes with parameters chosen to produce hits at most scores within a small size
+static vector<mode> selfTestModes(const Pattern& pattern, const Weights& weights) {
+  vector<mode> vModes = {
+      ModeFactory::benchmark(),
+      ModeFactory::zerobytes(),
+      ModeFactory::matching("d00d"),
+      ModeFactory::matching("f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0"),
+      ModeFactory::leading('0'),
+      ModeFactory::range(0, 9),
+      ModeFactory::letters(),
+      ModeFactory::zeros(),
+      ModeFactory::mirror(),
+      ModeFactory::doubles(),
+      ModeFactory::leadingRange(0, 7),
+      ModeFactory::trailing('f'),
+      ModeFactory::all(3),
+      ModeFactory::allLeading(),
+      ModeFactory::allLeadingTrailing(""),
+      ModeFactory::allLeadingTrailing("c"),
+      ModeFactory::allLeadingTrailing("ab"),
+      ModeFactory::matchLeading("c0ffee"),
+  };
+
+  if (pattern.enabled()) {
+    vModes.push_back(ModeFactory::pattern());
+  }
+
+  if (weights.enabled()) {
+    vModes.push_back(ModeFactory::weights());
+  }
+
+  return vModes;
+}
+
+struct Hits {
+  cl_uint found[ERADICATE2_MAX_SCORE + 1];
+  set<string> results[ERADICATE2_MAX_SCORE + 1];
+};
+
+static string resultBytes(const cl_uchar salt[32], const cl_uchar hash[20]) {
+  return string(reinterpret_cast<const char*>(salt), 32) + string(reinterpret_cast<const char*>(hash), 20);
+}
+
+// Returns a description of every mismatching slot, empty if all of them match
+static string compare(const result* const pResults, const Hits& hits) {
+  static const result empty = {{0}, {0}, 0};
+  ostringstream oss;
+
+  for (size_t i = 0; i <= ERADICATE2_MAX_SCORE; ++i) {
+    const result& r = pResults[i];
+    if (r.found != hits.found[i]) {
+      oss << "    score " << i << ": found " << r.found << ", expected " << hits.found[i] << endl;
+    } else if (hits.found[i] == 0 && memcmp(&r, &empty, sizeof(result)) != 0) {
+      oss << "    score " << i << ": slot written without a hit" << endl;
+    } else if (hits.found[i] != 0 && hits.results[i].count(resultBytes(r.salt, r.hash)) == 0) {
+      oss << "    score " << i << ": salt 0x" << toHex(r.salt, 32) << " with hash 0x" << toHex(r.hash, 20) << " is not a hit on the host" << endl;
+    }
+  }
+
+  return oss.str();
+}
+
+// Addresses with structure random hashes rarely have, each kind in turn with random lengths and positions
+static vector<cl_uchar> scoreTestHashes(const size_t count, const unsigned long long seed) {
+  static const cl_uchar prefix[40] = {0xc, 0x0, 0xf, 0xf, 0xe, 0xe, 0xd, 0x0, 0x0, 0xd, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0,
+                                      0xf, 0x0, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0, 0xf, 0x0};
+  static const cl_uchar characters[] = {0x0, 0xa, 0xb, 0xc, 0xf};
+
+  mt19937_64 rng(seed);
+  const auto length = [&] { return static_cast<int>(rng() % 41); };
+  const auto character = [&] { return rng() % 2 ? characters[rng() % sizeof(characters)] : static_cast<cl_uchar>(rng() % 16); };
+
+  vector<cl_uchar> vHashes(count * 20);
+  for (size_t i = 0; i < count; ++i) {
+    cl_uchar n[40];
+    for (auto& c : n) {
+      c = rng() % 16;
+    }
+
+    const int len = length();
+    const cl_uchar c = character();
+    switch (i % 8) {
+      case 0: {
+        // Few distinct characters, runs everywhere
+        const cl_uchar alphabet[3] = {c, character(), character()};
+        const size_t size = 1 + rng() % 3;
+        for (auto& x : n) {
+          x = alphabet[rng() % size];
+        }
+        break;
+      }
+
+      case 1:
+        fill(n, n + len, c);
+        break;
+
+      case 2:
+        fill(n + 40 - len, n + 40, c);
+        break;
+
+      case 3: {
+        const int start = rng() % (41 - len);
+        fill(n + start, n + start + len, c);
+        break;
+      }
+
+      case 4:
+        for (int t = 0; t < len / 2; ++t) {
+          n[20 + t] = n[19 - t];
+        }
+        break;
+
+      case 5:
+        for (int t = 0; t < len / 2; ++t) {
+          n[2 * t + 1] = n[2 * t];
+        }
+        break;
+
+      case 6:
+        copy(prefix, prefix + len, n);
+        break;
+
+      case 7: {
+        const int lenTrailing = length();
+        fill(n, n + len, c);
+        fill(n + 40 - lenTrailing, n + 40, character());
+        break;
+      }
+    }
+
+    for (int j = 0; j < 20; ++j) {
+      vHashes[i * 20 + j] = (n[2 * j] << 4) | n[2 * j + 1];
+    }
+  }
+
+  return vHashes;
+}
+
+// Returns a description of the first few addresses scored differently than on the host, empty if none are
+static string compareScores(const mode& m, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const vector<cl_uchar>& vHashes, const cl_uchar* const pScores) {
+  ostringstream oss;
+  size_t mismatches = 0;
+
+  for (size_t i = 0; i < vHashes.size() / 20; ++i) {
+    const int expected = Reference::score(m, &vHashes[i * 20], pattern, weights, constraint);
+    if (pScores[i] != expected && mismatches++ < 5) {
+      oss << "    address 0x" << toHex(&vHashes[i * 20], 20) << ": score " << (int)pScores[i] << ", expected " << expected << endl;
+    }
+  }
+
+  if (mismatches > 5) {
+    oss << "    ... " << mismatches - 5 << " more" << endl;
+  }
+
+  return oss.str();
+}
+
+static bool selfTestDevice(cl_device_id clDeviceId, const size_t deviceIndex, const cl_uint deviceId, const ethhash& init, const SaltTemplate& saltTemplate, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const Guard& guard, const cl_ulong round, const size_t size, size_t worksizeLocal) {
+  cout << "Device " << deviceIndex << ": " << clGetWrapperString(clGetDeviceInfo, clDeviceId, CL_DEVICE_NAME) << endl;
+
+  cl_int errorCode;
+  cl_context clContext = clCreateContext(NULL, 1, &clDeviceId, NULL, NULL, &errorCode);
+  if (clContext == NULL) {
+    cout << "  failed to create context (" << errorCode << ")" << endl;
+    return false;
+  }
+
+  const string strBuildOptions = "-D ERADICATE2_MAX_SCORE=" + lexical_cast::write(ERADICATE2_MAX_SCORE) + " -D ERADICATE2_INITHASH=" + makePreprocessorInitHashExpression(init);
+  cl_program clProgram = buildProgram(clContext, {clDeviceId}, strBuildOptions, saltTemplate.source() + pattern.source() + weights.source() + constraint.source() + guard.source());
+  if (clProgram == NULL) {
+    cout << "  failed to build program" << endl;
+    clReleaseContext(clContext);
+    return false;
+  }
+
+  // Addresses don't depend on the mode, derive them once
+  vector<cl_uchar> vSalts(size * 32);
+  vector<cl_uchar> vHashes(size * 20);
+  for (size_t id = 0; id < size; ++id) {
+    Reference::iterate(init, deviceId, static_cast<cl_uint>(id), round, &vSalts[id * 32], &vHashes[id * 20], saltTemplate, guard);
+  }
+
+  cl_command_queue clQueue = createQueue(clContext, clDeviceId);
+  cl_kernel clKernel = clCreateKernel(clProgram, "eradicate2_iterate", NULL);
+  cl_kernel clKernelScore = clCreateKernel(clProgram, "eradicate2_score_batch", NULL);
+  const vector<cl_uchar> vTestHashes = scoreTestHashes(size, round);
+  bool bPassed = true;
+
+  {
+    CLMemory<result> memResult(clContext, clQueue, CL_MEM_READ_WRITE, ERADICATE2_MAX_SCORE + 1);
+    CLMemory<mode> memMode(clContext, clQueue, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, 1);
+    CLMemory<cl_uchar> memHashes(clContext, clQueue, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, vTestHashes.size());
+    CLMemory<cl_uchar> memScores(clContext, clQueue, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, size);
+
+    const cl_uchar scoreMax = 1;
+    memResult.setKernelArg(clKernel, 0);
+    memMode.setKernelArg(clKernel, 1);
+    CLMemory<cl_uchar>::setKernelArg(clKernel, 2, scoreMax);
+    CLMemory<cl_uint>::setKernelArg(clKernel, 3, deviceId);
+    CLMemory<cl_ulong>::setKernelArg(clKernel, 4, round);
+
+    copy(vTestHashes.begin(), vTestHashes.end(), &memHashes[0]);
+    memHashes.write(true);
+    memHashes.setKernelArg(clKernelScore, 0);
+    memMode.setKernelArg(clKernelScore, 1);
+    memScores.setKernelArg(clKernelScore, 2);
+
+    for (const mode& m : selfTestModes(pattern, weights)) {
+      Hits hits = {{0}, {}};
+      const cl_uchar threshold = Reference::threshold(m, scoreMax);
+      for (size_t id = 0; id < size; ++id) {
+        const int score = Reference::score(m, &vHashes[id * 20], pattern, weights, constraint);
+        if (score && score > threshold) {
+          ++hits.found[score];
+          hits.results[score].insert(resultBytes(&vSalts[id * 32], &vHashes[id * 20]));
+        }
+      }
+
+      *memMode = m;
+      memMode.write(true);
+      memset(&memResult[0], 0, sizeof(result) * (ERADICATE2_MAX_SCORE + 1));
+      memResult.write(true);
+      runKernel(clQueue, clKernel, size, worksizeLocal);
+      memResult.read(true);
+
+      runKernel(clQueue, clKernelScore, size, worksizeLocal);
+      memScores.read(true);
+
+      const string strMismatch = compare(&memResult[0], hits) + compareScores(m, pattern, weights, constraint, vTestHashes, &memScores[0]);
+      size_t total = 0;
+      for (size_t i = 0; i <= ERADICATE2_MAX_SCORE; ++i) {
+        total += hits.found[i];
+      }
+
+      cout << "  " << (strMismatch.empty() ? "OK  " : "FAIL") << " " << magic_enum::enum_name(m.function) << " (" << total << " hits)" << endl;
+      cout << strMismatch;
+      bPassed = bPassed && strMismatch.empty();
+    }
+  }
+
+  clReleaseKernel(clKernelScore);
+  clReleaseKernel(clKernel);
+  clReleaseCommandQueue(clQueue);
+  clReleaseProgram(clProgram);
+  clReleaseContext(clContext);
+  return bPassed;
+}
+
+int main(int argc, char** argv) {
+  try {
+    string strType = "cpu";
+    size_t size = 65536;
+    size_t worksizeLocal = 64;
+    unsigned long long seed = 1;
+    cl_ulong round = 0x100000007ULL;
+    cl_uint workerId = 0xa5c3e1;
+    vector<size_t> vDeviceSkipIndex;
+    string strSaltTemplate;
+    string strPattern = "^c0[a-f]{2}0+.*[0-9]+f0$";
+    string strWeights = "0=1,[a-f]@0-3=2,c@0=3,^[0-3]=2,[c-f]$=3";
+    string strConstraint;
+    string strGuard;
+
+    ArgParser argp(argc, argv);
+    argp.addSwitch("t", "type", strType);
+    argp.addSwitch("S", "size", size);
+    argp.addSwitch("w", "work", worksizeLocal);
+    argp.addSwitch("seed", "seed", seed);
+    argp.addSwitch("round", "round", round);
+    argp.addSwitch("wi", "worker-id", workerId);
+    argp.addMultiSwitch('s', "skip", vDeviceSkipIndex);
+    argp.addSwitch("st", "salt-template", strSaltTemplate);
+    argp.addSwitch("p", "pattern", strPattern);
+    argp.addSwitch("wm", "weights", strWeights);
+    argp.addSwitch("ct", "constraint", strConstraint);
+    argp.addSwitch("g", "guard", strGuard);
+
+    const map<string, cl_device_type> mTypes = {{"cpu", CL_DEVICE_TYPE_CPU}, {"gpu", CL_DEVICE_TYPE_GPU}, {"all", CL_DEVICE_TYPE_ALL}};
+    if (!argp.parse() || size == 0 || mTypes.count(strType) == 0) {
+      cout << "usage: ./ERADICATE2-selftest.x64 [-t cpu|gpu|all] [-S size] [-w work] [-s skip] [--seed n] [--round n] [-wi worker] [-st template] [-p pattern] [-wm weights] [-ct constraint] [-g guard]" << endl;
+      return 1;
+    }
+
+    // Arbitrary but fixed deployers and proxy hash, only the seed varies the salts
+    const string c3Addr = "00000000000029398fcE86f09FF8453c8D0Cd60D";
+    const string c3ProxyHash = "21c35dbe1b344a2488cf3321d6ce542f8e9f305544ff09e4993a62319a497c1f";
+    const string c2AddrBinary = keccakDigest(parseHexadecimalBytes("0x4e59b44847b379578588920ca78fbf26c0b4956c")).substr(12);
+    const Guard guard = strGuard.empty() ? Guard() : Guard::parse(strGuard);
+    const SaltTemplate saltTemplate = guard.saltTemplate(strSaltTemplate.empty() ? SaltTemplate() : SaltTemplate::parse(strSaltTemplate));
+    ethhash init = makeInitHash(hexStringToConstChar(c3Addr), c2AddrBinary, hexStringToConstChar(c3ProxyHash), seed);
+    saltTemplate.apply(init, seed);
+    const Pattern pattern = Pattern::parse(strPattern);
+    const Weights weights = Weights::parse(strWeights);
+    const Constraint constraint = strConstraint.empty() ? Constraint() : Constraint::parse(strConstraint);
+
+    const vector<cl_device_id> vDevices = getAllDevices(mTypes.at(strType));
+    size_t tested = 0;
+    bool bPassed = true;
+    for (size_t i = 0; i < vDevices.size(); ++i) {
+      if (find(vDeviceSkipIndex.begin(), vDeviceSkipIndex.end(), i) != vDeviceSkipIndex.end()) {
+        continue;
+      }
+
+      // Templates hold fewer device id bits than the default layout, only as many of the worker id's are kept
+      const cl_uint deviceId = SaltTemplate::deviceId(workerId, i) & saltTemplate.deviceIdMax();
+      bPassed = selfTestDevice(vDevices[i], i, deviceId, init, saltTemplate, pattern, weights, constraint, guard, round, size, worksizeLocal) && bPassed;
+      ++tested;
+    }
+
+    if (tested == 0) {
+      cout << "error: no " << strType << " devices found" << endl;
+      return 1;
+    }
+
+    cout << (bPassed ? "PASSED" : "FAILED") << endl;
+    return bPassed ? 0 : 1;
+  } catch (runtime_error& e) {
+    cout << "runtime_error - " << e.what() << endl;
+  }
+
+  return 1;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <magic_enum.hpp>
+
+#include "ArgParser.hpp"
+#include "ModeArgs.hpp"
+#include "Reference.hpp"
+#include "ResultStore.hpp"
+#include "hexadecimal.hpp"
+
+using namespace std;
+
+/* Offline access to a result store written with --store, no OpenCL needed.
+ *
+ * Without a mode the stored scores are used, with one every record is scored
+ * again on all cores, so addresses found by a -z run can be searched for the
+ * best -al address or a --pattern without spending GPU time. A --constraint
+ * leaves out records outside it either way. The best records are printed in
+ * the format of the results files, with the job id appended, and can be checked
+ * with --verify.
+ *
+ * Results files from earlier runs are added to a store with --import.
+ *
+ * usage: ./ERADICATE2-store.x64 -sf store [mode] [-ms min-score] [-c count] [-j job]
+ *        ./ERADICATE2-store.x64 -sf store --info
+ *        ./ERADICATE2-store.x64 -sf store --import file.txt [mode] [-j job]
+ */
+
+static const string g_strUsage =
+    "usage: ./ERADICATE2-store.x64 -sf store [mode] [-ms min-score] [-c count] [-j job]\n"
+    "       ./ERADICATE2-store.x64 -sf store --info\n"
+    "       ./ERADICATE2-store.x64 -sf store --import file.txt [mode] [-j job]";
+
+static string modeName(const cl_uchar function) {
+  if (function == ResultStore::NoMode) {
+    return "unknown";
+  }
+
+  return string(magic_enum::enum_name(static_cast<ModeFunction>(function)));
+}
+
+// Appends every line of a results file, lines that don't parse are skipped
+static void importFile(ResultStore& store, const string& fileName, const cl_uchar function, const cl_ulong jobId) {
+  ifstream ifs(fileName);
+  if (!ifs.is_open()) {
+    throw runtime_error("failed to open results file " + fileName);
+  }
+
+  size_t imported = 0;
+  size_t skipped = 0;
+  for (string line; getline(ifs, line);) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    if (line.empty()) {
+      continue;
+    }
+
+    try {
+      istringstream iss(line);
+      string strScore, strSalt, strHash;
+      getline(iss, strScore, ',');
+      getline(iss, strSalt, ',');
+      getline(iss, strHash, ',');
+
+      const string salt = parseHexadecimalBytes(strSalt);
+      const string hash = parseHexadecimalBytes(strHash);
+      const int score = stoi(strScore);
+      if (salt.size() != 32 || hash.size() != 20 || score < 0 || score > ERADICATE2_MAX_SCORE) {
+        throw runtime_error("bad line");
+      }
+
+      ResultStore::Record r;
+      memcpy(r.salt, salt.data(), 32);
+      memcpy(r.hash, hash.data(), 20);
+      r.score = static_cast<cl_uchar>(score);
+      r.function = function;
+      r.reserved[0] = r.reserved[1] = 0;
+      r.jobId = jobId;
+      store.append(r);
+      ++imported;
+    } catch (exception&) {
+      ++skipped;
+    }
+  }
+
+  cout << "Imported " << imported << " results from " << fileName << ", " << skipped << " lines skipped" << endl;
+}
+
+static void printInfo(const ResultStore& store) {
+  struct JobInfo {
+    size_t count;
+    cl_uchar scoreBest;
+    map<cl_uchar, size_t> functions;
+  };
+
+  map<cl_ulong, JobInfo> mJobs;
+  const ResultStore::Record* const pRecords = store.records();
+  for (size_t i = 0; i < store.size(); ++i) {
+    JobInfo& info = mJobs[pRecords[i].jobId];
+    ++info.count;
+    info.scoreBest = max(info.scoreBest, pRecords[i].score);
+    ++info.functions[pRecords[i].function];
+  }
+
+  cout << "Records: " << store.size() << endl;
+  for (auto& job : mJobs) {
+    cout << "  Job " << job.first << ": " << job.second.count << " records, best score " << (int)job.second.scoreBest << " (";
+    for (auto it = job.second.functions.begin(); it != job.second.functions.end(); ++it) {
+      cout << (it == job.second.functions.begin() ? "" : ", ") << modeName(it->first) << " " << it->second;
+    }
+
+    cout << ")" << endl;
+  }
+}
+
+// Prints the count best records scoring above scoreMin, all of them if count is 0
+static void query(const ResultStore& store, const mode* const pMode, const Pattern& pattern, const Weights& weights, const Constraint& constraint, const unsigned int scoreMin, const size_t count, const cl_ulong jobId) {
+  const ResultStore::Record* const pRecords = store.records();
+  const size_t size = store.size();
+
+  // Records are scored in blocks handed out one at a time, each thread collects what passes
+  const size_t block = 65536;
+  const unsigned int threads = max(thread::hardware_concurrency(), 1u);
+  vector<vector<pair<cl_uchar, size_t>>> vPassed(threads);
+  atomic<size_t> next(0);
+  const auto worker = [&](vector<pair<cl_uchar, size_t>>& vOut) {
+    for (size_t begin = next.fetch_add(block); begin < size; begin = next.fetch_add(block)) {
+      const size_t end = min(begin + block, size);
+      for (size_t i = begin; i < end; ++i) {
+        const ResultStore::Record& r = pRecords[i];
+        if (jobId != 0 && r.jobId != jobId) {
+          continue;
+        }
+
+        const int score = pMode ? Reference::score(*pMode, r.hash, pattern, weights, constraint) : constraint.check(r.hash) ? r.score : 0;
+        if (score > static_cast<int>(scoreMin)) {
+          vOut.emplace_back(static_cast<cl_uchar>(score), i);
+        }
+      }
+    }
+  };
+
+  vector<thread> vThreads;
+  for (unsigned int i = 0; i < threads; ++i) {
+    vThreads.emplace_back(worker, ref(vPassed[i]));
+  }
+
+  for (auto& t : vThreads) {
+    t.join();
+  }
+
+  vector<pair<cl_uchar, size_t>> vBest;
+  for (auto& v : vPassed) {
+    vBest.insert(vBest.end(), v.begin(), v.end());
+  }
+
+  // Best score first, older records first within a score
+  const auto better = [](const pair<cl_uchar, size_t>& a, const pair<cl_uchar, size_t>& b) { return a.first != b.first ? a.first > b.first : a.second < b.second; };
+  const size_t shown = count == 0 ? vBest.size() : min(count, vBest.size());
+  partial_sort(vBest.begin(), vBest.begin() + shown, vBest.end(), better);
+
+  for (size_t i = 0; i < shown; ++i) {
+    const ResultStore::Record& r = pRecords[vBest[i].second];
+    cout << (int)vBest[i].first << ",0x" << toHex(r.salt, 32) << ",0x" << toHex(r.hash, 20) << "," << r.jobId << endl;
+  }
+
+  cerr << "Scanned " << size << " records, " << vBest.size() << " above score " << scoreMin << endl;
+}
+
+int main(int argc, char** argv) {
+  try {
+    string storeFileName;
+    string importFileName;
+    bool bInfo = false;
+    unsigned int scoreMin = 0;
+    size_t count = 20;
+    cl_ulong jobId = 0;
+    ModeArgs modeArgs;
+
+    ArgParser argp(argc, argv);
+    argp.addSwitch("sf", "store", storeFileName);
+    argp.addSwitch("im", "import", importFileName);
+    argp.addSwitch("info", "info", bInfo);
+    argp.addSwitch("ms", "min-score", scoreMin);
+    argp.addSwitch("c", "count", count);
+    argp.addSwitch("j", "job-id", jobId);
+    modeArgs.add(argp);
+
+    if (!argp.parse() || storeFileName.empty()) {
+      cout << g_strUsage << endl;
+      return 1;
+    }
+
+    mode m;
+    const bool bModeGiven = modeArgs.select(m, scoreMin);
+
+    if (!importFileName.empty()) {
+      ResultStore store(storeFileName);
+      importFile(store, importFileName, bModeGiven ? static_cast<cl_uchar>(m.function) : ResultStore::NoMode, jobId);
+      return 0;
+    }
+
+    const ResultStore store(storeFileName, true);
+    if (bInfo) {
+      printInfo(store);
+    } else {
+      query(store, bModeGiven ? &m : NULL, modeArgs.pattern(), modeArgs.weights(), modeArgs.constraint(), scoreMin, count, jobId);
+    }
+
+    return 0;
+  } catch (runtime_error& e) {
+    cout << "runtime_error - " << e.what() << endl;
+  }
+
+  return 1;
+}
@@ -10,8 +10,11 @@
 #include <CL/cl.h>
 #endif
 #include <chrono>
+#include <string>
 using namespace std;
 
+#define ERADICATE2_MAX_SCORE 40
+
 enum class ModeFunction {
   Benchmark,
   ZeroBytes,
@@ -25,7 +28,9 @@ enum class ModeFunction {
   All,
   AllLeading,
   AllLeadingTrailing,
-  MatchLeading
+  MatchLeading,
+  Pattern,
+  Weights
 };
 
 typedef struct {
@@ -49,10 +54,31 @@ typedef union {
   cl_uint d[50];
 } ethhash;
 
+// Descriptor of one search run by eradicate2_iterate_jobs
+typedef struct {
+  ethhash init;
+  mode m;
+  cl_uint begin;  // First global id of the job, jobs are sorted by it
+  cl_uchar scoreMax;
+  cl_uchar reserved[7];
+} job;
+
+static_assert(sizeof(job) == 256, "job must match the kernel's layout");
+
 typedef struct {
   string fileName;
   unsigned int scoreMin;
   chrono::steady_clock::time_point timeStart;
+  bool profiling;
+  string traceFileName;
+  ethhash initHash;
+  string storeFileName;
+  cl_ulong jobId;
+  unsigned int retries;         // Times a failed device is retried before it's given up on
+  unsigned int retryBackoffMs;  // Wait before the first retry, doubled for every further one
+  cl_uint workerId;             // Upper bits of every device id, see SaltTemplate::deviceId()
+  cl_ulong roundMax;            // Last round the salt layout holds, devices stop there
+  bool schedule;               // Jobs take turns by round instead of sharing every launch, see Scheduler
 } config;
 
 #endif /* HPP_TYPES */
\ No newline at end of file